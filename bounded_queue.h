@@ -0,0 +1,104 @@
+#pragma once
+
+/*
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+ 
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program. If not, see <http://www.gnu.org/licenses/>
+
+Authors:
+   Andy Little
+   Tom Ren
+  
+*/
+
+#include <cstddef>
+#include <vector>
+#include <utility>
+#include <mutex>
+#include <condition_variable>
+
+/*
+  blocking queue with a fixed capacity, for handing data between a producer and consumer thread.
+  push blocks while full, pop blocks while empty. try_push never blocks.
+  After close() push fails and pop drains whatever is left then fails.
+  The items are a ring allocated once, so passing data through doesnt touch the heap.
+*/
+template <typename T>
+class CBoundedQueue{
+public:
+    enum class push_result { ok, full, closed};
+
+    explicit CBoundedQueue(size_t capacity)
+    : m_capacity{capacity}, m_closed{false}, m_items(capacity), m_front{0}, m_count{0}{}
+
+    bool push(T const & item)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_not_full.wait(lock,[this]{ return m_closed || (m_count < m_capacity);});
+        if ( m_closed){
+            return false;
+        }
+        m_items[(m_front + m_count) % m_capacity] = item;
+        ++m_count;
+        m_not_empty.notify_one();
+        return true;
+    }
+
+    push_result try_push(T const & item)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if ( m_closed){
+            return push_result::closed;
+        }
+        if ( m_count == m_capacity){
+            return push_result::full;
+        }
+        m_items[(m_front + m_count) % m_capacity] = item;
+        ++m_count;
+        m_not_empty.notify_one();
+        return push_result::ok;
+    }
+
+    bool pop(T & item)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_not_empty.wait(lock,[this]{ return m_closed || (m_count > 0);});
+        if ( m_count == 0){
+            return false;
+        }
+        // leave the slot empty, so it doesnt hold on to anything the item owns
+        item = std::move(m_items[m_front]);
+        m_items[m_front] = T{};
+        m_front = (m_front + 1) % m_capacity;
+        --m_count;
+        m_not_full.notify_one();
+        return true;
+    }
+
+    void close()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_closed = true;
+        m_not_full.notify_all();
+        m_not_empty.notify_all();
+    }
+
+private:
+    size_t const m_capacity;
+    bool m_closed;
+    std::vector<T> m_items;
+    size_t m_front;
+    size_t m_count;
+    std::mutex m_mutex;
+    std::condition_variable m_not_full;
+    std::condition_variable m_not_empty;
+};
@@ -0,0 +1,214 @@
+/*
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+ 
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program. If not, see <http://www.gnu.org/licenses/>
+
+Authors:
+   Andy Little
+   Tom Ren
+*/
+
+
+#include "bundle.h"
+
+#include <stdexcept>
+#include <vector>
+#include <cstring>
+#include <cstdio>
+#include <algorithm>
+
+#include "crc.h"
+#include "firmware.h"
+
+namespace {
+
+    constexpr char bundle_magic[8] = {'P','O','S','D','B','N','D','L'};
+
+    void put_u16(uint8_t * p, uint16_t v)
+    {
+        p[0] = static_cast<uint8_t>(v);
+        p[1] = static_cast<uint8_t>(v >> 8);
+    }
+
+    void put_u32(uint8_t * p, uint32_t v)
+    {
+        put_u16(p, static_cast<uint16_t>(v));
+        put_u16(p + 2, static_cast<uint16_t>(v >> 16));
+    }
+
+    uint16_t get_u16(uint8_t const * p)
+    {
+        return static_cast<uint16_t>(p[0] | (p[1] << 8));
+    }
+
+    uint32_t get_u32(uint8_t const * p)
+    {
+        return get_u16(p) | (static_cast<uint32_t>(get_u16(p + 2)) << 16);
+    }
+
+    // the board crc for an image, with the same 0xff padding as a firmware upload
+    uint32_t board_crc(std::vector<uint8_t> image, uint32_t flash_size)
+    {
+        image.insert(image.end(),image.size() % 4,0xff);
+        if ( image.size() > flash_size){
+            throw std::runtime_error("firmware image is bigger than the board flash");
+        }
+        return px4Uploader::crc_pad(px4Uploader::crc_update(image.data(),image.size(),0),image.size(),flash_size);
+    }
+}
+
+constexpr size_t CBundle::header_size;
+constexpr uint16_t CBundle::format_version;
+
+class CBundle::CFirmwarePart : public CFirmwareSource{
+public:
+    CFirmwarePart(std::ifstream & in, uint32_t size) : m_in(in), m_left{size}, m_size{size}{}
+
+    size_t read(uint8_t * dest, size_t max)
+    {
+        size_t const n = std::min(static_cast<size_t>(m_left),max);
+        if ( n == 0){
+            return 0;
+        }
+        m_in.read(reinterpret_cast<char*>(dest),n);
+        if ( static_cast<size_t>(m_in.gcount()) != n){
+            throw std::runtime_error("bundle firmware is truncated");
+        }
+        m_left -= n;
+        return n;
+    }
+
+    int32_t size_hint() const { return m_size;}
+private:
+    std::ifstream & m_in;
+    uint32_t m_left;
+    uint32_t const m_size;
+};
+
+CBundle::CBundle(std::string const & filename)
+: m_in(filename, std::ios_base::in | std::ios_base::binary), m_firmware_taken{false}
+{
+    if ( !m_in || !m_in.good() ){
+        throw std::runtime_error("Failed to open bundle file");
+    }
+    uint8_t head[header_size];
+    m_in.read(reinterpret_cast<char*>(head),header_size);
+    if ( (static_cast<size_t>(m_in.gcount()) != header_size) || (memcmp(head,bundle_magic,8) != 0)){
+        throw std::runtime_error("not a PlayUAV OSD bundle");
+    }
+    if ( (get_u16(head + 8) != format_version) || (get_u16(head + 10) != header_size)){
+        throw std::runtime_error("unsupported bundle format version");
+    }
+    if ( px4Uploader::crc_update(head,40,0) != get_u32(head + 40)){
+        throw std::runtime_error("bundle header is corrupt");
+    }
+    m_header.board_id = get_u32(head + 12);
+    m_header.flash_size = get_u32(head + 16);
+    m_header.firmware_version = get_u16(head + 20);
+    m_header.params_size = get_u32(head + 24);
+    m_header.params_crc = get_u32(head + 28);
+    m_header.firmware_size = get_u32(head + 32);
+    m_header.firmware_crc = get_u32(head + 36);
+
+    if ( m_header.params_size != PARAMS_BUF_SIZE){
+        throw std::runtime_error("bundle parameter image is the wrong size");
+    }
+    m_in.read(reinterpret_cast<char*>(m_params),PARAMS_BUF_SIZE);
+    if ( (m_in.gcount() != PARAMS_BUF_SIZE) || (px4Uploader::crc_update(m_params,PARAMS_BUF_SIZE,0) != m_header.params_crc)){
+        throw std::runtime_error("bundle parameter image is corrupt");
+    }
+    if ( (m_header.firmware_size == 0) || (m_header.firmware_size > m_header.flash_size)){
+        throw std::runtime_error("bundle firmware size is wrong");
+    }
+
+    // the firmware is read once here to check its crc, so a corrupt bundle is found
+    // before any board is erased, then streamed again from the start as it is programmed
+    std::streampos const firmware_start = m_in.tellg();
+    if ( firmware_start == std::streampos(-1)){
+        throw std::runtime_error("bundle must be a seekable file");
+    }
+    CFirmwarePart part{m_in,m_header.firmware_size};
+    uint8_t buf[4096];
+    uint32_t crc_state = 0;
+    while ( size_t const n = part.read(buf,sizeof(buf))){
+        crc_state = px4Uploader::crc_update(buf,n,crc_state);
+    }
+    uint8_t const pad[4] = {0xff,0xff,0xff,0xff};
+    uint32_t const padded_size = m_header.firmware_size + m_header.firmware_size % 4;
+    crc_state = px4Uploader::crc_update(pad,m_header.firmware_size % 4,crc_state);
+    if ( (padded_size > m_header.flash_size) ||
+            (static_cast<uint32_t>(px4Uploader::crc_pad(crc_state,padded_size,m_header.flash_size)) != m_header.firmware_crc)){
+        throw std::runtime_error("bundle firmware is corrupt");
+    }
+    if ( !m_in.seekg(firmware_start)){
+        throw std::runtime_error("bundle must be a seekable file");
+    }
+}
+
+std::unique_ptr<CFirmwareSource> CBundle::firmware()
+{
+    if ( m_firmware_taken){
+        throw std::runtime_error("bundle firmware already read");
+    }
+    m_firmware_taken = true;
+    return std::unique_ptr<CFirmwareSource>{new CFirmwarePart{m_in,m_header.firmware_size}};
+}
+
+void CBundle::create(std::string const & filename, uint32_t board_id, uint32_t flash_size,
+        uint16_t firmware_version, std::string const & firmware_file, std::string const & params_file)
+{
+    COSDParam osdparams;
+    uint8_t params[PARAMS_BUF_SIZE];
+    osdparams.get_default_params(params);
+    if ( !params_file.empty() && !osdparams.load_params_from_file(params_file,params)){
+        throw std::runtime_error("failed to load parameters");
+    }
+
+    std::vector<uint8_t> image;
+    auto source = CFirmwareSource::open(firmware_file);
+    uint8_t buf[4096];
+    while ( size_t const n = source->read(buf,sizeof(buf))){
+        image.insert(image.end(),buf,buf + n);
+    }
+    if ( image.empty()){
+        throw std::runtime_error("firmware image is empty");
+    }
+
+    uint8_t head[header_size] = {0};
+    memcpy(head,bundle_magic,8);
+    put_u16(head + 8,format_version);
+    put_u16(head + 10,header_size);
+    put_u32(head + 12,board_id);
+    put_u32(head + 16,flash_size);
+    put_u16(head + 20,firmware_version);
+    put_u32(head + 24,PARAMS_BUF_SIZE);
+    put_u32(head + 28,px4Uploader::crc_update(params,PARAMS_BUF_SIZE,0));
+    put_u32(head + 32,image.size());
+    put_u32(head + 36,board_crc(image,flash_size));
+    put_u32(head + 40,px4Uploader::crc_update(head,40,0));
+
+    // written under another name first so a failed create doesnt leave a bad bundle
+    std::string const tmp = filename + ".tmp";
+    {
+        std::ofstream out(tmp, std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
+        out.write(reinterpret_cast<char const*>(head),header_size);
+        out.write(reinterpret_cast<char const*>(params),PARAMS_BUF_SIZE);
+        out.write(reinterpret_cast<char const*>(image.data()),image.size());
+        if ( !out.good()){
+            throw std::runtime_error("failed to write bundle file " + filename);
+        }
+    }
+    if ( rename(tmp.c_str(),filename.c_str()) != 0){
+        remove(tmp.c_str());
+        throw std::runtime_error("failed to write bundle file " + filename);
+    }
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+/*
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+ 
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program. If not, see <http://www.gnu.org/licenses/>
+
+Authors:
+   Andy Little
+   Tom Ren
+  
+*/
+
+#include <cstdint>
+#include <string>
+#include <fstream>
+#include <memory>
+
+#include "params.h"
+
+class CFirmwareSource;
+
+/*
+  a release as one file, firmware and parameters, applied in one session.
+  little endian :
+     header ( 44 bytes)
+        0  "POSDBNDL"
+        8  u16 format version
+        10 u16 header size
+        12 u32 board id ( bootloader INFO_BOARD_ID)
+        16 u32 board flash size ( bootloader INFO_FLASH_SIZE)
+        20 u16 version of the firmware image, given when the bundle is made. Checked against
+           the version the board reports ( Misc_Firmware_ver) once the firmware is running
+        22 u16 reserved, 0
+        24 u32 parameter image size ( PARAMS_BUF_SIZE)
+        28 u32 parameter image crc
+        32 u32 firmware image size
+        36 u32 firmware crc as the board will report it, padded to the flash size
+        40 u32 crc of the header bytes before it
+     parameter image
+     firmware image
+  The parameters come before the firmware. The firmware is read through once to check
+  its crc before the board is erased, then streamed from the file as it is programmed,
+  so the bundle must be a seekable file, not a pipe.
+*/
+struct bundle_header{
+    uint32_t board_id;
+    uint32_t flash_size;
+    uint16_t firmware_version;
+    uint32_t params_size;
+    uint32_t params_crc;
+    uint32_t firmware_size;
+    uint32_t firmware_crc;
+};
+
+class CBundle{
+public:
+    // reads and checks the header, the parameters and the firmware crc.
+    // Throws if the file cant be seeked back to the firmware
+    explicit CBundle(std::string const & filename);
+
+    bundle_header const & header() const { return m_header;}
+    uint8_t const * params() const { return m_params;}
+    // the firmware image, streamed from the file. Can only be taken once
+    std::unique_ptr<CFirmwareSource> firmware();
+
+    // firmware_version is the Misc_Firmware_ver the firmware reports once running
+    static void create(std::string const & filename, uint32_t board_id, uint32_t flash_size,
+        uint16_t firmware_version, std::string const & firmware_file, std::string const & params_file);
+
+    static constexpr size_t header_size = 44;
+    static constexpr uint16_t format_version = 1;
+
+private:
+    class CFirmwarePart;
+
+    std::ifstream m_in;
+    bundle_header m_header;
+    uint8_t m_params[PARAMS_BUF_SIZE];
+    bool m_firmware_taken;
+};
@@ -0,0 +1,242 @@
+/*
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+ 
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program. If not, see <http://www.gnu.org/licenses/>
+
+Authors:
+   Andy Little
+   Tom Ren
+*/
+
+#include "playuavosd.h"
+
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cstdio>
+#include <functional>
+#include <thread>
+#include <stdexcept>
+#include <algorithm>
+#include <streambuf>
+#include <ostream>
+
+#include "osdconn.h"
+#include "params.h"
+#include "bounded_queue.h"
+#include "progress.h"
+
+static_assert(POSD_PARAMS_SIZE == PARAMS_BUF_SIZE, "C api params size out of step");
+
+namespace {
+
+    // hands each line written to it to the status callback, without the newline
+    class CStatusLines : public std::streambuf{
+    public:
+        CStatusLines(posd_status_callback callback, void * user)
+        : m_callback{callback}, m_user{user}{}
+    protected:
+        int overflow(int c)
+        {
+            if ( c == EOF){
+                return 0;
+            }
+            if ( c == '\n'){
+                m_callback(m_line.c_str(),m_user);
+                m_line.clear();
+            }else{
+                m_line += static_cast<char>(c);
+            }
+            return c;
+        }
+    private:
+        posd_status_callback const m_callback;
+        void * const m_user;
+        std::string m_line;
+    };
+
+} // namespace
+
+/*
+  the connection reports through a progress channel, never to stdout. With a status callback
+  the channel is rendered as json lines to it, else the status is dropped
+*/
+struct posd_handle{
+    typedef std::function<void(posd_handle*)> job_type;
+
+    posd_handle(std::string const & port, posd_status_callback status, void * user)
+    : status_lines{status,user}, status_out{&status_lines}
+     ,renderer{CProgressRenderer::format::json,status_out}
+     ,conn{port}, jobs{POSD_MAX_QUEUED}
+    {
+        conn.set_progress(renderer.add_channel(port.empty() ? "board" : port));
+        if ( status != nullptr){
+            renderer.start();
+        }
+    }
+
+    void run()
+    {
+        job_type job;
+        while ( jobs.pop(job)){
+            job(this);
+        }
+    }
+
+    // runs fn on the worker and reports how it went to callback.
+    // Never waits, so a callback can queue the next job without the worker waiting on itself
+    template <typename F>
+    int post(F fn, posd_callback callback, void * user)
+    {
+        auto const queued = jobs.try_push([fn,callback,user](posd_handle * h){
+            int status = POSD_OK;
+            std::string message = "OK";
+            try{
+                fn(h);
+            }catch (std::exception & e){
+                status = POSD_ERROR;
+                message = e.what();
+            }
+            if ( callback != nullptr){
+                callback(h,status,message.c_str(),user);
+            }
+        });
+        switch (queued){
+            case CBoundedQueue<job_type>::push_result::ok:
+                return POSD_OK;
+            case CBoundedQueue<job_type>::push_result::full:
+                return POSD_BUSY;
+            default:
+                return POSD_CLOSED;
+        }
+    }
+
+    // the renderer is destroyed after the connection, which may still report as it closes
+    CStatusLines status_lines;
+    std::ostream status_out;
+    CProgressRenderer renderer;
+    COSDConn conn;
+    CBoundedQueue<job_type> jobs;
+    std::thread worker;
+};
+
+extern "C" {
+
+int posd_api_version(void)
+{
+    return POSD_API_VERSION;
+}
+
+posd_handle * posd_open(const char * port)
+{
+    return posd_open_with_status(port,nullptr,nullptr);
+}
+
+posd_handle * posd_open_with_status(const char * port, posd_status_callback status, void * user)
+{
+    posd_handle * handle = nullptr;
+    try{
+        handle = new posd_handle{(port != nullptr) ? port : "",status,user};
+        handle->conn.open();
+        handle->worker = std::thread{&posd_handle::run,handle};
+        return handle;
+    }catch (std::exception & e){
+        delete handle;
+        return nullptr;
+    }
+}
+
+int posd_close(posd_handle * handle)
+{
+    if ( handle == nullptr){
+        return POSD_BAD_ARG;
+    }
+    // from a callback the worker would be joining itself
+    if ( std::this_thread::get_id() == handle->worker.get_id()){
+        return POSD_IN_CALLBACK;
+    }
+    handle->jobs.close();
+    if ( handle->worker.joinable()){
+        handle->worker.join();
+    }
+    handle->conn.close();
+    handle->renderer.stop();
+    delete handle;
+    return POSD_OK;
+}
+
+int posd_upload_firmware_async(posd_handle * handle, const char * filename,
+        posd_callback callback, void * user)
+{
+    if ( (handle == nullptr) || (filename == nullptr)){
+        return POSD_BAD_ARG;
+    }
+    std::string const name{filename};
+    return handle->post([name](posd_handle * h){ h->conn.upload_firmware(name);},callback,user);
+}
+
+int posd_upload_params_async(posd_handle * handle, const uint8_t * params, size_t len,
+        posd_callback callback, void * user)
+{
+    if ( (handle == nullptr) || (params == nullptr) || (len != POSD_PARAMS_SIZE)){
+        return POSD_BAD_ARG;
+    }
+    std::vector<uint8_t> const image(params, params + len);
+    return handle->post([image](posd_handle * h){ h->conn.upload_params_buffer(image.data());},callback,user);
+}
+
+int posd_get_params_async(posd_handle * handle, uint8_t * params, size_t len,
+        posd_callback callback, void * user)
+{
+    if ( (handle == nullptr) || (params == nullptr) || (len != POSD_PARAMS_SIZE)){
+        return POSD_BAD_ARG;
+    }
+    return handle->post([params](posd_handle * h){ h->conn.get_params_buffer(params);},callback,user);
+}
+
+int posd_params_default(uint8_t * params, size_t len)
+{
+    if ( (params == nullptr) || (len != POSD_PARAMS_SIZE)){
+        return POSD_BAD_ARG;
+    }
+    COSDParam osdparams;
+    osdparams.get_default_params(params);
+    return POSD_OK;
+}
+
+int posd_params_from_text(const char * text, uint8_t * params, size_t len)
+{
+    if ( (text == nullptr) || (params == nullptr) || (len != POSD_PARAMS_SIZE)){
+        return POSD_BAD_ARG;
+    }
+    COSDParam osdparams;
+    return osdparams.load_params_from_string(text,params) ? POSD_OK : POSD_ERROR;
+}
+
+int posd_params_to_text(const uint8_t * params, size_t len, char * buf, size_t buf_len)
+{
+    if ( (params == nullptr) || (len != POSD_PARAMS_SIZE)){
+        return POSD_BAD_ARG;
+    }
+    COSDParam osdparams;
+    uint8_t image[PARAMS_BUF_SIZE];
+    memcpy(image,params,PARAMS_BUF_SIZE);
+    std::string const text = osdparams.params_to_string(image);
+    if ( (buf != nullptr) && (buf_len > 0)){
+        size_t const n = std::min(text.length(), buf_len - 1);
+        memcpy(buf,text.data(),n);
+        buf[n] = '\0';
+    }
+    return static_cast<int>(text.length());
+}
+
+} // extern "C"
@@ -0,0 +1,141 @@
+/*
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+ 
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program. If not, see <http://www.gnu.org/licenses/>
+
+Authors:
+   Andy Little
+   Tom Ren
+*/
+
+
+#include "clone.h"
+
+#include <stdexcept>
+#include <thread>
+#include <algorithm>
+#include <cstring>
+
+#include "osdconn.h"
+#include "firmware.h"
+#include "progress.h"
+
+class CCloneImage::CReader : public CFirmwareSource{
+public:
+    explicit CReader(CCloneImage & image) : m_image(image), m_pos{0}{}
+
+    size_t read(uint8_t * dest, size_t max)
+    {
+        size_t const n = m_image.m_read(m_pos,dest,max);
+        m_pos += n;
+        return n;
+    }
+private:
+    CCloneImage & m_image;
+    size_t m_pos;
+};
+
+CCloneImage::CCloneImage()
+: m_published{0}, m_done{false}
+{}
+
+void CCloneImage::append(uint8_t const * data, size_t len)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_data.insert(m_data.end(),data,data + len);
+    for ( size_t i = len; i > 0; --i){
+        if ( data[i-1] != 0xff){
+            // keep to whole words, as PROG_MULTI wants
+            size_t const end = m_data.size() - len + i;
+            m_published = std::min((end + 3) & ~static_cast<size_t>(3),m_data.size());
+            m_changed.notify_all();
+            break;
+        }
+    }
+}
+
+void CCloneImage::finish()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if ( m_published == 0){
+        m_error = "source board flash is blank";
+    }
+    m_done = true;
+    m_changed.notify_all();
+}
+
+void CCloneImage::fail(std::string const & reason)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_error = reason;
+    m_done = true;
+    m_changed.notify_all();
+}
+
+void CCloneImage::wait_ready()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_changed.wait(lock,[this]{ return m_done || (m_published > 0);});
+    if ( !m_error.empty()){
+        throw std::runtime_error("clone source failed : " + m_error);
+    }
+}
+
+std::unique_ptr<CFirmwareSource> CCloneImage::reader()
+{
+    return std::unique_ptr<CFirmwareSource>{new CReader(*this)};
+}
+
+size_t CCloneImage::m_read(size_t pos, uint8_t * dest, size_t max)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_changed.wait(lock,[this,pos]{ return m_done || (m_published > pos);});
+    if ( !m_error.empty()){
+        throw std::runtime_error("clone source failed : " + m_error);
+    }
+    size_t const n = std::min(max,m_published - pos);
+    memcpy(dest,m_data.data() + pos,n);
+    return n;
+}
+
+std::vector<fleet_result> clone_firmware(std::string const & source_port,
+    CFleet & targets, CProgressRenderer & progress, CMetrics * metrics)
+{
+    CCloneImage image;
+    fleet_result source_result{source_port,false,""};
+    CProgressChannel * channel = progress.add_channel(source_port);
+
+    std::thread source{[&]{
+        try{
+            COSDConn conn{source_port};
+            conn.set_progress(channel);
+            conn.set_metrics(metrics);
+            conn.set_transport_factory(targets.get_transport_factory());
+            conn.set_timing(targets.get_timing());
+            conn.read_flash([&image](uint8_t const * data, size_t len){ image.append(data,len);});
+            image.finish();
+            source_result.ok = true;
+            source_result.message = "OK";
+        }catch (std::exception & e){
+            image.fail(e.what());
+            source_result.message = e.what();
+        }
+    }};
+
+    auto results = targets.run([&image](COSDConn & conn){
+        image.wait_ready();
+        conn.upload_firmware(image.reader());
+    });
+    source.join();
+    results.insert(results.begin(),source_result);
+    return results;
+}
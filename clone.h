@@ -0,0 +1,77 @@
+#pragma once
+
+/*
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+ 
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program. If not, see <http://www.gnu.org/licenses/>
+
+Authors:
+   Andy Little
+   Tom Ren
+  
+*/
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+
+#include "fleet.h"
+
+class CFirmwareSource;
+class CMetrics;
+class CProgressRenderer;
+
+/*
+  flash image read back from one board, handed to the boards it is copied to
+  while it is still arriving, so they can start programming before the read back is done.
+  Runs of 0xff are held back until something else follows them, so the erased
+  tail of the source flash isnt programmed. Readers only see the end of the image
+  once the whole flash has been read, so a target cant finish and reboot with a bad image.
+  Targets wait for the first of the image before erasing, so a source that cant be
+  read leaves them as they were.
+*/
+class CCloneImage{
+public:
+    CCloneImage();
+
+    // from the source board, in address order
+    void append(uint8_t const * data, size_t len);
+    // all of the flash has been read and checked
+    void finish();
+    // the read back failed, readers throw
+    void fail(std::string const & reason);
+    // until there is some of the image to program. Throws if the read back failed first
+    void wait_ready();
+
+    // the image from the start, for one target. The image must outlive it
+    std::unique_ptr<CFirmwareSource> reader();
+
+private:
+    class CReader;
+    size_t m_read(size_t pos, uint8_t * dest, size_t max);
+
+    std::mutex m_mutex;
+    std::condition_variable m_changed;
+    std::vector<uint8_t> m_data;
+    size_t m_published;
+    bool m_done;
+    std::string m_error;
+};
+
+// copies the firmware on the source board to each target board.
+// returns the result for the source followed by those for the targets
+std::vector<fleet_result> clone_firmware(std::string const & source_port,
+    CFleet & targets, CProgressRenderer & progress, CMetrics * metrics);
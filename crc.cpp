@@ -20,6 +20,8 @@
 #include <cstdint>
 #include <vector>
 
+#include "crc.h"
+
 namespace {
 
       constexpr uint32_t crctab [] = {
@@ -75,9 +77,21 @@ namespace px4Uploader{
 
    int32_t crc(std::vector<uint8_t> const & bytes,int32_t padlen)
    {
-      uint32_t state = crc32(bytes, 0);
+      return crc_pad(crc32(bytes, 0),bytes.size(),padlen);
+   }
 
-      for (int32_t i = bytes.size(); i < (padlen -1); i += 4)
+   uint32_t crc_update(uint8_t const * bytes, size_t len, uint32_t state)
+   {
+      for ( size_t i = 0; i < len; ++i){
+          uint32_t index = ((state ^ bytes[i]) & 0xff);
+          state = crctab[index] ^ (state >> 8);
+      }
+      return state;
+   }
+
+   int32_t crc_pad(uint32_t state, int32_t len, int32_t padlen)
+   {
+      for (int32_t i = len; i < (padlen -1); i += 4)
       {
           state = crc32(crcpad, state);
       }
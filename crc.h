@@ -0,0 +1,37 @@
+#pragma once
+
+/*
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+ 
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program. If not, see <http://www.gnu.org/licenses/>
+
+Authors:
+   Andy Little
+   Tom Ren
+  
+*/
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+namespace px4Uploader{
+
+   // crc of the whole image, padded with 0xff up to padlen ( the board flash size)
+   int32_t crc(std::vector<uint8_t> const & bytes,int32_t padlen);
+
+   // incremental form for images that arrive in chunks
+   // start with state = 0, feed each chunk in order
+   // then crc_pad with the total length to get the same result as crc()
+   uint32_t crc_update(uint8_t const * bytes, size_t len, uint32_t state);
+   int32_t crc_pad(uint32_t state, int32_t len, int32_t padlen);
+}
@@ -0,0 +1,216 @@
+/*
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+ 
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program. If not, see <http://www.gnu.org/licenses/>
+
+Authors:
+   Andy Little
+   Tom Ren
+*/
+
+#include "firmware.h"
+
+#include <fstream>
+#include <stdexcept>
+#include <cstring>
+
+#include "crc.h"
+#include "lz4frame.h"
+
+namespace {
+
+    // chunks buffered ahead of the upload loop
+#ifdef PLAYUAVOSD_SMALL
+    constexpr size_t queue_depth = 4;
+#else
+    constexpr size_t queue_depth = 64;
+#endif
+
+    class CRawFirmwareSource : public CFirmwareSource{
+    public:
+        explicit CRawFirmwareSource(std::string const & filename)
+        : m_in(filename, std::ios_base::in | std::ios_base::binary)
+        {
+            if ( !m_in || !m_in.good() ){
+                throw std::runtime_error("Failed to open bin file");
+            }
+            m_in.seekg(0,m_in.end);
+            m_size = m_in.tellg();
+            m_in.seekg(0,m_in.beg);
+        }
+
+        size_t read(uint8_t * dest, size_t max)
+        {
+            m_in.read(reinterpret_cast<char*>(dest),max);
+            return m_in.gcount();
+        }
+
+        int32_t size_hint() const
+        {
+            return m_size;
+        }
+    private:
+        std::ifstream m_in;
+        int32_t m_size;
+    };
+
+    class CLz4FirmwareSource : public CFirmwareSource{
+    public:
+        explicit CLz4FirmwareSource(std::string const & filename)
+        : m_in(filename, std::ios_base::in | std::ios_base::binary), m_reader(m_in){}
+
+        size_t read(uint8_t * dest, size_t max)
+        {
+            return m_reader.read(dest,max);
+        }
+
+        int32_t size_hint() const
+        {
+            return m_reader.content_size();
+        }
+    private:
+        std::ifstream m_in;
+        CLz4FrameReader m_reader;
+    };
+
+} // namespace
+
+std::unique_ptr<CFirmwareSource> CFirmwareSource::open(std::string const & filename)
+{
+    std::ifstream in( filename, std::ios_base::in | std::ios_base::binary);
+    if ( !in || !in.good() ){
+        throw std::runtime_error("Failed to open bin file");
+    }
+    uint8_t magic[4] = {0};
+    in.read(reinterpret_cast<char*>(magic),4);
+    in.close();
+    uint32_t const id = magic[0] | (magic[1] << 8) | (magic[2] << 16) | (static_cast<uint32_t>(magic[3]) << 24);
+    if ( id == CLz4FrameReader::frame_magic){
+        return std::unique_ptr<CFirmwareSource>{new CLz4FirmwareSource(filename)};
+    }
+    return std::unique_ptr<CFirmwareSource>{new CRawFirmwareSource(filename)};
+}
+
+CFirmwareStream::CFirmwareStream(std::string const & filename, size_t chunk_size)
+: CFirmwareStream{CFirmwareSource::open(filename),chunk_size}
+{}
+
+CFirmwareStream::CFirmwareStream(std::unique_ptr<CFirmwareSource> source, size_t chunk_size)
+: m_source{std::move(source)}
+ ,m_chunk_size{chunk_size}
+ ,m_queue{queue_depth}
+ ,m_size_hint{m_source->size_hint()}
+ ,m_image_size{0}
+ ,m_crc_state{0}
+ ,m_bytes_produced{0}
+ ,m_produced_crc{0}
+{
+    if ( (chunk_size == 0) || (chunk_size > FirmwareChunk::max_len)){
+        throw std::runtime_error("firmware stream : bad chunk size");
+    }
+}
+
+CFirmwareStream::~CFirmwareStream()
+{
+    stop();
+}
+
+void CFirmwareStream::set_chunk_size(size_t chunk_size)
+{
+    if ( m_thread.joinable()){
+        throw std::runtime_error("firmware stream : chunk size set after start");
+    }
+    if ( (chunk_size == 0) || (chunk_size > FirmwareChunk::max_len)){
+        throw std::runtime_error("firmware stream : bad chunk size");
+    }
+    m_chunk_size = chunk_size;
+}
+
+void CFirmwareStream::start()
+{
+    if ( !m_thread.joinable()){
+        m_thread = std::thread{&CFirmwareStream::m_produce,this};
+    }
+}
+
+void CFirmwareStream::stop()
+{
+    m_queue.close();
+    if ( m_thread.joinable()){
+        m_thread.join();
+    }
+}
+
+bool CFirmwareStream::next_chunk(FirmwareChunk & chunk)
+{
+    start();
+    if ( m_queue.pop(chunk)){
+        return true;
+    }
+    if ( m_thread.joinable()){
+        m_thread.join();
+    }
+    if ( m_error){
+        std::rethrow_exception(m_error);
+    }
+    m_image_size = m_bytes_produced;
+    m_crc_state = m_produced_crc;
+    return false;
+}
+
+bool CFirmwareStream::m_push(FirmwareChunk & chunk)
+{
+    m_produced_crc = px4Uploader::crc_update(chunk.data,chunk.len,m_produced_crc);
+    m_bytes_produced += chunk.len;
+    bool const result = m_queue.push(chunk);
+    chunk.len = 0;
+    return result;
+}
+
+void CFirmwareStream::m_produce()
+{
+    try{
+        FirmwareChunk chunk;
+        chunk.len = 0;
+        int32_t file_size = 0;
+        for (;;){
+            size_t const n = m_source->read(chunk.data + chunk.len, m_chunk_size - chunk.len);
+            if ( n == 0){
+                break;
+            }
+            chunk.len += n;
+            file_size += n;
+            if ( chunk.len == m_chunk_size){
+                if (!m_push(chunk)){
+                    return;
+                }
+            }
+        }
+        // image is padded with 0xff as in the original whole file upload
+        int32_t pad = file_size % 4;
+        while ( pad > 0){
+            chunk.data[chunk.len++] = 0xff;
+            --pad;
+            if ( chunk.len == m_chunk_size){
+                if (!m_push(chunk)){
+                    return;
+                }
+            }
+        }
+        if ( chunk.len > 0){
+            m_push(chunk);
+        }
+    }catch (...){
+        m_error = std::current_exception();
+    }
+    m_queue.close();
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+/*
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+ 
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program. If not, see <http://www.gnu.org/licenses/>
+
+Authors:
+   Andy Little
+   Tom Ren
+  
+*/
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <memory>
+#include <thread>
+#include <exception>
+
+#include "bounded_queue.h"
+
+// raw firmware bytes, from a file ( either a plain .bin or lz4 compressed) or another board
+class CFirmwareSource{
+public:
+    virtual ~CFirmwareSource(){}
+    // returns number of bytes put in dest, 0 at end of image
+    virtual size_t read(uint8_t * dest, size_t max) = 0;
+    // size of the unpadded image if the format tells us, else -1
+    virtual int32_t size_hint() const { return -1;}
+
+    // looks at the start of the file to decide the format
+    static std::unique_ptr<CFirmwareSource> open(std::string const & filename);
+};
+
+// one PROG_MULTI worth of image
+struct FirmwareChunk{
+    static constexpr size_t max_len = 252;
+    uint8_t data[max_len];
+    uint8_t len;
+};
+
+/*
+  reads ( and decompresses) the image on a producer thread and hands it out
+  as padded upload sized chunks through a bounded queue.
+  The crc is accumulated by the producer as the data goes past,
+  so the image is never held in memory and only read once.
+*/
+class CFirmwareStream{
+public:
+    CFirmwareStream(std::string const & filename, size_t chunk_size);
+    CFirmwareStream(std::unique_ptr<CFirmwareSource> source, size_t chunk_size);
+    ~CFirmwareStream();
+
+    // chunk size for the board, before start
+    void set_chunk_size(size_t chunk_size);
+    // start producing. Can be done early so reading overlaps with e.g chip erase
+    void start();
+    // false at end of image. Rethrows any error from the producer
+    bool next_chunk(FirmwareChunk & chunk);
+    // abandon the stream early
+    void stop();
+    // for progress display, -1 if not known in advance
+    int32_t size_hint() const { return m_size_hint;}
+
+    // valid after next_chunk has returned false
+    int32_t image_size() const { return m_image_size;}
+    uint32_t crc_state() const { return m_crc_state;}
+
+private:
+    void m_produce();
+    bool m_push(FirmwareChunk & chunk);
+
+    std::unique_ptr<CFirmwareSource> m_source;
+    size_t m_chunk_size;
+    CBoundedQueue<FirmwareChunk> m_queue;
+    std::thread m_thread;
+    std::exception_ptr m_error;
+    int32_t const m_size_hint;
+    int32_t m_image_size;
+    uint32_t m_crc_state;
+    int32_t m_bytes_produced;
+    uint32_t m_produced_crc;
+};
@@ -0,0 +1,104 @@
+/*
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+ 
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program. If not, see <http://www.gnu.org/licenses/>
+
+Authors:
+   Andy Little
+   Tom Ren
+*/
+
+#include "fleet.h"
+
+#include <thread>
+#include <algorithm>
+#include <cstring>
+#include <cstdlib>
+#include <dirent.h>
+
+#include "osdconn.h"
+#include "progress.h"
+#include "hub.h"
+
+constexpr size_t CFleet::default_hub_limit;
+
+CFleet::CFleet(std::vector<std::string> const & ports, CProgressRenderer & progress, CMetrics * metrics)
+: m_ports(ports), m_progress(progress), m_metrics{metrics}, m_hub_limit{default_hub_limit}, m_timing{nullptr}
+{}
+
+std::vector<fleet_result> CFleet::run(std::function<void(COSDConn &)> const & job)
+{
+    // every board starts at once, and the slots are per hub so a busy hub doesnt hold up an idle one
+    CHubScheduler scheduler{m_hub_limit};
+    std::vector<fleet_result> results(m_ports.size());
+    std::vector<std::thread> threads;
+    for ( size_t i = 0; i < m_ports.size(); ++i){
+        results[i].port = m_ports[i];
+        results[i].ok = false;
+        CProgressChannel * channel = m_progress.add_channel(m_ports[i]);
+        threads.emplace_back([this,i,channel,&job,&results,&scheduler]{
+            fleet_result & result = results[i];
+            try{
+                COSDConn conn{m_ports[i]};
+                conn.set_progress(channel);
+                conn.set_metrics(m_metrics);
+                conn.set_hub_scheduler(&scheduler);
+                conn.set_transport_factory(m_transport_factory);
+                conn.set_timing(m_timing);
+                job(conn);
+                result.ok = true;
+                result.message = "OK";
+            }catch (std::exception & e){
+                result.message = e.what();
+            }
+        });
+    }
+    for ( auto & t : threads){
+        t.join();
+    }
+    return results;
+}
+
+std::vector<std::string> CFleet::find_ports()
+{
+    std::vector<int> numbers;
+    DIR * dir = opendir("/dev");
+    if ( dir != nullptr){
+        while ( dirent * entry = readdir(dir)){
+            if ( strncmp(entry->d_name,"ttyACM",6) == 0){
+                numbers.push_back(atoi(entry->d_name + 6));
+            }
+        }
+        closedir(dir);
+    }
+    std::sort(numbers.begin(),numbers.end());
+    std::vector<std::string> ports;
+    for ( int n : numbers){
+        ports.push_back("/dev/ttyACM" + std::to_string(n));
+    }
+    return ports;
+}
+
+size_t CFleet::report(std::vector<fleet_result> const & results, std::ostream & out)
+{
+    size_t failed = 0;
+    for ( auto const & r : results){
+        out << r.port << " : " << (r.ok ? "PASS" : "FAIL") ;
+        if ( !r.ok){
+            out << " : " << r.message;
+            ++failed;
+        }
+        out << '\n';
+    }
+    out << results.size() - failed << " of " << results.size() << " boards OK\n";
+    return failed;
+}
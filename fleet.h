@@ -0,0 +1,79 @@
+#pragma once
+
+/*
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+ 
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program. If not, see <http://www.gnu.org/licenses/>
+
+Authors:
+   Andy Little
+   Tom Ren
+  
+*/
+
+#include <string>
+#include <vector>
+#include <functional>
+#include <iostream>
+
+#include "transport.h"
+
+class COSDConn;
+class CMetrics;
+class CProgressRenderer;
+class CTimingModel;
+
+struct fleet_result{
+    std::string port;
+    bool ok;
+    std::string message;
+};
+
+/*
+  runs the same job on many boards at once, each board with its own
+  connection and thread, and collects a result per board.
+  Every board starts at once. They share a CHubScheduler, so only so many on one
+  usb hub program or read back firmware at the same time
+*/
+class CFleet{
+public:
+    CFleet(std::vector<std::string> const & ports, CProgressRenderer & progress, CMetrics * metrics);
+
+    std::vector<fleet_result> run(std::function<void(COSDConn &)> const & job);
+
+    // boards on one usb hub programming or reading back firmware at once, 0 for no limit
+    void set_hub_limit(size_t limit) { m_hub_limit = limit;}
+    // optional, for every board connection
+    void set_transport_factory(transport_factory const & factory) { m_transport_factory = factory;}
+    transport_factory const & get_transport_factory() const { return m_transport_factory;}
+    // optional, shared by every board connection
+    void set_timing(CTimingModel * timing) { m_timing = timing;}
+    CTimingModel * get_timing() const { return m_timing;}
+
+    std::vector<std::string> const & ports() const { return m_ports;}
+
+    // the /dev/ttyACM* devices present now, in number order
+    static std::vector<std::string> find_ports();
+    // prints one line per board, returns the number that failed
+    static size_t report(std::vector<fleet_result> const & results, std::ostream & out = std::cout);
+
+    // two full speed boards per usb 2.0 hub keep clear of sync timeouts
+    static constexpr size_t default_hub_limit = 2;
+
+private:
+    std::vector<std::string> const m_ports;
+    CProgressRenderer & m_progress;
+    CMetrics * m_metrics;
+    size_t m_hub_limit;
+    transport_factory m_transport_factory;
+    CTimingModel * m_timing;
+};
@@ -0,0 +1,148 @@
+/*
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+ 
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program. If not, see <http://www.gnu.org/licenses/>
+
+Authors:
+   Andy Little
+   Tom Ren
+*/
+
+
+#include "heapcount.h"
+
+#include <atomic>
+#include <new>
+#include <cstdlib>
+#include <stdexcept>
+
+#include "params.h"
+#include "firmware.h"
+
+namespace {
+
+    std::atomic<size_t> heap_current{0};
+    std::atomic<size_t> heap_peak{0};
+    std::atomic<uint64_t> heap_allocations{0};
+
+    // each block starts with its size, keeping the alignment malloc gives
+    constexpr size_t header_size = 16;
+
+    void * counted_alloc(size_t size) noexcept
+    {
+        void * const p = malloc(size + header_size);
+        if ( p == nullptr){
+            return nullptr;
+        }
+        *static_cast<size_t*>(p) = size;
+        size_t const now = heap_current.fetch_add(size) + size;
+        size_t peak = heap_peak.load();
+        while ( (now > peak) && !heap_peak.compare_exchange_weak(peak,now)){}
+        ++heap_allocations;
+        return static_cast<char*>(p) + header_size;
+    }
+
+    void counted_free(void * p) noexcept
+    {
+        if ( p != nullptr){
+            void * const block = static_cast<char*>(p) - header_size;
+            heap_current.fetch_sub(*static_cast<size_t*>(block));
+            free(block);
+        }
+    }
+
+    void * throwing_alloc(size_t size)
+    {
+        for (;;){
+            void * const p = counted_alloc(size);
+            if ( p != nullptr){
+                return p;
+            }
+            std::new_handler const handler = std::get_new_handler();
+            if ( handler == nullptr){
+                throw std::bad_alloc{};
+            }
+            handler();
+        }
+    }
+
+} // namespace
+
+void * operator new(size_t size) { return throwing_alloc(size);}
+void * operator new[](size_t size) { return throwing_alloc(size);}
+void * operator new(size_t size, std::nothrow_t const &) noexcept { return counted_alloc(size);}
+void * operator new[](size_t size, std::nothrow_t const &) noexcept { return counted_alloc(size);}
+void operator delete(void * p) noexcept { counted_free(p);}
+void operator delete[](void * p) noexcept { counted_free(p);}
+void operator delete(void * p, std::nothrow_t const &) noexcept { counted_free(p);}
+void operator delete[](void * p, std::nothrow_t const &) noexcept { counted_free(p);}
+
+constexpr size_t CHeapCount::params_budget;
+constexpr size_t CHeapCount::firmware_budget;
+
+size_t CHeapCount::current()
+{
+    return heap_current.load();
+}
+
+size_t CHeapCount::peak()
+{
+    return heap_peak.load();
+}
+
+uint64_t CHeapCount::allocations()
+{
+    return heap_allocations.load();
+}
+
+void CHeapCount::reset_peak()
+{
+    heap_peak.store(heap_current.load());
+}
+
+bool CHeapCount::check(std::string const & firmware_filename, std::string const & params_filename, std::ostream & out)
+{
+    reset_peak();
+    size_t base = current();
+    {
+        COSDParam osdparams;
+        uint8_t paramsbuf[PARAMS_BUF_SIZE];
+        osdparams.get_default_params(paramsbuf);
+        if ( !params_filename.empty() && !osdparams.load_params_from_file(params_filename, paramsbuf)){
+            throw std::runtime_error("failed to load parameters");
+        }
+    }
+    size_t const params_peak = peak() - base;
+
+    reset_peak();
+    base = current();
+    uint64_t const allocations_before = allocations();
+    int32_t image_size = 0;
+    {
+        CFirmwareStream firmware{firmware_filename, FirmwareChunk::max_len};
+        firmware.start();
+        FirmwareChunk chunk;
+        while ( firmware.next_chunk(chunk)){}
+        image_size = firmware.image_size();
+    }
+    size_t const firmware_peak = peak() - base;
+    uint64_t const firmware_allocations = allocations() - allocations_before;
+
+    bool const params_ok = params_peak <= params_budget;
+    bool const firmware_ok = firmware_peak <= firmware_budget;
+    out << "parameters : peak heap " << params_peak << " bytes, budget " << params_budget
+        << (params_ok ? " OK" : " OVER") << '\n';
+    out << "firmware ( " << image_size << " bytes) : peak heap " << firmware_peak << " bytes in "
+        << firmware_allocations << " allocations, budget " << firmware_budget
+        << (firmware_ok ? " OK" : " OVER") << '\n';
+    return params_ok && firmware_ok;
+}
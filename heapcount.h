@@ -0,0 +1,57 @@
+#pragma once
+
+/*
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+ 
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program. If not, see <http://www.gnu.org/licenses/>
+
+Authors:
+   Andy Little
+   Tom Ren
+  
+*/
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <iostream>
+
+/*
+  counts the process heap use, by replacing the global operator new and delete, to check the
+  fixed footprint of the small build ( make PROFILE=small). Linked into the app only, not the
+  shared library, so an application using the library keeps its own allocator.
+  The check loads the parameters and streams the whole firmware image, as a flashing host does,
+  and compares the most heap each used with the budget for the build. Neither should depend on
+  the size of the image
+*/
+class CHeapCount{
+public:
+    // bytes allocated and not yet freed
+    static size_t current();
+    // most in use since the last reset_peak
+    static size_t peak();
+    static uint64_t allocations();
+    static void reset_peak();
+
+#ifdef PLAYUAVOSD_SMALL
+    static constexpr size_t params_budget = 16 * 1024;
+    static constexpr size_t firmware_budget = 256 * 1024;
+#else
+    // lz4 frames with 4 Mbyte blocks. The block, and the output growing to up to twice the block and window
+    static constexpr size_t params_budget = 16 * 1024;
+    static constexpr size_t firmware_budget = 16 * 1024 * 1024;
+#endif
+
+    // params_filename may be empty for the defaults. True if both are within budget
+    static bool check(std::string const & firmware_filename, std::string const & params_filename,
+        std::ostream & out = std::cout);
+};
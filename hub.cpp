@@ -0,0 +1,85 @@
+/*
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+ 
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program. If not, see <http://www.gnu.org/licenses/>
+
+Authors:
+   Andy Little
+   Tom Ren
+*/
+
+
+#include "hub.h"
+
+#include <climits>
+#include <cstdlib>
+
+CHubScheduler::CHubScheduler(size_t per_hub_limit)
+: m_limit{per_hub_limit}
+{}
+
+void CHubScheduler::acquire(std::string const & hub)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_released.wait(lock,[this,&hub]{ return (m_limit == 0) || (m_active[hub] < m_limit);});
+    ++m_active[hub];
+}
+
+void CHubScheduler::release(std::string const & hub)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if ( m_active[hub] > 0){
+        --m_active[hub];
+    }
+    m_released.notify_all();
+}
+
+/*
+  /sys/class/tty/ttyACM0/device links to the usb interface, e.g
+  /sys/devices/pci0000:00/0000:00:14.0/usb1/1-1/1-1.2/1-1.2:1.0
+  whose parent is the board ( 1-1.2) and grandparent the hub it is on ( 1-1)
+*/
+std::string CHubScheduler::hub_of(std::string const & port)
+{
+    if ( port.compare(0,5,"/dev/") != 0){
+        return port;
+    }
+    std::string const link = "/sys/class/tty/" + port.substr(port.rfind('/') + 1) + "/device";
+    char path[PATH_MAX];
+    if ( realpath(link.c_str(),path) == nullptr){
+        return port;
+    }
+    std::string hub = path;
+    for ( int i = 0; i < 2; ++i){
+        size_t const slash = hub.rfind('/');
+        if ( (slash == std::string::npos) || (slash == 0)){
+            return port;
+        }
+        hub.erase(slash);
+    }
+    return hub;
+}
+
+CHubSlot::CHubSlot(CHubScheduler * scheduler, std::string const & hub)
+: m_scheduler{scheduler}, m_hub(hub)
+{
+    if ( m_scheduler != nullptr){
+        m_scheduler->acquire(m_hub);
+    }
+}
+
+CHubSlot::~CHubSlot()
+{
+    if ( m_scheduler != nullptr){
+        m_scheduler->release(m_hub);
+    }
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+/*
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+ 
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program. If not, see <http://www.gnu.org/licenses/>
+
+Authors:
+   Andy Little
+   Tom Ren
+  
+*/
+
+#include <cstddef>
+#include <string>
+#include <map>
+#include <mutex>
+#include <condition_variable>
+
+/*
+  boards on one usb 2.0 hub share its bandwidth, and with too many transferring
+  at once they all slow down until syncs time out.
+  The scheduler caps how many boards per hub are in a bus heavy phase
+  ( programming, flash read back) at once.
+  Erase and reboot dont need the bus so dont hold a slot, and boards waiting for
+  a slot can erase meanwhile. Parameter images are too small to need one.
+*/
+class CHubScheduler{
+public:
+    // per_hub_limit of 0 means no limit
+    explicit CHubScheduler(size_t per_hub_limit);
+
+    void acquire(std::string const & hub);
+    void release(std::string const & hub);
+
+    // the usb hub the port is plugged into from sysfs, else the port itself
+    static std::string hub_of(std::string const & port);
+
+private:
+    size_t const m_limit;
+    std::map<std::string,size_t> m_active;
+    std::mutex m_mutex;
+    std::condition_variable m_released;
+};
+
+// holds a slot on a hub for a scope. scheduler may be null
+class CHubSlot{
+public:
+    CHubSlot(CHubScheduler * scheduler, std::string const & hub);
+    ~CHubSlot();
+private:
+    CHubSlot(CHubSlot const &) = delete;
+    CHubSlot & operator = (CHubSlot const &) = delete;
+    CHubScheduler * const m_scheduler;
+    std::string const m_hub;
+};
@@ -0,0 +1,275 @@
+/*
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+ 
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program. If not, see <http://www.gnu.org/licenses/>
+
+Authors:
+   Andy Little
+   Tom Ren
+*/
+
+
+#include "inventory.h"
+
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <cstdio>
+#include <cstdlib>
+#include <climits>
+
+#include "osdconn.h"
+
+namespace {
+
+    // boards from old bootloaders have no serial, so are kept by port
+    std::string key_of(board_identity const & board)
+    {
+        return board.serial.empty() ? "@" + board.port : board.serial;
+    }
+
+    std::string field(std::string const & s)
+    {
+        return s.empty() ? "-" : s;
+    }
+
+    std::string unfield(std::string const & s)
+    {
+        return (s == "-") ? "" : s;
+    }
+
+    std::string hex(uint32_t v)
+    {
+        char buf[11];
+        snprintf(buf,sizeof buf,"0x%08x",v);
+        return buf;
+    }
+}
+
+CInventory::CInventory(std::string const & filename)
+: m_filename(filename)
+{
+    std::ifstream in(filename);
+    std::string line;
+    for ( size_t line_number = 1; std::getline(in,line); ++line_number){
+        if ( line.empty() || (line[0] == '#')){
+            continue;
+        }
+        std::istringstream fields(line);
+        board_identity board;
+        std::string serial, port, usb_serial, otp;
+        fields >> serial >> std::hex >> board.chip_id >> board.board_id >> board.board_rev
+            >> board.flash_size >> board.bl_rev >> board.firmware_crc
+            >> std::dec >> board.probed >> port >> usb_serial >> otp;
+        if ( !fields){
+            throw std::runtime_error("inventory file " + filename + " is corrupt at line " + std::to_string(line_number));
+        }
+        board.serial = unfield(serial);
+        board.port = unfield(port);
+        board.usb_serial = unfield(usb_serial);
+        board.otp = unfield(otp);
+        m_boards[key_of(board)] = board;
+    }
+}
+
+board_identity const * CInventory::find(std::string const & serial) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto const iter = m_boards.find(serial);
+    return (iter != m_boards.end()) ? &iter->second : nullptr;
+}
+
+board_identity const * CInventory::m_find_usb(std::string const & usb_serial) const
+{
+    if ( !usb_serial.empty()){
+        for ( auto const & entry : m_boards){
+            if ( entry.second.usb_serial == usb_serial){
+                return &entry.second;
+            }
+        }
+    }
+    return nullptr;
+}
+
+// by the usb serial of the port, or for boards not on usb by where they were
+board_identity const * CInventory::m_find_port(std::string const & port) const
+{
+    board_identity const * board = m_find_usb(usb_serial_of(port));
+    if ( board == nullptr){
+        for ( auto const & entry : m_boards){
+            if ( entry.second.usb_serial.empty() && (entry.second.port == port)){
+                return &entry.second;
+            }
+        }
+    }
+    return board;
+}
+
+std::vector<std::string> CInventory::unknown_ports(std::vector<std::string> const & ports, bool all) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::vector<std::string> result;
+    for ( auto const & port : ports){
+        board_identity const * board = m_find_usb(usb_serial_of(port));
+        if ( all || (board == nullptr) || (board->probed == 0)){
+            result.push_back(port);
+        }
+    }
+    return result;
+}
+
+std::vector<fleet_result> CInventory::probe(CFleet & boards)
+{
+    // before the boards go to the bootloader and their ports come and go
+    std::map<std::string,std::string> usb_serials;
+    for ( auto const & port : boards.ports()){
+        usb_serials[port] = usb_serial_of(port);
+    }
+    return boards.run([this,&usb_serials](COSDConn & conn){
+        board_identity board = conn.read_identity();
+        auto const iter = usb_serials.find(board.port);
+        if ( iter != usb_serials.end()){
+            board.usb_serial = iter->second;
+        }
+        update(board);
+    });
+}
+
+std::string CInventory::port_of(std::string const & serial) const
+{
+    board_identity const * board = find(serial);
+    if ( board == nullptr){
+        throw std::runtime_error("board " + serial + " is not in the inventory " + m_filename);
+    }
+    // boards not on usb stay where they were
+    if ( board->usb_serial.empty()){
+        return board->port;
+    }
+    for ( auto const & port : CFleet::find_ports()){
+        if ( usb_serial_of(port) == board->usb_serial){
+            return port;
+        }
+    }
+    throw std::runtime_error("board " + serial + " is not attached");
+}
+
+std::string CInventory::serial_of(std::string const & port) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    board_identity const * board = m_find_port(port);
+    return (board != nullptr) ? board->serial : "";
+}
+
+void CInventory::update(board_identity const & board)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    // a board known by usb serial that has since been given a serial, or moved port
+    for ( auto iter = m_boards.begin(); iter != m_boards.end(); ){
+        if ( !board.usb_serial.empty() && (iter->second.usb_serial == board.usb_serial)){
+            iter = m_boards.erase(iter);
+        }else{
+            ++iter;
+        }
+    }
+    m_boards[key_of(board)] = board;
+}
+
+size_t CInventory::reflashing(std::vector<std::string> const & ports)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    size_t count = 0;
+    for ( auto const & port : ports){
+        if ( board_identity const * board = m_find_port(port)){
+            board_identity & entry = m_boards[key_of(*board)];
+            entry.firmware_crc = 0;
+            entry.probed = 0;
+            ++count;
+        }
+    }
+    return count;
+}
+
+void CInventory::save() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::string const tmp = m_filename + ".tmp";
+    {
+        std::ofstream out(tmp, std::ios_base::out | std::ios_base::trunc);
+        out << "# playuavosd board inventory, sorted by serial\n";
+        out << "# serial chip_id board_id board_rev flash_size bl_rev firmware_crc probed port usb_serial otp\n";
+        for ( auto const & entry : m_boards){
+            board_identity const & b = entry.second;
+            out << field(b.serial) << ' ' << hex(b.chip_id) << ' ' << hex(b.board_id) << ' '
+                << hex(b.board_rev) << ' ' << hex(b.flash_size) << ' ' << hex(b.bl_rev) << ' '
+                << hex(b.firmware_crc) << ' ' << b.probed << ' ' << field(b.port) << ' '
+                << field(b.usb_serial) << ' ' << field(b.otp) << '\n';
+        }
+        if ( !out.good()){
+            remove(tmp.c_str());
+            throw std::runtime_error("failed to write inventory file " + m_filename);
+        }
+    }
+    if ( rename(tmp.c_str(),m_filename.c_str()) != 0){
+        remove(tmp.c_str());
+        throw std::runtime_error("failed to write inventory file " + m_filename);
+    }
+}
+
+void CInventory::report(std::vector<std::string> const & ports, std::ostream & out) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for ( auto const & port : ports){
+        board_identity const * board = m_find_port(port);
+        out << port << " : ";
+        if ( board == nullptr){
+            out << "unknown\n";
+            continue;
+        }
+        out << "serial " << field(board->serial) << ", board id " << board->board_id
+            << " rev " << board->board_rev << ", chip " << hex(board->chip_id)
+            << ", flash " << board->flash_size << ", bootloader rev " << board->bl_rev << ", flash crc ";
+        if ( board->probed == 0){
+            out << "unknown, flashed since probed\n";
+        }else{
+            out << hex(board->firmware_crc) << '\n';
+        }
+    }
+}
+
+std::string CInventory::default_filename()
+{
+    char const * home = getenv("HOME");
+    return std::string{(home != nullptr) ? home : "."} + "/.playuavosd_inventory";
+}
+
+// /sys/class/tty/ttyACM0/device is the usb interface, whose parent is the usb device
+std::string CInventory::usb_serial_of(std::string const & port)
+{
+    if ( port.compare(0,5,"/dev/") != 0){
+        return "";
+    }
+    std::string const link = "/sys/class/tty/" + port.substr(port.rfind('/') + 1) + "/device";
+    char path[PATH_MAX];
+    if ( realpath(link.c_str(),path) == nullptr){
+        return "";
+    }
+    std::string device = path;
+    size_t const slash = device.rfind('/');
+    if ( (slash == std::string::npos) || (slash == 0)){
+        return "";
+    }
+    device.erase(slash);
+    std::ifstream in(device + "/serial");
+    std::string serial;
+    std::getline(in,serial);
+    return serial;
+}
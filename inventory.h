@@ -0,0 +1,91 @@
+#pragma once
+
+/*
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+ 
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program. If not, see <http://www.gnu.org/licenses/>
+
+Authors:
+   Andy Little
+   Tom Ren
+  
+*/
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <iostream>
+
+#include "fleet.h"
+
+// what a board says about itself in the bootloader
+struct board_identity{
+    std::string serial;       // chip unique id ( GET_SN), hex. Empty before bootloader rev 4
+    uint32_t chip_id;         // mcu IDCODE ( GET_CHIP)
+    uint32_t board_id;
+    uint32_t board_rev;
+    uint32_t flash_size;
+    uint32_t bl_rev;
+    uint32_t firmware_crc;    // GET_CRC, over the whole flash
+    std::string otp;          // start of the otp area, hex
+    std::string port;         // where it was last probed
+    std::string usb_serial;   // of the port, to know the board again without probing it
+    int64_t probed;           // unix time, 0 if the board has been flashed since
+};
+
+/*
+  a cache of board identities keyed by serial, kept in a text file sorted by serial,
+  one board per line :
+     serial chip_id board_id board_rev flash_size bl_rev firmware_crc probed port usb_serial otp
+  with '-' for an empty field. Lines starting with '#' are comments.
+  Boards are known again by the usb serial number of their port, so only new
+  boards, and those flashed since they were probed, need to go to the bootloader to be probed.
+*/
+class CInventory{
+public:
+    // loads the file if it exists
+    explicit CInventory(std::string const & filename);
+
+    board_identity const * find(std::string const & serial) const;
+    // of the ports, those whose board isnt known by its usb serial or has been flashed
+    // since it was probed, or all of them
+    std::vector<std::string> unknown_ports(std::vector<std::string> const & ports, bool all) const;
+    // probes the boards at once, adding them to the inventory
+    std::vector<fleet_result> probe(CFleet & boards);
+    // the attached port of the board with the serial, throws if it cant be found
+    std::string port_of(std::string const & serial) const;
+    // serial of the board on the port, empty if not known
+    std::string serial_of(std::string const & port) const;
+
+    void update(board_identity const & board);
+    // before the boards on the ports are flashed. Their flash crc wont be known until they
+    // are probed again, but they are still found by serial. Returns how many were known
+    size_t reflashing(std::vector<std::string> const & ports);
+    void save() const;
+    // a line for the board on each port
+    void report(std::vector<std::string> const & ports, std::ostream & out = std::cout) const;
+
+    // ~/.playuavosd_inventory
+    static std::string default_filename();
+    // usb serial number of the device a tty port is on, empty if not a usb port
+    static std::string usb_serial_of(std::string const & port);
+
+private:
+    board_identity const * m_find_usb(std::string const & usb_serial) const;
+    board_identity const * m_find_port(std::string const & port) const;
+
+    std::string const m_filename;
+    std::map<std::string,board_identity> m_boards;
+    mutable std::mutex m_mutex;
+};
@@ -0,0 +1,380 @@
+/*
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+ 
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program. If not, see <http://www.gnu.org/licenses/>
+
+Authors:
+   Andy Little
+   Tom Ren
+*/
+
+#include "lz4frame.h"
+
+#include <stdexcept>
+#include <cstring>
+#include <algorithm>
+
+namespace {
+
+    constexpr uint32_t prime1 = 2654435761U;
+    constexpr uint32_t prime2 = 2246822519U;
+    constexpr uint32_t prime3 = 3266489917U;
+    constexpr uint32_t prime4 = 668265263U;
+    constexpr uint32_t prime5 = 374761393U;
+
+    // lz4 matches can reach back this far into previous output
+    constexpr size_t window_size = 64 * 1024;
+
+    // largest block taken. The small build only takes 64k blocks, so holds at most 192k
+#ifdef PLAYUAVOSD_SMALL
+    constexpr size_t block_limit = 64 * 1024;
+    constexpr char const * block_too_big = "lz4 : block too big for the small build, compress with lz4 -B4";
+#else
+    constexpr size_t block_limit = 4 * 1024 * 1024;
+    constexpr char const * block_too_big = "lz4 : block too big";
+#endif
+
+    inline uint32_t rotl(uint32_t v, int n)
+    {
+        return (v << n) | (v >> (32 - n));
+    }
+
+    inline uint32_t get_u32(uint8_t const * p)
+    {
+        return static_cast<uint32_t>(p[0])
+            | (static_cast<uint32_t>(p[1]) << 8)
+            | (static_cast<uint32_t>(p[2]) << 16)
+            | (static_cast<uint32_t>(p[3]) << 24);
+    }
+
+    inline uint32_t xxh_round(uint32_t acc, uint32_t input)
+    {
+        acc += input * prime2;
+        acc = rotl(acc,13);
+        return acc * prime1;
+    }
+
+} // namespace
+
+CLz4FrameReader::xxh32::xxh32()
+:m_mem_size{0},m_total_len{0}
+{
+    m_v[0] = prime1 + prime2;
+    m_v[1] = prime2;
+    m_v[2] = 0;
+    m_v[3] = 0 - prime1;
+}
+
+void CLz4FrameReader::xxh32::update(uint8_t const * data, size_t len)
+{
+    m_total_len += len;
+    if ( (m_mem_size + len) < 16){
+        memcpy(m_mem + m_mem_size, data, len);
+        m_mem_size += len;
+        return;
+    }
+    if ( m_mem_size > 0){
+        size_t const fill = 16 - m_mem_size;
+        memcpy(m_mem + m_mem_size, data, fill);
+        for ( int i = 0; i < 4; ++i){
+            m_v[i] = xxh_round(m_v[i], get_u32(m_mem + 4 * i));
+        }
+        data += fill;
+        len -= fill;
+        m_mem_size = 0;
+    }
+    while ( len >= 16){
+        for ( int i = 0; i < 4; ++i){
+            m_v[i] = xxh_round(m_v[i], get_u32(data + 4 * i));
+        }
+        data += 16;
+        len -= 16;
+    }
+    memcpy(m_mem, data, len);
+    m_mem_size = len;
+}
+
+uint32_t CLz4FrameReader::xxh32::digest() const
+{
+    uint32_t h = 0;
+    if ( m_total_len >= 16){
+        h = rotl(m_v[0],1) + rotl(m_v[1],7) + rotl(m_v[2],12) + rotl(m_v[3],18);
+    }else{
+        h = prime5;
+    }
+    h += static_cast<uint32_t>(m_total_len);
+
+    size_t i = 0;
+    for ( ; (i + 4) <= m_mem_size; i += 4){
+        h += get_u32(m_mem + i) * prime3;
+        h = rotl(h,17) * prime4;
+    }
+    for ( ; i < m_mem_size; ++i){
+        h += m_mem[i] * prime5;
+        h = rotl(h,11) * prime1;
+    }
+    h ^= h >> 15;
+    h *= prime2;
+    h ^= h >> 13;
+    h *= prime3;
+    h ^= h >> 16;
+    return h;
+}
+
+uint32_t CLz4FrameReader::xxh32::hash(uint8_t const * data, size_t len)
+{
+    xxh32 h;
+    h.update(data,len);
+    return h.digest();
+}
+
+CLz4FrameReader::CLz4FrameReader(std::istream & in)
+: m_in(in)
+ ,m_out_pos{0}
+ ,m_block_max{0}
+ ,m_block_checksum{false}
+ ,m_content_checksum{false}
+ ,m_in_frame{false}
+ ,m_eof{false}
+ ,m_content_size{-1}
+{
+#ifdef PLAYUAVOSD_SMALL
+    // all the buffers there will be, up front
+    m_out.reserve(window_size + block_limit);
+    m_block.reserve(block_limit);
+#endif
+    if (! m_read_frame_header()){
+        throw std::runtime_error("lz4 : empty stream");
+    }
+}
+
+size_t CLz4FrameReader::read(uint8_t * dest, size_t max)
+{
+    while ( (m_out_pos == m_out.size()) && !m_eof){
+        if ( m_in_frame){
+            m_read_block();
+        }else if (! m_read_frame_header()){
+            m_eof = true;
+        }
+    }
+    size_t const count = std::min(max, m_out.size() - m_out_pos);
+    if ( count > 0){
+        memcpy(dest, &m_out[m_out_pos], count);
+        m_out_pos += count;
+    }
+    return count;
+}
+
+// returns false at a clean end of stream
+bool CLz4FrameReader::m_read_frame_header()
+{
+    uint8_t magic[4];
+    m_in.read(reinterpret_cast<char*>(magic),4);
+    if ( m_in.gcount() == 0){
+        return false;
+    }
+    if ( m_in.gcount() != 4){
+        throw std::runtime_error("lz4 : truncated frame header");
+    }
+    uint32_t const id = get_u32(magic);
+    // skippable frames carry user data we dont care about
+    if ( (id & 0xFFFFFFF0) == 0x184D2A50){
+        uint32_t const len = m_read_u32();
+        m_in.ignore(len);
+        if ( static_cast<uint32_t>(m_in.gcount()) != len){
+            throw std::runtime_error("lz4 : truncated skippable frame");
+        }
+        return m_read_frame_header();
+    }
+    if ( id != frame_magic){
+        throw std::runtime_error("lz4 : bad frame magic");
+    }
+
+    uint8_t desc[15];
+    m_read_bytes(desc,2);
+    uint8_t const flg = desc[0];
+    uint8_t const bd = desc[1];
+    if ( (flg >> 6) != 1){
+        throw std::runtime_error("lz4 : unsupported frame version");
+    }
+    if ( flg & 0x01){
+        throw std::runtime_error("lz4 : dictionary frames not supported");
+    }
+    size_t desc_len = 2;
+    if ( flg & 0x08){
+        // content size, informational only
+        // and only kept from the first frame, which is all the lz4 tool writes
+        m_read_bytes(desc + desc_len,8);
+        if ( m_content_size == -1){
+            uint64_t size = 0;
+            for ( int i = 7; i >= 0; --i){
+                size = (size << 8) | desc[desc_len + i];
+            }
+            m_content_size = (size < 0x7FFFFFFF) ? static_cast<int32_t>(size) : -1;
+        }
+        desc_len += 8;
+    }
+    uint8_t hc;
+    m_read_bytes(&hc,1);
+    if ( ((xxh32::hash(desc,desc_len) >> 8) & 0xFF) != hc){
+        throw std::runtime_error("lz4 : frame header checksum failed");
+    }
+
+    switch ( (bd >> 4) & 0x07){
+        case 4: m_block_max = 64 * 1024; break;
+        case 5: m_block_max = 256 * 1024; break;
+        case 6: m_block_max = 1024 * 1024; break;
+        case 7: m_block_max = 4 * 1024 * 1024; break;
+        default:
+            throw std::runtime_error("lz4 : bad block max size");
+    }
+    // the declared size is only a limit, blocks of a small image can still fit
+    m_block_max = std::min(m_block_max, block_limit);
+    m_block_checksum = (flg & 0x10) != 0;
+    m_content_checksum = (flg & 0x04) != 0;
+    m_content_hash = xxh32{};
+    // matches never reach across frames
+    m_out.clear();
+    m_out_pos = 0;
+    m_in_frame = true;
+    return true;
+}
+
+void CLz4FrameReader::m_read_block()
+{
+    // drop output the caller has already taken, keeping the match window
+    if ( m_out_pos > window_size){
+        size_t const drop = m_out_pos - window_size;
+        m_out.erase(m_out.begin(), m_out.begin() + drop);
+        m_out_pos -= drop;
+    }
+
+    uint32_t const word = m_read_u32();
+    if ( word == 0){
+        m_end_of_frame();
+        return;
+    }
+    bool const stored = (word & 0x80000000) != 0;
+    size_t const len = word & 0x7FFFFFFF;
+    if ( len > m_block_max){
+        throw std::runtime_error(block_too_big);
+    }
+    m_block.resize(len);
+    m_read_bytes(m_block.data(),len);
+    if ( m_block_checksum){
+        if ( m_read_u32() != xxh32::hash(m_block.data(),len)){
+            throw std::runtime_error("lz4 : block checksum failed");
+        }
+    }
+    size_t const start = m_out.size();
+    if ( stored){
+        m_out.insert(m_out.end(),m_block.begin(),m_block.end());
+    }else{
+        m_decode_block(m_block.data(),len);
+    }
+    if ( m_content_checksum){
+        m_content_hash.update(m_out.data() + start, m_out.size() - start);
+    }
+}
+
+void CLz4FrameReader::m_decode_block(uint8_t const * src, size_t len)
+{
+    uint8_t const * const end = src + len;
+    size_t const block_start = m_out.size();
+
+    for (;;){
+        if ( src == end){
+            throw std::runtime_error("lz4 : truncated block");
+        }
+        uint8_t const token = *src++;
+
+        size_t lit_len = token >> 4;
+        if ( lit_len == 15){
+            uint8_t b;
+            do {
+                if ( src == end){
+                    throw std::runtime_error("lz4 : truncated literal length");
+                }
+                b = *src++;
+                lit_len += b;
+            } while ( b == 255);
+        }
+        if ( lit_len > static_cast<size_t>(end - src)){
+            throw std::runtime_error("lz4 : literals overrun block");
+        }
+        m_out.insert(m_out.end(), src, src + lit_len);
+        src += lit_len;
+
+        // last sequence has literals only
+        if ( src == end){
+            break;
+        }
+
+        if ( (end - src) < 2){
+            throw std::runtime_error("lz4 : truncated match offset");
+        }
+        size_t const offset = src[0] | (src[1] << 8);
+        src += 2;
+        if ( (offset == 0) || (offset > m_out.size())){
+            throw std::runtime_error("lz4 : bad match offset");
+        }
+
+        size_t match_len = (token & 0x0F) + 4;
+        if ( (token & 0x0F) == 15){
+            uint8_t b;
+            do {
+                if ( src == end){
+                    throw std::runtime_error("lz4 : truncated match length");
+                }
+                b = *src++;
+                match_len += b;
+            } while ( b == 255);
+        }
+        if ( (m_out.size() - block_start + match_len) > m_block_max){
+            throw std::runtime_error("lz4 : block output too big");
+        }
+        // byte at a time, since a match may overlap its own output
+        size_t const from = m_out.size() - offset;
+        for ( size_t i = 0; i < match_len; ++i){
+            uint8_t const b = m_out[from + i];
+            m_out.push_back(b);
+        }
+    }
+    if ( (m_out.size() - block_start) > m_block_max){
+        throw std::runtime_error("lz4 : block output too big");
+    }
+}
+
+void CLz4FrameReader::m_end_of_frame()
+{
+    if ( m_content_checksum){
+        if ( m_read_u32() != m_content_hash.digest()){
+            throw std::runtime_error("lz4 : content checksum failed");
+        }
+    }
+    m_in_frame = false;
+}
+
+uint32_t CLz4FrameReader::m_read_u32()
+{
+    uint8_t arr[4];
+    m_read_bytes(arr,4);
+    return get_u32(arr);
+}
+
+void CLz4FrameReader::m_read_bytes(uint8_t * dest, size_t len)
+{
+    m_in.read(reinterpret_cast<char*>(dest),len);
+    if ( static_cast<size_t>(m_in.gcount()) != len){
+        throw std::runtime_error("lz4 : unexpected end of file");
+    }
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+/*
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+ 
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program. If not, see <http://www.gnu.org/licenses/>
+
+Authors:
+   Andy Little
+   Tom Ren
+  
+*/
+
+#include <cstdint>
+#include <cstddef>
+#include <istream>
+#include <vector>
+
+/*
+  Streaming decoder for the LZ4 frame format ( as written by the lz4 command line tool)
+  self contained so we dont need liblz4 on the flashing station.
+  Decoded data is handed out as it is produced, only the 64k match window
+  plus the current block is held in memory.
+  Header, block and content checksums are checked when present
+*/
+class CLz4FrameReader{
+public:
+    static constexpr uint32_t frame_magic = 0x184D2204;
+
+    explicit CLz4FrameReader(std::istream & in);
+
+    // returns number of bytes put in dest, 0 at end of stream
+    // throws std::runtime_error on a corrupt stream
+    size_t read(uint8_t * dest, size_t max);
+
+    // from the first frame header, -1 if the writer didnt store it
+    int32_t content_size() const { return m_content_size;}
+
+private:
+    // xxHash32, the checksum used by the frame format
+    struct xxh32{
+        xxh32();
+        void update(uint8_t const * data, size_t len);
+        uint32_t digest() const;
+        static uint32_t hash(uint8_t const * data, size_t len);
+    private:
+        uint32_t m_v[4];
+        uint8_t m_mem[16];
+        size_t m_mem_size;
+        uint64_t m_total_len;
+    };
+
+    bool m_read_frame_header();
+    void m_read_block();
+    void m_decode_block(uint8_t const * src, size_t len);
+    void m_end_of_frame();
+    uint32_t m_read_u32();
+    void m_read_bytes(uint8_t * dest, size_t len);
+
+    std::istream & m_in;
+    std::vector<uint8_t> m_out;     // match window + decoded data not yet read
+    std::vector<uint8_t> m_block;   // current compressed block
+    size_t m_out_pos;
+    size_t m_block_max;
+    bool m_block_checksum;
+    bool m_content_checksum;
+    bool m_in_frame;
+    bool m_eof;
+    int32_t m_content_size;
+    xxh32 m_content_hash;
+};
@@ -17,13 +17,18 @@ Authors:
    Tom Ren
 */
 
-#include <quan/serial_port.hpp>
 #include <iostream>
 #include <stdexcept>
 #include <string>
 #include <fstream>
 #include <cstring>
 #include <vector>
+#include <memory>
+#include <csignal>
+#include <atomic>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
 #include <quan/min.hpp>
 #include <quan/utility/timer.hpp>
 #include <quan/conversion/itoa.hpp>
@@ -31,24 +36,113 @@ Authors:
 
 
 #include "osdconn.h"
+#include "metrics.h"
+#include "progress.h"
+#include "fleet.h"
+#include "clone.h"
+#include "watch.h"
+#include "bundle.h"
+#include "trace.h"
+#include "inventory.h"
+#include "snapshot.h"
+#include "station.h"
+#include "timing.h"
+#include "profile.h"
+#include "paramtest.h"
+#include "scaletest.h"
+#include "heapcount.h"
+#include "params.h"
+
+namespace {
+    volatile sig_atomic_t stop_requested = 0;
+    void on_stop_signal(int)
+    {
+        stop_requested = 1;
+    }
+}
 
 void usage(const char* app_name)
 {
     std::cout << "usage :\n";
     std::cout << "1) write firmware to PlayUAV OSD board from <from_filename>\n";
-    std::cout << "      " << app_name << " -fw_w <from_filename>\n\n";
+    std::cout << "      " << app_name << " -fw_w <from_filename>\n";
+    std::cout << "      ( <from_filename> may be a raw .bin or lz4 compressed )\n\n";
     std::cout << "2) set parameters to PlayUAV OSD board from <from_filename>\n";
     std::cout << "      " << app_name << " -pm_w <from_filename>\n\n";
     std::cout << "3) set default parameters to PlayUAV OSD board\n";
     std::cout << "      " << app_name << " -pm_w\n\n";
     std::cout << "4) get parameters from PlayUAV OSD board and save to <to_filename>\n";
     std::cout << "      " << app_name << " -pm_r <to_filename>\n\n";
+    std::cout << "5) set parameters from <from_filename>, or defaults, on every attached PlayUAV OSD board at once\n";
+    std::cout << "      " << app_name << " -pm_w_all [<from_filename>]\n\n";
+    std::cout << "6) copy the firmware on the board at <source_port> to the boards at <target_port>s,\n";
+    std::cout << "   or to every other attached board\n";
+    std::cout << "      " << app_name << " -fw_clone <source_port> [<target_port> ...]\n\n";
+    std::cout << "7) write firmware from <from_filename> to every attached PlayUAV OSD board\n";
+    std::cout << "      " << app_name << " -fw_w_all <from_filename>\n\n";
+    std::cout << "8) keep <from_filename> on the PlayUAV OSD board while editing it, pushing each saved change\n";
+    std::cout << "      " << app_name << " -pm_watch <from_filename>\n\n";
+    std::cout << "9) write a release bundle ( firmware and parameters) to PlayUAV OSD board\n";
+    std::cout << "      " << app_name << " -bundle_w <bundle_filename>\n\n";
+    std::cout << "10) make a release bundle for boards with <board_id> and <flash_size> bytes of flash,\n";
+    std::cout << "    of firmware that reports <firmware_version>\n";
+    std::cout << "      " << app_name << " -bundle_create <bundle_filename> <board_id> <flash_size> <firmware_version> <firmware_filename> [<params_filename>]\n\n";
+    std::cout << "11) list every attached PlayUAV OSD board ( serial, chip, board, bootloader, flash crc),\n";
+    std::cout << "   probing only boards not already in the inventory, or all of them with -inventory_refresh\n";
+    std::cout << "      " << app_name << " -inventory\n";
+    std::cout << "      " << app_name << " -inventory_refresh\n\n";
+    std::cout << "12) read the parameters of every attached PlayUAV OSD board into a snapshot\n";
+    std::cout << "      " << app_name << " -pm_snapshot <snapshot_filename>\n";
+    std::cout << "   list the boards in a snapshot whose parameter compares ( =, !=, <, >) with <value>\n";
+    std::cout << "   or the parameter default, or every board's value\n";
+    std::cout << "      " << app_name << " -pm_query <snapshot_filename> <param_name> [<op> <value>|default]\n";
+    std::cout << "   list the differences between two snapshots\n";
+    std::cout << "      " << app_name << " -pm_diff <old_snapshot_filename> <new_snapshot_filename>\n\n";
+    std::cout << "13) set parameters from <from_filename>, or defaults, only where the board differs,\n";
+    std::cout << "   on the PlayUAV OSD board or on every attached board\n";
+    std::cout << "      " << app_name << " -pm_sync [<from_filename>]\n";
+    std::cout << "      " << app_name << " -pm_sync_all [<from_filename>]\n\n";
+    std::cout << "14) station : write firmware from <firmware_filename> and parameters from <params_filename>,\n";
+    std::cout << "   or defaults, to each PlayUAV OSD board as it is plugged in, until ctrl-C\n";
+    std::cout << "      " << app_name << " -station <firmware_filename> [<params_filename>]\n\n";
+    std::cout << "15) read the firmware back from PlayUAV OSD board and compare it with <from_filename>,\n";
+    std::cout << "   listing the address ranges that differ. Needs a rev2 bootloader\n";
+    std::cout << "      " << app_name << " -fw_verify <from_filename>\n\n";
+    std::cout << "16) make a parameter image in <to_dirname> for every combination of the overrides in\n";
+    std::cout << "   <matrix_filename>, on top of <base_filename> or the defaults. Each line of the matrix is\n";
+    std::cout << "   name=value|value|... e.g Misc_Video_Mode=0|1\n";
+    std::cout << "      " << app_name << " -pm_profiles <base_filename>|default <matrix_filename> <to_dirname>\n\n";
+    std::cout << "17) check that <count> ( default 1000000) random parameter images come back the same\n";
+    std::cout << "   from the .posd text, using every core. <seed> repeats an earlier run\n";
+    std::cout << "      " << app_name << " -pm_selftest [<count> [<seed>]]\n\n";
+    std::cout << "18) measure the host cpu, memory, descriptors, threads and read and write calls per board for a firmware\n";
+    std::cout << "   and parameter write, on 1, 2, 4 ... up to <max_boards> simulated boards at once\n";
+    std::cout << "      " << app_name << " -scale_test <max_boards>\n\n";
+    std::cout << "19) check the most heap used loading <params_filename>, or defaults, and streaming the firmware\n";
+    std::cout << "   in <firmware_filename> is within the budget for the build ( smaller with make PROFILE=small)\n";
+    std::cout << "      " << app_name << " -heap_check <firmware_filename> [<params_filename>]\n\n";
+    std::cout << "options :\n";
+    std::cout << "   -metrics <filename>  write job metrics in prometheus text format to <filename>\n";
+    std::cout << "   -json                report status and progress as json lines\n";
+    std::cout << "   -port <port>         use this board port rather than searching /dev/ttyACM0..4\n";
+    std::cout << "                        e.g -port /dev/ttyACM2 or -port tcp:<host>:<tcp_port> for a serial bridge\n";
+    std::cout << "   -window <n>          requests to send ahead before waiting for replies\n";
+    std::cout << "                        ( default 1 for serial ports, 8 for tcp)\n";
+    std::cout << "   -hub_limit <n>       with many boards, how many on one usb hub transfer firmware at once\n";
+    std::cout << "                        ( default 2, 0 for no limit)\n";
+    std::cout << "   -record <filename>   record all traffic with the boards, with timings, to <filename>\n";
+    std::cout << "   -replay <filename>   run against a recording rather than boards\n";
+    std::cout << "   -replay_speed <x>    replay <x> times faster than recorded ( default 1)\n";
+    std::cout << "   -inventory_file <filename>  board inventory ( default ~/.playuavosd_inventory)\n";
+    std::cout << "   -serial <serial>     use the board with <serial> in the inventory rather than searching\n";
+    std::cout << "   -verify              after writing firmware or parameters, read them back and compare them\n";
+    std::cout << "                        ( firmware on rev3+ bootloaders is checked by the board crc)\n";
+    std::cout << "   -timing_file <filename>  timings learned per transport and board model, for timeouts\n";
+    std::cout << "                        ( default ~/.playuavosd_timing)\n\n";
 
 }
 
-COSDConn osdconn;
-
-int main(int argc, const char* argv[])
+void banner()
 {
     std::cout << "\n\n";
     std::cout << "   ***************************************\n";
@@ -61,15 +155,373 @@ int main(int argc, const char* argv[])
     std::cout << "   *     Andy Little, Tom Ren            *\n";
     std::cout << "   *                                     *\n";
     std::cout << "   ***************************************\n\n";
+}
+
+int main(int argc, const char* argv[])
+{
+    // global options, these can go anywhere on the command line
+    std::string metrics_file;
+    std::string port_name;
+    int window = 0;
+    int hub_limit = -1;
+    std::string record_file;
+    std::string replay_file;
+    double replay_speed = 1.0;
+    std::string inventory_file = CInventory::default_filename();
+    std::string serial;
+    std::string timing_file = CTimingModel::default_filename();
+    bool verify = false;
+    CProgressRenderer::format progress_format = CProgressRenderer::format::terminal;
+    std::vector<const char*> args;
+    for ( int i = 0; i < argc; ++i){
+        if ( !strcmp(argv[i], "-metrics") && ( (i + 1) < argc)){
+            metrics_file = argv[++i];
+        }else if ( !strcmp(argv[i], "-port") && ( (i + 1) < argc)){
+            port_name = argv[++i];
+        }else if ( !strcmp(argv[i], "-window") && ( (i + 1) < argc)){
+            window = atoi(argv[++i]);
+        }else if ( !strcmp(argv[i], "-hub_limit") && ( (i + 1) < argc)){
+            hub_limit = atoi(argv[++i]);
+        }else if ( !strcmp(argv[i], "-record") && ( (i + 1) < argc)){
+            record_file = argv[++i];
+        }else if ( !strcmp(argv[i], "-replay") && ( (i + 1) < argc)){
+            replay_file = argv[++i];
+        }else if ( !strcmp(argv[i], "-replay_speed") && ( (i + 1) < argc)){
+            replay_speed = atof(argv[++i]);
+        }else if ( !strcmp(argv[i], "-inventory_file") && ( (i + 1) < argc)){
+            inventory_file = argv[++i];
+        }else if ( !strcmp(argv[i], "-serial") && ( (i + 1) < argc)){
+            serial = argv[++i];
+        }else if ( !strcmp(argv[i], "-timing_file") && ( (i + 1) < argc)){
+            timing_file = argv[++i];
+        }else if ( !strcmp(argv[i], "-verify")){
+            verify = true;
+        }else if ( !strcmp(argv[i], "-json")){
+            progress_format = CProgressRenderer::format::json;
+        }else{
+            args.push_back(argv[i]);
+        }
+    }
+    argc = args.size();
+    argv = args.data();
+
+    // with -json stdout is only json lines
+    if ( progress_format != CProgressRenderer::format::json){
+        banner();
+    }
 
     if ( ( argc < 2) ) {
         usage(argv[0]);
         return EXIT_SUCCESS;
     }
 
+    CMetrics metrics;
+    CMetrics * const job_metrics = metrics_file.empty() ? nullptr : &metrics;
+
+    // record the traffic with the boards, or replay it instead of using boards
+    std::unique_ptr<CTraceRecorder> recorder;
+    std::unique_ptr<CTraceReplay> replay;
+    transport_factory connections;
     try{
-        if(( argc == 3) && (!strncmp(argv[1], "-fw_w", 5)) ){
+        if ( !record_file.empty()){
+            recorder.reset(new CTraceRecorder{record_file});
+            connections = [&recorder](std::string const & name){ return recorder->wrap(CTransport::open(name));};
+        }else if ( !replay_file.empty()){
+            replay.reset(new CTraceReplay{replay_file,replay_speed});
+            connections = [&replay](std::string const & name){ return replay->open(name);};
+        }
+    }catch(std::exception & e){
+        std::cout << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    // a board picked by serial is found from its usb serial number
+    if ( !serial.empty()){
+        try{
+            port_name = CInventory{inventory_file}.port_of(serial);
+        }catch(std::exception & e){
+            std::cout << e.what() << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+
+    // a replay keeps the timeouts it was recorded with
+    CTimingModel timing{timing_file};
+    CTimingModel * const board_timing = replay ? nullptr : &timing;
+
+    COSDConn osdconn{port_name};
+    osdconn.set_metrics(job_metrics);
+    osdconn.set_window(window > 0 ? window : 0);
+    osdconn.set_transport_factory(connections);
+    osdconn.set_timing(board_timing);
+    osdconn.set_verify(verify);
+
+    CProgressRenderer progress{progress_format};
+    CProgressChannel * const osd_channel = progress.add_channel("osd");
+    osdconn.set_progress(osd_channel);
+    progress.start();
+
+    // the boards for the multi board modes, -port picks one
+    auto const make_fleet = [&](std::vector<std::string> const & ports){
+        CFleet fleet{ports,progress,job_metrics};
+        if ( fleet.ports().empty()){
+            throw std::runtime_error("no boards found");
+        }
+        if ( hub_limit >= 0){
+            fleet.set_hub_limit(hub_limit);
+        }
+        fleet.set_transport_factory(connections);
+        fleet.set_timing(board_timing);
+        return fleet;
+    };
+    auto const attached_ports = [&port_name]{
+        return port_name.empty() ? CFleet::find_ports() : std::vector<std::string>{port_name};
+    };
+    // the inventory no longer knows the flash crc of boards about to be flashed
+    auto const reflashing = [&inventory_file,&replay](std::vector<std::string> const & ports){
+        if ( replay){
+            return;
+        }
+        CInventory inventory{inventory_file};
+        if ( inventory.reflashing(ports) > 0){
+            inventory.save();
+        }
+    };
+
+    int result = EXIT_SUCCESS;
+    try{
+        if(( argc == 3) && (!strcmp(argv[1], "-fw_w_all"))){
+            std::string const filename = argv[2];
+            auto const ports = attached_ports();
+            reflashing(ports);
+            auto const results = make_fleet(ports).run(
+                [&filename,verify](COSDConn & conn){
+                    conn.set_verify(verify);
+                    conn.upload_firmware(filename);
+                });
+            progress.stop();
+            if ( CFleet::report(results) > 0){
+                result = EXIT_FAILURE;
+            }
+        }else if(( argc == 2) && (!strcmp(argv[1], "-inventory") || !strcmp(argv[1], "-inventory_refresh"))){
+            CInventory inventory{inventory_file};
+            auto const ports = attached_ports();
+            if ( ports.empty()){
+                throw std::runtime_error("no boards found");
+            }
+            auto const to_probe = inventory.unknown_ports(ports,!strcmp(argv[1], "-inventory_refresh"));
+            std::vector<fleet_result> results;
+            if ( !to_probe.empty()){
+                CFleet boards = make_fleet(to_probe);
+                results = inventory.probe(boards);
+                inventory.save();
+            }
+            progress.stop();
+            inventory.report(ports);
+            std::cout << to_probe.size() << " of " << ports.size() << " boards probed\n";
+            if ( !results.empty() && (CFleet::report(results) > 0)){
+                result = EXIT_FAILURE;
+            }
+        }else if(( argc == 3) && (!strcmp(argv[1], "-pm_snapshot"))){
+            CInventory const inventory{inventory_file};
+            CFleet boards = make_fleet(attached_ports());
+            CParamSnapshot snapshot;
+            auto const results = snapshot.read(boards,inventory);
+            snapshot.save(argv[2]);
+            progress.stop();
+            std::cout << snapshot.num_boards() << " boards in snapshot " << argv[2] << '\n';
+            if ( CFleet::report(results) > 0){
+                result = EXIT_FAILURE;
+            }
+        }else if(( (argc == 4) || (argc == 6)) && (!strcmp(argv[1], "-pm_query"))){
+            CParamSnapshot const snapshot{argv[2]};
+            size_t const col = snapshot.column(argv[3]);
+            std::vector<size_t> rows;
+            if ( argc == 6){
+                std::string const op = argv[4];
+                CParamSnapshot::compare compare;
+                if ( op == "="){
+                    compare = CParamSnapshot::compare::eq;
+                }else if ( op == "!="){
+                    compare = CParamSnapshot::compare::ne;
+                }else if ( op == "<"){
+                    compare = CParamSnapshot::compare::lt;
+                }else if ( op == ">"){
+                    compare = CParamSnapshot::compare::gt;
+                }else{
+                    throw std::runtime_error("unknown comparison " + op);
+                }
+                uint16_t const value = strcmp(argv[5], "default")
+                    ? static_cast<uint16_t>(atoi(argv[5])) : snapshot.default_value(col);
+                rows = snapshot.select(col,compare,value);
+            }else{
+                for ( size_t row = 0; row < snapshot.num_boards(); ++row){
+                    rows.push_back(row);
+                }
+            }
+            progress.stop();
+            for ( size_t row : rows){
+                std::cout << snapshot.board(row) << " : " << argv[3] << "=" << snapshot.value(row,col) << '\n';
+            }
+            std::cout << rows.size() << " of " << snapshot.num_boards() << " boards\n";
+        }else if(( argc == 4) && (!strcmp(argv[1], "-pm_diff"))){
+            CParamSnapshot const old_snapshot{argv[2]};
+            CParamSnapshot const new_snapshot{argv[3]};
+            progress.stop();
+            std::cout << CParamSnapshot::diff(old_snapshot,new_snapshot) << " differences\n";
+        }else if(( argc == 3) && (!strcmp(argv[1], "-bundle_w"))){
+            // the whole bundle, with the firmware crc, is checked before connecting
+            CBundle bundle{argv[2]};
+            reflashing(attached_ports());
+            osdconn.apply_bundle(bundle);
+        }else if(( (argc == 7) || (argc == 8)) && (!strcmp(argv[1], "-bundle_create"))){
+            unsigned long const firmware_version = strtoul(argv[5],nullptr,0);
+            if ( firmware_version > UINT16_MAX){
+                throw std::runtime_error("firmware version must be 0 to 65535");
+            }
+            CBundle::create(argv[2],strtoul(argv[3],nullptr,0),strtoul(argv[4],nullptr,0),
+                static_cast<uint16_t>(firmware_version),argv[6],(argc == 8) ? argv[7] : "");
+            std::cout << "OK! ... bundle written to " << argv[2] << std::endl;
+        }else if(( argc == 5) && (!strcmp(argv[1], "-pm_profiles"))){
+            CProfileGenerator profiles{strcmp(argv[2],"default") ? argv[2] : "",argv[3]};
+            auto const build_start = std::chrono::steady_clock::now();
+            profiles.build();
+            double const build_ms = std::chrono::duration<double,std::milli>(
+                std::chrono::steady_clock::now() - build_start).count();
+            profiles.save(argv[4]);
+            progress.stop();
+            std::cout << profiles.num_profiles() << " profiles built in " << build_ms << " ms, saved to " << argv[4] << '\n';
+        }else if(( argc <= 4) && (!strcmp(argv[1], "-pm_selftest"))){
+            uint64_t const count = (argc >= 3) ? strtoull(argv[2],nullptr,0) : 1000000;
+            uint64_t const seed = (argc == 4) ? strtoull(argv[3],nullptr,0)
+                : static_cast<uint64_t>(std::chrono::system_clock::now().time_since_epoch().count());
+            CParamSelfTest test{seed};
+            bool const passed = test.run(count);
+            progress.stop();
+            for ( auto const & f : test.failures()){
+                std::cout << "image " << f.image << " : " << f.param << " sent " << f.sent << " got " << f.got << '\n';
+            }
+            std::cout << test.images() << " images, " << test.params_checked() << " parameters checked in "
+                << test.seconds() << " s on " << test.threads() << " threads, "
+                << static_cast<uint64_t>(test.images() / std::max(test.seconds(),1e-9)) << " images/s\n";
+            std::cout << "seed " << test.seed() << " : " << test.num_failures() << " failures, "
+                << test.known_exceptions() << " known exceptions ( Misc_Start_Col_Sign other than 0 or 1 comes back as 1)\n";
+            if ( !passed){
+                result = EXIT_FAILURE;
+            }
+        }else if(( argc == 3) && (!strcmp(argv[1], "-scale_test"))){
+            size_t const max_boards = strtoul(argv[2],nullptr,0);
+            if ( max_boards == 0){
+                throw std::runtime_error("scale test needs at least one board");
+            }
+            progress.stop();
+            auto const steps = CScaleTest{}.run(max_boards);
+            if ( steps.back().failed > 0){
+                result = EXIT_FAILURE;
+            }
+        }else if(( (argc == 3) || (argc == 4)) && (!strcmp(argv[1], "-heap_check"))){
+            progress.stop();
+            if ( !CHeapCount::check(argv[2],(argc == 4) ? argv[3] : "")){
+                result = EXIT_FAILURE;
+            }
+        }else if(( argc == 3) && (!strcmp(argv[1], "-fw_verify"))){
+            osdconn.verify_firmware(argv[2]);
+        }else if(( argc == 3) && (!strncmp(argv[1], "-fw_w", 5)) ){
+            reflashing(attached_ports());
             osdconn.upload_firmware(argv[2]);
+        }else if(( argc >= 3) && (!strcmp(argv[1], "-fw_clone"))){
+            std::string const source_port = argv[2];
+            std::vector<std::string> target_ports;
+            if ( argc > 3){
+                target_ports.assign(argv + 3, argv + argc);
+            }else{
+                for ( auto const & port : CFleet::find_ports()){
+                    if ( port != source_port){
+                        target_ports.push_back(port);
+                    }
+                }
+            }
+            CFleet targets = make_fleet(target_ports);
+            reflashing(targets.ports());
+            auto const results = clone_firmware(source_port,targets,progress,job_metrics);
+            progress.stop();
+            if ( CFleet::report(results) > 0){
+                result = EXIT_FAILURE;
+            }
+        }else if(( (argc == 3) || (argc == 4)) && (!strcmp(argv[1], "-station"))){
+            std::string const firmware_file = argv[2];
+            COSDParam osdparams;
+            uint8_t paramsbuf[PARAMS_BUF_SIZE];
+            osdparams.get_default_params(paramsbuf);
+            if ( (argc == 4) && !osdparams.load_params_from_file(argv[3], paramsbuf)){
+                throw std::runtime_error("failed to load parameters");
+            }
+            CInventory inventory{inventory_file};
+            CStation station{[&firmware_file,&paramsbuf,verify](COSDConn & conn){
+                    conn.set_verify(verify);
+                    conn.upload_firmware(firmware_file);
+                    conn.wait_for_app();
+                    // the firmware crc was checked by the upload. The parameters, if any were
+                    // written, are read back once by the sync
+                    conn.set_verify(true);
+                    conn.sync_params(paramsbuf);
+                },progress,job_metrics};
+            if ( hub_limit >= 0){
+                station.set_hub_limit(hub_limit);
+            }
+            station.set_transport_factory(connections);
+            station.set_timing(board_timing);
+            station.set_inventory(&inventory);
+            signal(SIGINT,on_stop_signal);
+            signal(SIGTERM,on_stop_signal);
+            auto const results = station.run(stop_requested);
+            progress.stop();
+            if ( CFleet::report(results) > 0){
+                result = EXIT_FAILURE;
+            }
+        }else if(( argc == 3) && (!strcmp(argv[1], "-pm_watch"))){
+            CParamWatcher watcher{osdconn,argv[2],osd_channel};
+            signal(SIGINT,on_stop_signal);
+            signal(SIGTERM,on_stop_signal);
+            watcher.run(stop_requested);
+        }else if(( argc <= 3) && (!strcmp(argv[1], "-pm_w_all"))){
+            // encode once, then send the same image to every board
+            COSDParam osdparams;
+            uint8_t paramsbuf[PARAMS_BUF_SIZE];
+            osdparams.get_default_params(paramsbuf);
+            if ( (argc == 3) && !osdparams.load_params_from_file(argv[2], paramsbuf)){
+                throw std::runtime_error("failed to load parameters");
+            }
+            auto const results = make_fleet(attached_ports()).run(
+                [&paramsbuf](COSDConn & conn){ conn.upload_params_buffer(paramsbuf);});
+            progress.stop();
+            if ( CFleet::report(results) > 0){
+                result = EXIT_FAILURE;
+            }
+        }else if(( argc <= 3) && (!strcmp(argv[1], "-pm_sync") || !strcmp(argv[1], "-pm_sync_all"))){
+            COSDParam osdparams;
+            uint8_t paramsbuf[PARAMS_BUF_SIZE];
+            osdparams.get_default_params(paramsbuf);
+            if ( (argc == 3) && !osdparams.load_params_from_file(argv[2], paramsbuf)){
+                throw std::runtime_error("failed to load parameters");
+            }
+            if ( !strcmp(argv[1], "-pm_sync")){
+                osdconn.sync_params(paramsbuf);
+            }else{
+                std::atomic<size_t> unchanged{0};
+                auto const results = make_fleet(attached_ports()).run(
+                    [&paramsbuf,&unchanged](COSDConn & conn){
+                        if ( conn.sync_params(paramsbuf).empty()){
+                            ++unchanged;
+                        }
+                    });
+                progress.stop();
+                size_t const failed = CFleet::report(results);
+                std::cout << unchanged << " boards already had the parameters\n";
+                if ( failed > 0){
+                    result = EXIT_FAILURE;
+                }
+            }
         }else if(!strncmp(argv[1], "-pm_w", 5)){
             if(argc == 3){
                 osdconn.upload_params(argv[2]);
@@ -77,18 +529,30 @@ int main(int argc, const char* argv[])
                 osdconn.upload_params("");
             }else{
                 usage(argv[0]);
-                return EXIT_FAILURE;
+                result = EXIT_FAILURE;
             }
         }else if(( argc == 3) && (!strncmp(argv[1], "-pm_r", 5))){
             osdconn.get_params(argv[2]);
         }else{
             usage(argv[0]);
-            return EXIT_FAILURE;
+            result = EXIT_FAILURE;
         }
     }catch(std::exception & e){
+        progress.stop();
         std::cout << e.what() << std::endl;
-        return EXIT_FAILURE;
+        result = EXIT_FAILURE;
+    }
+    progress.stop();
+
+    if ( replay){
+        replay->report(std::cout);
+    }else if ( timing.changed() && !timing.save()){
+        std::cout << "Failed to write timing file:" << timing_file << std::endl;
+    }
+
+    if ( !metrics_file.empty() && !metrics.write_textfile(metrics_file)){
+        std::cout << "Failed to write metrics file:" << metrics_file << std::endl;
     }
 
-    return EXIT_SUCCESS;
+    return result;
 }
@@ -0,0 +1,188 @@
+/*
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+ 
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program. If not, see <http://www.gnu.org/licenses/>
+
+Authors:
+   Andy Little
+   Tom Ren
+*/
+
+#include "metrics.h"
+
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <cstdio>
+
+CMetrics::CMetrics()
+{
+    std::vector<double> const seconds = {0.01, 0.05, 0.1, 0.25, 0.5, 1, 2.5, 5, 10, 20, 30, 60, 120};
+    std::vector<double> const rate = {1e3, 2e3, 5e3, 1e4, 2e4, 5e4, 1e5, 2e5, 5e5};
+
+    m_defs["playuavosd_phase_duration_seconds"] =
+        {"Time spent in each phase of a job, per board",metric_type::histogram,seconds};
+    m_defs["playuavosd_upload_throughput_bytes_per_second"] =
+        {"Firmware programming rate per upload",metric_type::histogram,rate};
+    m_defs["playuavosd_programmed_bytes_total"] =
+        {"Firmware bytes acknowledged by the board",metric_type::counter,{}};
+    m_defs["playuavosd_param_bytes_total"] =
+        {"Parameter bytes transferred",metric_type::counter,{}};
+    m_defs["playuavosd_sync_timeouts_total"] =
+        {"Times the board did not answer GET_SYNC in time",metric_type::counter,{}};
+    m_defs["playuavosd_crc_mismatches_total"] =
+        {"Firmware uploads whose board crc did not match the image",metric_type::counter,{}};
+    m_defs["playuavosd_upload_retries_total"] =
+        {"Reconnect and resume attempts during firmware upload",metric_type::counter,{}};
+    m_defs["playuavosd_jobs_total"] =
+        {"Jobs run, by job and result",metric_type::counter,{}};
+    m_defs["playuavosd_param_verify_failures_total"] =
+        {"Parameter writes whose read back did not match",metric_type::counter,{}};
+    m_defs["playuavosd_verify_mismatched_bytes_total"] =
+        {"Flash bytes that differed from the image in a verify",metric_type::counter,{}};
+    m_defs["playuavosd_unsupported_bootloader_total"] =
+        {"Boards refused for a bootloader revision this tool does not support",metric_type::counter,{}};
+    m_defs["playuavosd_sync_retries_total"] =
+        {"GET_SYNC attempts that succeeded after a timeout",metric_type::counter,{}};
+    m_defs["playuavosd_param_syncs_skipped_total"] =
+        {"Parameter syncs skipped as the board already matched",metric_type::counter,{}};
+}
+
+CMetrics::metric_def const & CMetrics::m_def(std::string const & name) const
+{
+    auto const iter = m_defs.find(name);
+    if ( iter == m_defs.end()){
+        throw std::logic_error("unknown metric " + name);
+    }
+    return iter->second;
+}
+
+void CMetrics::count(std::string const & name, std::string const & labels, double inc)
+{
+    metric_def const & def = m_def(name);
+    if ( def.type != metric_type::counter){
+        throw std::logic_error(name + " is not a counter");
+    }
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_series[name][labels].value += inc;
+}
+
+void CMetrics::observe(std::string const & name, std::string const & labels, double value)
+{
+    metric_def const & def = m_def(name);
+    if ( def.type != metric_type::histogram){
+        throw std::logic_error(name + " is not a histogram");
+    }
+    std::lock_guard<std::mutex> lock(m_mutex);
+    series & s = m_series[name][labels];
+    if ( s.bucket_counts.empty()){
+        s.bucket_counts.resize(def.buckets.size(),0);
+    }
+    for ( size_t i = 0; i < def.buckets.size(); ++i){
+        if ( value <= def.buckets[i]){
+            ++s.bucket_counts[i];
+            break;
+        }
+    }
+    s.value += value;
+    ++s.count;
+}
+
+std::string CMetrics::labels(std::vector<std::pair<std::string,std::string> > const & kv)
+{
+    std::string result;
+    for ( auto const & p : kv){
+        if ( !result.empty()){
+            result += ',';
+        }
+        result += p.first + "=\"";
+        for ( char c : p.second){
+            switch (c){
+                case '\\': result += "\\\\"; break;
+                case '"':  result += "\\\""; break;
+                case '\n': result += "\\n"; break;
+                default:   result += c; break;
+            }
+        }
+        result += '"';
+    }
+    return result;
+}
+
+namespace {
+
+    std::string number(double v)
+    {
+        char buf[32];
+        snprintf(buf, sizeof(buf), "%.17g", v);
+        return buf;
+    }
+
+    std::string with_label(std::string const & labels, std::string const & extra)
+    {
+        if ( labels.empty()){
+            return "{" + extra + "}";
+        }
+        return "{" + labels + "," + extra + "}";
+    }
+
+    std::string braces(std::string const & labels)
+    {
+        return labels.empty() ? std::string{} : "{" + labels + "}";
+    }
+
+} // namespace
+
+std::string CMetrics::to_text() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::ostringstream out;
+    for ( auto const & m : m_series){
+        metric_def const & def = m_def(m.first);
+        out << "# HELP " << m.first << ' ' << def.help << '\n';
+        out << "# TYPE " << m.first << ' '
+            << ((def.type == metric_type::counter) ? "counter" : "histogram") << '\n';
+        for ( auto const & s : m.second){
+            if ( def.type == metric_type::counter){
+                out << m.first << braces(s.first) << ' ' << number(s.second.value) << '\n';
+                continue;
+            }
+            uint64_t cumulative = 0;
+            for ( size_t i = 0; i < def.buckets.size(); ++i){
+                cumulative += s.second.bucket_counts[i];
+                out << m.first << "_bucket"
+                    << with_label(s.first,"le=\"" + number(def.buckets[i]) + "\"") << ' ' << cumulative << '\n';
+            }
+            out << m.first << "_bucket" << with_label(s.first,"le=\"+Inf\"") << ' ' << s.second.count << '\n';
+            out << m.first << "_sum" << braces(s.first) << ' ' << number(s.second.value) << '\n';
+            out << m.first << "_count" << braces(s.first) << ' ' << s.second.count << '\n';
+        }
+    }
+    return out.str();
+}
+
+bool CMetrics::write_textfile(std::string const & filename) const
+{
+    std::string const tmpname = filename + ".tmp";
+    {
+        std::ofstream fo(tmpname);
+        if ( !fo.is_open()){
+            return false;
+        }
+        fo << to_text();
+        fo.flush();
+        if ( !fo.good()){
+            return false;
+        }
+    }
+    return std::rename(tmpname.c_str(),filename.c_str()) == 0;
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+/*
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+ 
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program. If not, see <http://www.gnu.org/licenses/>
+
+Authors:
+   Andy Little
+   Tom Ren
+  
+*/
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+
+/*
+  counters and histograms for a flashing station, written out in the
+  prometheus text format for the node exporter textfile collector.
+  Safe to update from several connection threads at once.
+  Series are identified by metric name and a label string
+  e.g  port="/dev/ttyACM0",phase="erase"
+*/
+class CMetrics{
+public:
+    CMetrics();
+
+    void count(std::string const & name, std::string const & labels, double inc = 1.0);
+    void observe(std::string const & name, std::string const & labels, double value);
+
+    // write to filename.tmp then rename, so the collector never sees a partial file
+    bool write_textfile(std::string const & filename) const;
+    std::string to_text() const;
+
+    // builds a label string, quoting and escaping the values
+    static std::string labels(std::vector<std::pair<std::string,std::string> > const & kv);
+
+private:
+    enum class metric_type { counter, histogram};
+    struct metric_def{
+        char const * help;
+        metric_type type;
+        std::vector<double> buckets;
+    };
+    struct series{
+        double value;           // counter value, or histogram sum
+        uint64_t count;         // histogram observations
+        std::vector<uint64_t> bucket_counts;
+        series():value{0},count{0}{}
+    };
+
+    metric_def const & m_def(std::string const & name) const;
+
+    std::map<std::string,metric_def> m_defs;
+    std::map<std::string,std::map<std::string,series> > m_series;
+    mutable std::mutex m_mutex;
+};
@@ -24,285 +24,1119 @@ Authors:
 #include <string>
 #include <fstream>
 #include <cstring>
+#include <cstdio>
 #include <vector>
+#include <thread>
+#include <chrono>
+#include <deque>
+#include <algorithm>
 #include <quan/min.hpp>
-#include <quan/utility/timer.hpp>
 #include <quan/conversion/itoa.hpp>
 #include <cassert>
 
 #include "osdconn.h"
 #include "params.h"
+#include "crc.h"
+#include "firmware.h"
+#include "metrics.h"
+#include "progress.h"
+#include "transport.h"
+#include "hub.h"
+#include "bundle.h"
+#include "inventory.h"
 
-namespace px4Uploader{
-
-int32_t crc(std::vector<uint8_t> const & bytes,int32_t padlen);
-}
-struct Firmware{
-    std::vector<uint8_t> imagebyte;
-    int32_t image_size;
-    uint32_t expected_crc;
-    int32_t board_flash_size;
-    Firmware():image_size{0}, expected_crc{0}, board_flash_size{0}{}
-};
 // code for the app to request a reboot to bootlaoder
 // also works in PlayUAV version of the  bootloader itself as a nop
 static constexpr uint8_t PROTO_BL_UPLOAD = 0x55;
 
+// how many times a firmware upload will reconnect and resume before giving up
+static constexpr int32_t max_resume_attempts = 3;
+
+static constexpr std::chrono::milliseconds sync_timeout{7000};
+static constexpr std::chrono::milliseconds recv_timeout{7000};
+// per MB of flash
+static constexpr std::chrono::milliseconds erase_timeout{20000};
+// for the app to go down after the reboot to bootloader command
+static constexpr std::chrono::milliseconds reset_timeout{1000};
+// for the bootloader to answer after the reboot to bootloader command
+static constexpr std::chrono::milliseconds reboot_timeout{10000};
+static constexpr std::chrono::milliseconds reconnect_period{200};
+// for the sync after the GET_PARAMS data, which older firmware doesnt send
+static constexpr std::chrono::milliseconds params_sync_timeout{250};
+// GET_SYNCs sent before giving up, once the timeout has been learned
+static constexpr int32_t sync_attempts = 3;
+// on top of the learned GET_SYNC round trip, for the board to carry out a command
+// such as programming a chunk, before its reply is given up on
+static constexpr std::chrono::milliseconds command_time{250};
+
+// minimum READ_MULTIs in flight when reading back flash
+static constexpr size_t readback_window = 16;
+// differing ranges listed by a verify, the rest are counted
+static constexpr size_t verify_ranges_shown = 16;
+
+// words of the chip unique id, and bytes of otp read for an identity
+static constexpr uint32_t serial_words = 3;
+static constexpr uint32_t identity_otp_bytes = 32;
+
+namespace {
+
+    // how often a connection posts upload progress
+    constexpr std::chrono::milliseconds progress_period{100};
+
+    typedef std::chrono::steady_clock clock_type;
+
+    // the used part of a parameter image, from the parameter layout
+    int32_t params_extent()
+    {
+        static COSDParam const layout;
+        return layout.layout_size();
+    }
+
+    double seconds_since(clock_type::time_point const & start)
+    {
+        return std::chrono::duration<double>(clock_type::now() - start).count();
+    }
+
+    // READ_MULTI reads whole words, so an image is read back to the next word,
+    // which is erased flash past its end
+    int32_t read_back_len(int32_t image_size)
+    {
+        return (image_size + 3) & ~3;
+    }
+
+    std::string hex_address(int32_t address)
+    {
+        char hex[11];
+        snprintf(hex,sizeof hex,"0x%08x",static_cast<unsigned>(address));
+        return hex;
+    }
+
+    /*
+      counts the job in metrics as ok or failed, depending how the scope was left.
+      Jobs run as part of another, e.g the parameter push in a sync, arent counted
+      on their own. depth is the connection's count of jobs running
+    */
+    struct job_result{
+        job_result(CMetrics * metrics, std::string const & port_name, char const * job, int32_t & depth)
+        :m_metrics{metrics},m_port_name(port_name),m_job{job},m_depth(depth),m_outer{depth == 0}
+        {
+            ++m_depth;
+        }
+        ~job_result()
+        {
+            --m_depth;
+            if ( m_outer && (m_metrics != nullptr)){
+                char const * result = std::uncaught_exception() ? "failed" : "ok";
+                // throwing here would be std::terminate
+                try{
+                    m_metrics->count("playuavosd_jobs_total",
+                        CMetrics::labels({{"port",m_port_name},{"job",m_job},{"result",result}}));
+                }catch (std::exception &){
+                }
+            }
+        }
+        CMetrics * m_metrics;
+        std::string const & m_port_name;
+        char const * m_job;
+        int32_t & m_depth;
+        bool const m_outer;
+    };
+}
+
 COSDConn::COSDConn()
-    :m_good(false)
+    :m_good(false), m_window(0), m_verify(false), m_metrics(nullptr), m_progress(nullptr), m_hub_scheduler(nullptr)
+    ,m_timing(nullptr), m_caps(), m_sync_seen(false), m_job_depth(0)
+{
+}
+
+COSDConn::COSDConn(std::string const & port_name)
+    :m_good(false), m_fixed_port(port_name), m_window(0), m_verify(false), m_metrics(nullptr), m_progress(nullptr), m_hub_scheduler(nullptr)
+    ,m_timing(nullptr), m_caps(), m_sync_seen(false), m_job_depth(0)
 {
-    m_sp = nullptr;
 }
 
 COSDConn::~COSDConn()
 {
-    if(m_sp != nullptr)
-    {
-        m_sp->close();
-        delete m_sp;
-        m_sp = nullptr;
-    }
+    m_disconnect();
 }
 
 void COSDConn::upload_firmware( std::string const & filename)
 {
-    if(!m_connect()){
-        return;
+    // open the image first, so a bad file doesnt cost an erase
+    upload_firmware(CFirmwareSource::open(filename));
+}
+
+void COSDConn::upload_firmware(std::unique_ptr<CFirmwareSource> source)
+{
+    CFirmwareStream firmware{std::move(source),PROG_MULTI_MAX};
+    job_result job{m_metrics,m_port_name,"firmware",m_job_depth};
+
+    if(!m_enter_bootloader()){
+        throw std::runtime_error("firmware upload : no board");
     }
-    //tell the app to reboot to bootloader
-    m_sync();
-    m_reset_to_bootloader();
-    try {
-        m_sync();
-    }catch (std::exception){
-        // we assume usb_to_osd failed due to reset to bootloader
+    m_program(firmware,nullptr);
+}
+
+/*
+  a release bundle in one session. The board is checked against the bundle header, and
+  the bootloader and image size by m_program, before the erase. The firmware is programmed
+  and verified, then after the reboot the parameters are sent to the app, if it is the
+  firmware version the bundle says. Past the erase a failure leaves the bundle partly applied
+*/
+void COSDConn::apply_bundle(CBundle & bundle)
+{
+    CFirmwareStream firmware{bundle.firmware(),PROG_MULTI_MAX};
+    job_result job{m_metrics,m_port_name,"bundle",m_job_depth};
+
+    if(!m_enter_bootloader()){
+        throw std::runtime_error("apply bundle : no board");
+    }
+    std::string error;
+    if ( m_caps.board_id != bundle.header().board_id){
+        error = "bundle is for board id " + std::to_string(bundle.header().board_id) +
+            " but the board is " + std::to_string(m_caps.board_id);
+    }else if ( static_cast<uint32_t>(m_caps.flash_size) != bundle.header().flash_size){
+        error = "bundle is for a flash size of " + std::to_string(bundle.header().flash_size) +
+            " but the board has " + std::to_string(m_caps.flash_size);
+    }
+    if ( !error.empty()){
+        // nothing has been erased, so the board can go back to its app
+        m_reboot_to_app();
         m_disconnect();
-        std::cout << "Going down for a reboot to the bootloader...\n";
+        throw std::runtime_error(error);
     }
+    m_program(firmware,&bundle.header().firmware_crc);
 
-    std::cout << "We were re-enumerated\n";
-    if(!m_connect()){
-        return;
+    try{
+        wait_for_app();
+        // the running firmware reports its own version in Misc_Firmware_ver
+        uint8_t board[PARAMS_BUF_SIZE];
+        memcpy(board,bundle.params(),PARAMS_BUF_SIZE);
+        get_params_buffer(board);
+        uint16_t const board_version = COSDParam{}.get_firmware_version(board);
+        if ( board_version != bundle.header().firmware_version){
+            throw std::runtime_error("the bundle is for firmware version " +
+                std::to_string(bundle.header().firmware_version) + " but the board reports version " +
+                std::to_string(board_version));
+        }
+        // whatever the board sent after the parameters isnt wanted
+        m_transport->flush();
+    }catch (std::exception & e){
+        throw std::runtime_error(std::string{"bundle partly applied, firmware written but parameters not written : "} + e.what());
+    }
+    try{
+        upload_params_buffer(bundle.params());
+    }catch (std::exception & e){
+        throw std::runtime_error(std::string{"bundle partly applied, firmware written but parameters may not be stored : "} + e.what());
+    }
+    m_message("OK! ... bundle applied");
+}
+
+/*
+  erase, program, verify against the image crc ( and image_crc if given) then reboot to the app.
+  The board must be in the bootloader. Rev3+ bootloaders are verified by the board crc,
+  rev2 by reading back what was programmed
+*/
+void COSDConn::m_program(CFirmwareStream & firmware, uint32_t const * image_crc)
+{
+    m_require_supported("firmware upload");
+    int32_t const board_flash_size = m_caps.flash_size;
+    // padded as the stream pads it
+    int32_t const size_hint = firmware.size_hint();
+    if ( (size_hint >= 0) && ((size_hint + size_hint % 4) > board_flash_size)){
+        // nothing has been erased, so the board can go back to its app
+        m_reboot_to_app();
+        m_disconnect();
+        throw std::runtime_error("firmware image is bigger than the board flash");
     }
-    std:: cout << "re-enumeration OK!\n";
-    //------------------
-    std::cout << "erasing... (Please wait)...\n";
+    firmware.set_chunk_size(m_caps.prog_multi_max());
+    // start reading the image now, so it overlaps with the erase
+    firmware.start();
+    m_phase("erase");
+    m_message("erasing... (Please wait)...");
     m_erase();
-    std::cout << "OK! ... board erased\n";
-    std::cout << "uploading firmware... (Please wait)...\n";
+    m_message("OK! ... board erased");
+    auto bus_slot = m_bus_slot();
+    m_phase("program");
+    m_message("uploading firmware... (Please wait)...");
+
+    // what the board has acknowledged so far, so an interrupted upload
+    // can carry on from there rather than erasing and starting again
+    int32_t bytes_confirmed = 0;
+    uint32_t crc_confirmed = 0;
 
-    Firmware firmware;
-    firmware.board_flash_size = m_get_board_max_flash_size();
+    // up to m_window_size() PROG_MULTIs are sent before waiting for their syncs,
+    // which hides the round trip on a slow link
+    std::deque<FirmwareChunk> pending;      // from the image, not yet sent
+    std::deque<FirmwareChunk> in_flight;    // sent, waiting for sync
+    size_t const window = m_window_size();
+    bool image_done = false;
+    int32_t bytes_taken = 0;                // from the image so far
+    int32_t attempts = 0;
 
-    std::ifstream in( filename, std::ios_base::in | std::ios_base::binary);
+    auto const program_start = clock_type::now();
+    auto last_progress = program_start;
+    // a copy of what was programmed, to compare with what is read back. Rev3+ bootloaders
+    // cant read back, so are only checked by the board crc
+    bool const compare_bytes = m_verify && m_caps.has_read_back();
+    std::vector<uint8_t> programmed;
+    auto confirm = [&](FirmwareChunk const & chunk){
+        if ( compare_bytes){
+            programmed.insert(programmed.end(),chunk.data,chunk.data + chunk.len);
+        }
+        crc_confirmed = px4Uploader::crc_update(chunk.data,chunk.len,crc_confirmed);
+        bytes_confirmed += chunk.len;
+        m_upload_progress("program",bytes_confirmed,firmware.size_hint(),program_start,last_progress);
+    };
 
-    if ( !in || !in.good() ){
-        throw std::runtime_error("Failed to open bin file");
+    for (;;){
+        if ( pending.empty() && !image_done && (in_flight.size() < window)){
+            FirmwareChunk chunk;
+            if ( firmware.next_chunk(chunk)){
+                // without a size up front, stop before writing past the end of the flash
+                bytes_taken += chunk.len;
+                if ( bytes_taken > board_flash_size){
+                    throw std::runtime_error("firmware image is bigger than the board flash");
+                }
+                pending.push_back(chunk);
+            }else{
+                image_done = true;
+            }
+        }
+        if ( pending.empty() && in_flight.empty()){
+            break;
+        }
+        try{
+            if ( !pending.empty() && (in_flight.size() < window)){
+                m_send_prog_multi(pending.front());
+                in_flight.push_back(pending.front());
+                pending.pop_front();
+                continue;
+            }
+            m_get_sync();
+            confirm(in_flight.front());
+            in_flight.pop_front();
+            attempts = 0;
+        }catch (std::exception & e){
+            // resuming needs the board crc
+            if ( (++attempts > max_resume_attempts) || !m_caps.has_crc()){
+                throw;
+            }
+            m_message("upload interrupted at byte " + std::to_string(bytes_confirmed) + " : " + e.what());
+            m_count("playuavosd_upload_retries_total");
+            size_t const landed = m_resume_upload(bytes_confirmed,crc_confirmed,in_flight,board_flash_size);
+            for ( size_t i = 0; i < landed; ++i){
+                confirm(in_flight.front());
+                in_flight.pop_front();
+            }
+            // the rest go again
+            pending.insert(pending.begin(),in_flight.begin(),in_flight.end());
+            in_flight.clear();
+        }
+    }
+    double const program_time = seconds_since(program_start);
+    m_record_phase("program",program_time);
+    m_count("playuavosd_programmed_bytes_total",bytes_confirmed);
+    if ( (m_metrics != nullptr) && (program_time > 0)){
+        m_metrics->observe("playuavosd_upload_throughput_bytes_per_second",
+            CMetrics::labels({{"port",m_port_name}}),bytes_confirmed / program_time);
+    }
+    uint32_t const expected_crc = px4Uploader::crc_pad(firmware.crc_state(),firmware.image_size(),board_flash_size);
+
+    if ( (image_crc != nullptr) && (*image_crc != expected_crc)){
+        m_count("playuavosd_crc_mismatches_total");
+        throw std::runtime_error("firmware image doesnt match its crc");
+    }
+    if ( m_verify && !compare_bytes){
+        m_message("bootloader rev " + std::to_string(m_caps.bl_rev) + " cant read the flash back, verified by the board crc");
     }
+    if ( compare_bytes){
+        m_phase("verify");
+        m_message("verifying firmware... (Please wait)...");
+        size_t offset = 0;
+        m_verify_flash(read_back_len(firmware.image_size()),[&programmed,&offset](uint8_t * expected, size_t n){
+            size_t const got = (offset < programmed.size()) ? std::min(n,programmed.size() - offset) : 0;
+            memcpy(expected,programmed.data() + offset,got);
+            memset(expected + got,0xff,n - got);
+            offset += n;
+        });
+    }
+    if ( m_caps.has_crc()){
+        uint32_t board_crc = m_get_board_crc();
+        if ( expected_crc != board_crc){
+            m_count("playuavosd_crc_mismatches_total");
+            throw std::runtime_error("In firmware upload ...file crc doesnt match uploaded crc\n");
+        }else{
+            m_message("Uploaded firmware crc matches file .. Good");
+        }
+    }else if ( !compare_bytes){
+        m_phase("verify");
+        m_message("verifying firmware... (Please wait)...");
+        int32_t const len = read_back_len(firmware.image_size());
+        uint32_t const read_crc = m_read_back(len,"verify",
+            [](uint8_t const *, size_t){});
+        // erased flash to the end of the last word
+        uint8_t const erased[4] = {0xff,0xff,0xff,0xff};
+        if ( read_crc != px4Uploader::crc_update(erased,len - firmware.image_size(),firmware.crc_state())){
+            m_count("playuavosd_crc_mismatches_total");
+            throw std::runtime_error("In firmware upload ...read back firmware doesnt match file\n");
+        }
+        m_message("Read back firmware matches file .. Good");
+    }
+    bus_slot.reset();
+    m_message("OK! ... firmware uploaded");
+    m_phase("reboot");
+    m_message("rebooting the board...");
+    auto const reboot_start = clock_type::now();
+    m_reboot_to_app();
+    m_record_phase("reboot",seconds_since(reboot_start));
+    m_message("OK! ... board rebooted");
+    m_message("OK! ... firmware uploaded successfully");
+    m_disconnect();
+}
+
+/*
+  Reads the whole flash back from the bootloader, in READ_MULTI sized pieces handed to sink
+  in address order. Many READ_MULTIs are kept in flight since the replies are small.
+  The data is only good if read_flash returns. Rev3+ bootloaders dont have READ_MULTI,
+  so are refused before anything is read.
+  The board is rebooted to the app afterwards.
+*/
+void COSDConn::read_flash(std::function<void(uint8_t const * data, size_t len)> const & sink)
+{
+    job_result job{m_metrics,m_port_name,"readback",m_job_depth};
+
+    if(!m_enter_bootloader()){
+        throw std::runtime_error("read flash : no board");
+    }
+    m_require_supported("read flash");
+    m_require_read_back("read flash");
+    auto bus_slot = m_bus_slot();
+    m_phase("readback");
+    m_message("reading back firmware... (Please wait)...");
+    int32_t const board_flash_size = m_caps.flash_size;
+    if ( (board_flash_size <= 0) || ((board_flash_size % 4) != 0)){
+        throw std::runtime_error("read flash : unexpected board flash size");
+    }
+    m_read_back(board_flash_size,"readback",sink);
+    m_message("bootloader rev " + std::to_string(m_caps.bl_rev) + " has no board crc, read back not checked");
+    bus_slot.reset();
+    m_phase("reboot");
+    m_reboot_to_app();
+    m_message("OK! ... firmware read back");
+    m_disconnect();
+}
 
-    // get size of bin file
-    in.seekg(0,in.end);
-    firmware.image_size = in.tellg();
-    in.seekg(0,in.beg);
+void COSDConn::verify_firmware(std::string const & filename)
+{
+    verify_firmware(CFirmwareSource::open(filename));
+}
 
-    firmware.imagebyte.resize(firmware.image_size + (firmware.image_size % 4));
+/*
+  The image is streamed in READ_MULTI sized chunks, in step with the read back.
+  Only as far as the image is read back if its size is known. Reading back needs a rev2
+  bootloader, which has no board crc, so the flash past the image isnt checked
+*/
+void COSDConn::verify_firmware(std::unique_ptr<CFirmwareSource> source)
+{
+    CFirmwareStream firmware{std::move(source),READ_MULTI_MAX};
+    job_result job{m_metrics,m_port_name,"verify",m_job_depth};
 
-    for( int i = 0; i < static_cast<int32_t>(firmware.imagebyte.size());++i){
-        if(i < firmware.image_size){
-            firmware.imagebyte.at(i) = in.get();
+    if(!m_enter_bootloader()){
+        throw std::runtime_error("verify firmware : no board");
+    }
+    m_require_supported("verify firmware");
+    m_require_read_back("verify firmware");
+    int32_t const board_flash_size = m_caps.flash_size;
+    int32_t const size_hint = firmware.size_hint();
+    int32_t const len = (size_hint >= 0) ? read_back_len(size_hint) : board_flash_size;
+    if ( len > board_flash_size){
+        m_reboot_to_app();
+        m_disconnect();
+        throw std::runtime_error("firmware image is bigger than the board flash");
+    }
+    auto bus_slot = m_bus_slot();
+    m_phase("verify");
+    m_message("verifying firmware... (Please wait)...");
+    firmware.start();
+    FirmwareChunk chunk;
+    bool image_done = false;
+    bool image_longer = false;
+    m_verify_flash(len,[&](uint8_t * expected, size_t n){
+        size_t got = 0;
+        if ( !image_done && firmware.next_chunk(chunk)){
+            image_longer = image_longer || (chunk.len > n);
+            got = std::min(n,static_cast<size_t>(chunk.len));
+            memcpy(expected,chunk.data,got);
         }else{
-            firmware.imagebyte.at(i) = 0xff;
+            image_done = true;
         }
+        memset(expected + got,0xff,n - got);
+    });
+    if ( image_longer || (!image_done && firmware.next_chunk(chunk))){
+        throw std::runtime_error("verify firmware : the image is bigger than the board flash");
     }
+    bus_slot.reset();
+    m_message("OK! ... firmware verified");
+    m_phase("reboot");
+    m_reboot_to_app();
+    m_disconnect();
+}
 
-    firmware.expected_crc = px4Uploader::crc(firmware.imagebyte,firmware.board_flash_size);
+/*
+  the first len bytes of flash, in READ_MULTI sized pieces handed to sink in address order.
+  Many READ_MULTIs are kept in flight since the replies are small.
+  returns the crc state of what was read
+*/
+uint32_t COSDConn::m_read_back(int32_t len, char const * phase,
+    std::function<void(uint8_t const * data, size_t len)> const & sink)
+{
+    auto const start = clock_type::now();
+    auto last_progress = start;
 
-    uint8_t arr [PROG_MULTI_MAX];
-    int32_t image_bytes_left = firmware.imagebyte.size();
-    int32_t image_idx = 0;
+    // rev2 verify resets the bootloader read address to the start of flash
+    uint8_t const verify_cmd [] = {CHIP_VERIFY, EOC};
+    m_send(verify_cmd,2);
+    m_get_sync();
 
-    while ( (image_bytes_left > 0) ){
-        int32_t const sequence_length = quan::min(static_cast<int32_t>(PROG_MULTI_MAX),image_bytes_left);
+    size_t const window = std::max(m_window_size(),readback_window);
+    std::deque<uint8_t> in_flight;      // lengths requested, waiting for data
+    int32_t bytes_requested = 0;
+    int32_t bytes_read = 0;
+    uint32_t crc_state = 0;
+    uint8_t arr [READ_MULTI_MAX];
 
-        for ( int32_t i = 0;i < sequence_length; ++i){
-            arr[i] = firmware.imagebyte.at(image_idx);
-            ++ image_idx;
+    while ( bytes_read < len){
+        if ( (bytes_requested < len) && (in_flight.size() < window)){
+            uint8_t const n = static_cast<uint8_t>(
+                quan::min(static_cast<int32_t>(READ_MULTI_MAX),len - bytes_requested));
+            uint8_t const cmd [] = {READ_MULTI,n,EOC};
+            m_send(cmd,3);
+            in_flight.push_back(n);
+            bytes_requested += n;
+            continue;
         }
-        m_send(PROG_MULTI);
-        m_send(static_cast<uint8_t>(sequence_length));
-        m_send(arr,sequence_length);
-        m_send(EOC);
+        uint8_t const n = in_flight.front();
+        in_flight.pop_front();
+        m_recv(arr,n);
         m_get_sync();
-        image_bytes_left -= sequence_length;
+        crc_state = px4Uploader::crc_update(arr,n,crc_state);
+        bytes_read += n;
+        sink(arr,n);
+        m_upload_progress(phase,bytes_read,len,start,last_progress);
     }
-    if (image_bytes_left != 0 ){
-        throw std::runtime_error("infile Failed while uploading bin file");
+    m_record_phase(phase,seconds_since(start));
+    return crc_state;
+}
+
+/*
+  reads back the first len bytes of flash, comparing each piece as it arrives with what
+  expected fills in for it. Throws with the differing ranges, so only they need looking at.
+  returns the crc state of what was read
+*/
+uint32_t COSDConn::m_verify_flash(int32_t len, std::function<void(uint8_t * expected, size_t len)> const & expected)
+{
+    std::vector<std::pair<int32_t,int32_t> > ranges;  // differing, [begin,end)
+    int32_t address = 0;
+    uint8_t want [READ_MULTI_MAX];
+    uint32_t const crc_state = m_read_back(len,"verify",[&](uint8_t const * data, size_t n){
+        expected(want,n);
+        for ( size_t i = 0; i < n; ++i, ++address){
+            if ( data[i] != want[i]){
+                if ( !ranges.empty() && (ranges.back().second == address)){
+                    ++ranges.back().second;
+                }else{
+                    ranges.push_back({address,address + 1});
+                }
+            }
+        }
+    });
+    if ( ranges.empty()){
+        m_message("Read back firmware matches file byte for byte .. Good");
+        return crc_state;
     }
+    int32_t bytes_differing = 0;
+    for ( auto const & range : ranges){
+        bytes_differing += range.second - range.first;
+    }
+    for ( size_t i = 0; i < std::min(ranges.size(),verify_ranges_shown); ++i){
+        m_message("differs from " + hex_address(ranges[i].first) + " to " + hex_address(ranges[i].second) +
+            " ( " + std::to_string(ranges[i].second - ranges[i].first) + " bytes)");
+    }
+    if ( ranges.size() > verify_ranges_shown){
+        m_message("... and " + std::to_string(ranges.size() - verify_ranges_shown) + " more ranges");
+    }
+    m_count("playuavosd_verify_mismatched_bytes_total",bytes_differing);
+    throw std::runtime_error("firmware verify : " + std::to_string(bytes_differing) + " bytes differ in " +
+        std::to_string(ranges.size()) + " ranges");
+}
 
-    uint32_t board_crc = m_get_board_crc();
-    if ( firmware.expected_crc != board_crc){
-        throw std::runtime_error("In firmware upload ...file crc doesnt match uploaded crc\n");
-    }else{
-        std::cout << "Uploaded firmware crc matches file .. Good\n";
+/*
+  the board is probed in the bootloader, where it can say what it is.
+  Older bootloaders give what they can, with no serial
+*/
+board_identity COSDConn::read_identity()
+{
+    job_result job{m_metrics,m_port_name,"identify",m_job_depth};
+
+    if(!m_enter_bootloader()){
+        throw std::runtime_error("identify : no board");
+    }
+    m_phase("identify");
+    auto const identify_start = clock_type::now();
+    board_identity board{};
+    board.port = m_port_name;
+    board.bl_rev = m_caps.bl_rev;
+    board.board_id = m_caps.board_id;
+    board.board_rev = m_caps.board_rev;
+    board.flash_size = m_caps.flash_size;
+    if ( m_caps.has_crc()){
+        board.firmware_crc = m_get_board_crc();
+    }
+    if ( m_caps.has_identity()){
+        char hex[9];
+        for ( uint32_t i = 0; i < serial_words; ++i){
+            snprintf(hex,sizeof hex,"%08x",m_read_word(GET_SN,i * 4));
+            board.serial += hex;
+        }
+        for ( uint32_t address = 0; address < identity_otp_bytes; address += 4){
+            snprintf(hex,sizeof hex,"%08x",m_read_word(GET_OTP,address));
+            board.otp += hex;
+        }
+        board.chip_id = m_get_chip();
     }
-    std::cout << "OK! ... firmware uploaded\n";
-    std::cout << "rebooting the board...\n";
+    board.probed = std::chrono::duration_cast<std::chrono::seconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    m_record_phase("identify",seconds_since(identify_start));
+
+    m_phase("reboot");
     m_reboot_to_app();
-    std::cout << "OK! ... board rebooted\n";
-    std::cout << "OK! ... firmware uploaded successfully\n";
     m_disconnect();
+    return board;
 }
 
 void COSDConn::upload_params(const std::string &filename)
 {
+    COSDParam osdparams;
+    uint8_t paramsbuf[PARAMS_BUF_SIZE];
+
+    if(filename.empty()){
+        m_message("OK! ... loading default parameters");
+        osdparams.get_default_params(paramsbuf);
+    }
+    else{
+        m_message("OK! ... loading parameters from file:" + filename);
+        // parameters not in the file, e.g Misc_Firmware_ver, keep their defaults
+        osdparams.get_default_params(paramsbuf);
+        if(!osdparams.load_params_from_file(filename, paramsbuf)){
+            return;
+        }
+    }
+    upload_params_buffer(paramsbuf);
+}
+
+void COSDConn::upload_params_buffer(uint8_t const * paramsbuf)
+{
+    job_result job{m_metrics,m_port_name,"params_write",m_job_depth};
+    if(!m_connect()){
+        return;
+    }
+
+    m_sync();
+
+    // a parameter image is too small to hold up other boards on the hub, so takes no slot
+    m_phase("params_write");
+    m_message("OK! ... starting send parameters to board");
+    auto const transfer_start = clock_type::now();
+    m_send_params(paramsbuf,params_extent());
+    m_record_phase("params_write",seconds_since(transfer_start));
+    m_count("playuavosd_param_bytes_total",params_extent());
+
+    m_save_params();
+    m_message("OK! ... parameters stored on the board");
+    if ( m_verify){
+        m_verify_params(paramsbuf);
+    }
+}
+
+void COSDConn::push_params(uint8_t const * paramsbuf, size_t len)
+{
+    job_result job{m_metrics,m_port_name,"params_push",m_job_depth};
+    if ( (len == 0) || (len > PARAMS_BUF_SIZE)){
+        throw std::runtime_error("push params : bad length");
+    }
     if(!m_connect()){
         return;
     }
+    m_sync();
+    auto const transfer_start = clock_type::now();
+    m_send_params(paramsbuf,len);
+    m_record_phase("params_push",seconds_since(transfer_start));
+    m_count("playuavosd_param_bytes_total",len);
+}
 
+void COSDConn::save_params()
+{
+    job_result job{m_metrics,m_port_name,"eeprom_save",m_job_depth};
+    if(!m_connect()){
+        return;
+    }
     m_sync();
+    m_save_params();
+}
 
+/*
+  the board image is read first, so re-applying a config costs only a read on boards
+  that have it. Only the start of the image up to the last change is sent, the board
+  keeping the rest, and the eeprom is only written if something changed.
+  The read is always the whole buffer, as GET_PARAMS has no length
+*/
+std::vector<std::string> COSDConn::sync_params(uint8_t const * paramsbuf)
+{
+    job_result job{m_metrics,m_port_name,"params_sync",m_job_depth};
+    uint8_t board[PARAMS_BUF_SIZE];
+    memcpy(board,paramsbuf,PARAMS_BUF_SIZE);
+    get_params_buffer(board);
+
+    COSDParam const osdparams;
+    std::vector<std::string> const changed = osdparams.changed_params(board,paramsbuf);
+    if ( changed.empty()){
+        m_count("playuavosd_param_syncs_skipped_total");
+        m_message("OK! ... board parameters already match, nothing written");
+        return changed;
+    }
+    std::string names;
+    for ( auto const & name : changed){
+        names += (names.empty() ? "" : ", ") + name;
+    }
+    m_message("changed : " + names);
+
+    int32_t end = 0;
+    for ( int32_t i = 0; i < params_extent(); ++i){
+        if ( board[i] != paramsbuf[i]){
+            end = i + 1;
+        }
+    }
+    // whatever the board sent after the parameters, e.g a sync, isnt wanted
+    m_transport->flush();
+    push_params(paramsbuf,(end + 3) & ~3);
+    save_params();
+    m_message("OK! ... parameters stored on the board");
+    if ( m_verify){
+        m_verify_params(paramsbuf);
+    }
+    return changed;
+}
+
+void COSDConn::get_params(const std::string &filename)
+{
     COSDParam osdparams;
     uint8_t paramsbuf[PARAMS_BUF_SIZE];
+    osdparams.get_default_params(paramsbuf);
 
-    if(filename.empty()){
-        std::cout << "OK! ... loading default parameters\n";
-        osdparams.get_default_params(paramsbuf);
+    get_params_buffer(paramsbuf);
+
+    m_message("OK! ... saving parameters to file:" + filename);
+    osdparams.store_params_to_file(filename, paramsbuf);
+}
+
+void COSDConn::get_params_buffer(uint8_t * paramsbuf)
+{
+    job_result job{m_metrics,m_port_name,"params_read",m_job_depth};
+    if(!m_connect()){
+        return;
     }
-    else{
-        std::cout << "OK! ... loading parameters from file:" << filename << std::endl;
-        if(!osdparams.load_params_from_file(filename, paramsbuf)){
-            return;
+
+    m_sync();
+    m_read_params(paramsbuf);
+}
+
+// GET_PARAMS on a synced connection
+void COSDConn::m_read_params(uint8_t * paramsbuf)
+{
+    m_phase("params_read");
+    m_message("OK! ... getting parameters from board");
+    auto const transfer_start = clock_type::now();
+    m_send(GET_PARAMS);
+    m_send(EOC);
+
+    // GET_PARAMS has no length, so the board always sends the whole buffer. Keep the
+    // used part and read past the rest, leaving the unused part of paramsbuf as it was
+    int32_t const extent = params_extent();
+    m_recv(paramsbuf, extent);
+    uint8_t unused [PARAMS_BUF_SIZE];
+    m_recv(unused, PARAMS_BUF_SIZE - extent);
+    // newer firmware follows the data with a sync. It is taken here if it comes,
+    // so the connection is left in step for whatever is sent next
+    if ( m_transport->wait_avail(2,params_sync_timeout)){
+        m_get_sync();
+    }
+    m_record_phase("params_read",seconds_since(transfer_start));
+    m_count("playuavosd_param_bytes_total",extent);
+}
+
+/*
+  after the eeprom save, the parameters are read back on the same connection and compared
+  parameter by parameter, so unused bytes and those the board sets itself dont count
+*/
+void COSDConn::m_verify_params(uint8_t const * paramsbuf)
+{
+    m_phase("params_verify");
+    uint8_t board[PARAMS_BUF_SIZE];
+    memcpy(board,paramsbuf,PARAMS_BUF_SIZE);
+    m_read_params(board);
+    COSDParam const osdparams;
+    std::vector<std::string> const wrong = osdparams.params_not_stored(paramsbuf,board);
+    if ( wrong.empty()){
+        m_message("OK! ... parameters read back match");
+        return;
+    }
+    std::string names;
+    for ( auto const & name : wrong){
+        names += (names.empty() ? "" : ", ") + name;
+    }
+    m_count("playuavosd_param_verify_failures_total");
+    throw std::runtime_error("parameters read back dont match : " + names);
+}
+
+void COSDConn::open()
+{
+    m_connect();
+    m_sync();
+}
+
+void COSDConn::close()
+{
+    m_disconnect();
+}
+
+void COSDConn::m_send_prog_multi(FirmwareChunk const & chunk)
+{
+    m_send(PROG_MULTI);
+    m_send(chunk.len);
+    m_send(chunk.data,chunk.len);
+    m_send(EOC);
+}
+
+/*
+  Called when a PROG_MULTI failed. Reconnects to the bootloader and works out from the board crc
+  how many of the in flight chunks were programmed. Flash is written sequentially, so the board crc
+  is the crc of the confirmed image prefix plus some leading part of in_flight, padded with 0xff.
+  returns the number of in_flight chunks that made it.
+  throws if the board isnt in any of those states, since then only a full upload will do
+*/
+size_t COSDConn::m_resume_upload(int32_t bytes_confirmed, uint32_t crc_confirmed,
+        std::deque<FirmwareChunk> const & in_flight, int32_t board_flash_size)
+{
+    m_disconnect();
+    for ( int32_t i = 0; !m_connected() && (i < 10); ++i){
+        std::this_thread::sleep_for(std::chrono::milliseconds{500});
+        m_connect();
+    }
+    m_throw_if_not_connected();
+    m_transport->flush();
+    m_sync();
+
+    uint32_t const board_crc = m_get_board_crc();
+
+    std::vector<uint32_t> candidates;
+    uint32_t state = crc_confirmed;
+    int32_t len = bytes_confirmed;
+    candidates.push_back(px4Uploader::crc_pad(state,len,board_flash_size));
+    for ( auto const & chunk : in_flight){
+        state = px4Uploader::crc_update(chunk.data,chunk.len,state);
+        len += chunk.len;
+        candidates.push_back(px4Uploader::crc_pad(state,len,board_flash_size));
+    }
+
+    size_t landed = candidates.size();
+    for ( size_t i = 0; i < candidates.size(); ++i){
+        if ( candidates[i] == board_crc){
+            if ( landed != candidates.size()){
+                // chunks of all 0xff so we cant tell where the bootloader write address is
+                throw std::runtime_error("cannot resume upload : board position unknown");
+            }
+            landed = i;
+        }
+    }
+    if ( landed == candidates.size()){
+        throw std::runtime_error("cannot resume upload : board crc doesnt match the uploaded part of the image");
+    }
+    int32_t resume_at = bytes_confirmed;
+    for ( size_t i = 0; i < landed; ++i){
+        resume_at += in_flight[i].len;
+    }
+    m_message("resuming upload at byte " + std::to_string(resume_at));
+    return landed;
+}
+
+// from the app, reboots to the bootloader and reconnects
+bool COSDConn::m_enter_bootloader()
+{
+    if(!m_connect()){
+        return false;
+    }
+    //tell the app to reboot to bootloader
+    m_sync();
+    auto const reset_start = clock_type::now();
+    m_reset_to_bootloader();
+    bool rebooted = false;
+    try {
+        m_sync();
+    }catch (std::exception){
+        // we assume usb_to_osd failed due to reset to bootloader
+        m_disconnect();
+        m_message("Going down for a reboot to the bootloader...");
+        rebooted = true;
+    }
+
+    // tried until the bootloader is there, rather than after a fixed time
+    auto const timeout = m_timeout(CTimingModel::reboot,reboot_timeout);
+    while ( !m_connected()){
+        if ( clock_type::now() - reset_start > timeout){
+            return false;
         }
+        std::this_thread::sleep_for(reconnect_period);
+        m_connect();
+    }
+    if ( rebooted){
+        m_add_timing(CTimingModel::reboot,reset_start);
+    }
+    m_message("We were re-enumerated");
+    m_read_caps();
+    m_message("re-enumeration OK!");
+    return true;
+}
+
+// asked once per bootloader session, and the rest of the session works from the answers
+void COSDConn::m_read_caps()
+{
+    m_caps.bl_rev = m_get_device_info(INFO_BL_REV);
+    m_caps.board_id = m_get_device_info(INFO_BOARD_ID);
+    m_caps.board_rev = m_get_device_info(INFO_BOARD_REV);
+    m_caps.flash_size = m_get_board_max_flash_size();
+    m_model = std::to_string(m_caps.board_id) + "/" + std::to_string(m_caps.flash_size);
+    m_message("bootloader rev " + std::to_string(m_caps.bl_rev) + ", board id " + std::to_string(m_caps.board_id) +
+        ", flash " + std::to_string(m_caps.flash_size) + " bytes");
+}
+
+// before anything is erased, so the board can go back to its app
+void COSDConn::m_require_supported(char const * job)
+{
+    if ( m_caps.supported()){
+        return;
     }
+    m_count("playuavosd_unsupported_bootloader_total");
+    m_reboot_to_app();
+    m_disconnect();
+    throw std::runtime_error(std::string{job} + " : bootloader protocol rev " + std::to_string(m_caps.bl_rev) +
+        " is not supported, only " + std::to_string(BL_REV_MIN) + " to " + std::to_string(BL_REV_MAX));
+}
 
-    std::cout << "OK! ... starting send parameters to board\n";
+// likewise for jobs that read the flash back
+void COSDConn::m_require_read_back(char const * job)
+{
+    if ( m_caps.has_read_back()){
+        return;
+    }
+    m_reboot_to_app();
+    m_disconnect();
+    throw std::runtime_error(std::string{job} + " : bootloader protocol rev " + std::to_string(m_caps.bl_rev) +
+        " cant read the flash back, only rev " + std::to_string(BL_REV_MIN) + " can");
+}
+
+// the round trip depends on the link as much as the board, so a sync timeout
+// isnt trusted until this connection has shown it is in line with what was learned
+std::chrono::milliseconds COSDConn::m_timeout(CTimingModel::kind k, std::chrono::milliseconds fallback) const
+{
+    if ( (m_timing == nullptr) || ((k == CTimingModel::sync) && !m_sync_seen)){
+        return fallback;
+    }
+    return m_timing->timeout(CTransport::kind_of(m_port_name),m_model,k,fallback);
+}
+
+// the fixed sync_timeout until the round trip is learned
+std::chrono::milliseconds COSDConn::m_reply_timeout() const
+{
+    return std::min(sync_timeout,m_timeout(CTimingModel::sync,sync_timeout) + command_time);
+}
+
+void COSDConn::m_add_timing(CTimingModel::kind k, clock_type::time_point const & start)
+{
+    if ( m_timing != nullptr){
+        m_timing->add(CTransport::kind_of(m_port_name),m_model,k,seconds_since(start));
+    }
+}
+
+// waits for a slot on the board's usb hub, if a scheduler was given
+std::unique_ptr<CHubSlot> COSDConn::m_bus_slot()
+{
+    if ( m_hub_scheduler == nullptr){
+        return std::unique_ptr<CHubSlot>{};
+    }
+    m_phase("hub_wait");
+    auto const wait_start = clock_type::now();
+    std::unique_ptr<CHubSlot> slot{new CHubSlot{m_hub_scheduler,CHubScheduler::hub_of(m_port_name)}};
+    m_record_phase("hub_wait",seconds_since(wait_start));
+    return slot;
+}
+
+// START_TRANSFER, the first len bytes of paramsbuf as SET_PARAMS, then END_TRANSFER
+void COSDConn::m_send_params(uint8_t const * paramsbuf, size_t len)
+{
     m_send(START_TRANSFER);
     m_send(EOC);
     m_get_sync();
 
-    uint8_t arr [PROG_MULTI_MAX];
-    int32_t params_bytes_left = PARAMS_BUF_SIZE;
+    int32_t params_bytes_left = len;
     int32_t params_idx = 0;
+    size_t const window = m_window_size();
+    size_t in_flight = 0;
 
     while ( (params_bytes_left > 0) ){
         int32_t const sequence_length = quan::min(static_cast<int32_t>(PROG_MULTI_MAX),params_bytes_left);
 
-        for ( int32_t i = 0;i < sequence_length; ++i){
-            arr[i] = paramsbuf[params_idx];
-            ++ params_idx;
-        }
         m_send(SET_PARAMS);
         m_send(static_cast<uint8_t>(sequence_length));
-        m_send(arr,sequence_length);
+        m_send(paramsbuf + params_idx,sequence_length);
         m_send(EOC);
-        m_get_sync();
+        params_idx += sequence_length;
         params_bytes_left -= sequence_length;
+        if ( ++in_flight == window){
+            m_get_sync();
+            --in_flight;
+        }
+    }
+    while ( in_flight > 0){
+        m_get_sync();
+        --in_flight;
     }
 
     m_send(END_TRANSFER);
     m_send(EOC);
     m_get_sync();
+}
 
+void COSDConn::m_save_params()
+{
+    auto const save_start = clock_type::now();
     m_send(SAVE_TO_EEPROM);
     m_send(EOC);
-    m_get_sync();
-    std::cout << "OK! ... parameters stored on the board\n";
+    // the eeprom write takes longer than other commands, and isnt learned
+    m_get_sync(sync_timeout);
+    m_record_phase("eeprom_save",seconds_since(save_start));
 }
 
-void COSDConn::get_params(const std::string &filename)
+// after a reboot to the app, waits for the board to come back
+void COSDConn::wait_for_app()
 {
-    if(!m_connect()){
-        return;
-    }
-
-    m_sync();
-
-    COSDParam osdparams;
-    uint8_t paramsbuf[PARAMS_BUF_SIZE];
-    osdparams.get_default_params(paramsbuf);
-
-    std::cout << "OK! ... getting parameters from board\n";
-    m_send(GET_PARAMS);
-    m_send(EOC);
-    //m_recv(paramsbuf, PARAMS_BUF_SIZE);
-
-    uint8_t arr [READ_MULTI_MAX];
-    int32_t params_bytes_left = PARAMS_BUF_SIZE;
-    int32_t params_idx = 0;
-
-    while ( (params_bytes_left > 0) ){
-        int32_t const sequence_length = quan::min(static_cast<int32_t>(PROG_MULTI_MAX),params_bytes_left);
-        m_recv(arr, sequence_length);
-        for ( int32_t i = 0;i < sequence_length; ++i){
-            paramsbuf[params_idx] = arr[i];
-            ++ params_idx;
+    m_disconnect();
+    m_phase("connect");
+    for ( int32_t i = 0; i < 20; ++i){
+        std::this_thread::sleep_for(std::chrono::milliseconds{500});
+        try{
+            m_connect();
+            if ( m_connected()){
+                m_sync();
+                return;
+            }
+        }catch (std::exception & e){
+            m_disconnect();
         }
-        params_bytes_left -= sequence_length;
     }
-    //m_get_sync();   //bug - Fixme!
+    throw std::runtime_error("board didnt come back after reboot");
+}
 
-    std::cout << "OK! ... saving parameters to file:" << filename << std::endl;
-    osdparams.store_params_to_file(filename, paramsbuf);
+size_t COSDConn::m_window_size() const
+{
+    if ( m_window > 0){
+        return m_window;
+    }
+    return (m_transport != nullptr) ? m_transport->default_window() : 1;
 }
 
 bool COSDConn::m_connect()
 {
-    std::cout << "trying to connect Playuav OSD board...\n";
-    std::cout << "looking for likely ports...\n";
+    // keep an open connection
+    if ( m_connected()){
+        return true;
+    }
+    m_disconnect();
+    // until the bootloader says, it may not be the board that was there before
+    m_model.clear();
+    m_sync_seen = false;
+    m_phase("connect");
+    m_message("trying to connect Playuav OSD board...");
+    auto const connect_start = clock_type::now();
     try{
-        // assume 5 ttyACM ports for now ACM0 to ACM4
-        constexpr uint32_t num_acm_ports = 5;
-
-        std::string port_name = "";
-        for ( uint8_t i = 0; i < num_acm_ports; ++i){
-            char int_name [4] = {'\0'};
-            quan::itoasc(i,int_name,10);
-            port_name = "/dev/ttyACM" + std::string{int_name};
+        std::vector<std::string> port_names;
+        if ( m_port_finder){
+            std::string const port_name = m_port_finder();
+            if ( !port_name.empty()){
+                port_names.push_back(port_name);
+            }
+        }else if ( !m_fixed_port.empty()){
+            port_names.push_back(m_fixed_port);
+        }else{
+            m_message("looking for likely ports...");
+            // assume 5 ttyACM ports for now ACM0 to ACM4
+            constexpr uint32_t num_acm_ports = 5;
+            for ( uint8_t i = 0; i < num_acm_ports; ++i){
+                char int_name [4] = {'\0'};
+                quan::itoasc(i,int_name,10);
+                port_names.push_back("/dev/ttyACM" + std::string{int_name});
+            }
+        }
+
+        for ( auto const & port_name : port_names){
             try {
-                m_sp = new quan::serial_port(port_name.c_str());
-                m_sp->init();
-                m_good = m_sp->good() && (m_sp->set_baud(115200) == 0);
+                m_transport = m_transport_factory ? m_transport_factory(port_name) : CTransport::open(port_name);
+                m_good = m_transport->good();
                 if ( m_good){
-                    std::cout << "Found PlayUAV OSD on " << port_name <<'\n';
+                    m_message("Found PlayUAV OSD on " + port_name);
+                    m_port_name = port_name;
+                    m_record_phase("connect",seconds_since(connect_start));
                     break;
                 }
+                m_disconnect();
             }catch(std::exception & e){
                 // any exception means try another port
                 m_disconnect();
             }
         }
     }catch (std::exception & e){
-        std::cout << "connect failed with :" <<  e.what() << "'\n";
+        m_message(std::string{"connect failed with :"} + e.what());
     }
     return true;
 }
 
 void COSDConn::m_disconnect()
 {
-    if(m_sp != nullptr){
-        m_sp->close();
-        delete m_sp;
-        m_sp = nullptr;
-        m_good = false;
+    if(m_transport != nullptr){
+        m_transport->close();
+        m_transport.reset();
     }
+    m_good = false;
 }
 void COSDConn::m_send(uint8_t c)
 {
     m_throw_if_not_connected();
-    m_sp->write(&c,1);
+    m_transport->write(&c,1);
 }
 
 void COSDConn::m_send( uint8_t const* arr, size_t len)
 {
     m_throw_if_not_connected();
-    m_sp->write(arr,len) ;
+    m_transport->write(arr,len) ;
 }
 
 void COSDConn::m_recv(uint8_t * arr, size_t count)
 {
     m_throw_if_not_connected();
-    if ( m_sp->read(arr,count) == -1){
-        throw std::runtime_error("usb_to_osd read failed");
+    try{
+        m_transport->read(arr,count,recv_timeout);
+    }catch (std::exception & e){
+        throw std::runtime_error(std::string{"usb_to_osd read failed : "} + e.what());
     }
 }
 
@@ -330,17 +1164,14 @@ uint32_t COSDConn::m_recv_uint()
 
 void COSDConn::m_get_sync()
 {
-   
-    quan:: timer<> timer;
+    m_get_sync(m_reply_timeout());
+}
 
-    while ( timer() < quan::time::s{7}){
-         m_throw_if_not_connected();
-        if (m_sp->in_avail() > 1 ){
-            break;
-        }
-    }
-     m_throw_if_not_connected();
-    if ( m_sp->in_avail() < 2){
+void COSDConn::m_get_sync(std::chrono::milliseconds timeout)
+{
+    m_throw_if_not_connected();
+    if ( !m_transport->wait_avail(2,timeout)){
+        m_count("playuavosd_sync_timeouts_total");
         throw std::runtime_error("get_sync : expected INSYNC");
     }
 
@@ -362,20 +1193,55 @@ void COSDConn::m_get_sync()
     }
 }
 
+/*
+  once the round trip is known, a lost GET_SYNC is retried after a short timeout
+  so a dead link is found quickly. Until then the one long timeout is used
+*/
 void COSDConn::m_sync()
 {
     m_throw_if_not_connected();
     uint8_t const sync_cmd [] = {GET_SYNC, EOC};
-    m_send(sync_cmd,2);
-    m_get_sync();
+    auto const timeout = m_timeout(CTimingModel::sync,sync_timeout);
+    int32_t const attempts = (timeout < sync_timeout) ? sync_attempts : 1;
+    for ( int32_t attempt = 1; ; ++attempt){
+        auto const start = clock_type::now();
+        m_send(sync_cmd,2);
+        if ( m_transport->wait_avail(2,timeout)){
+            m_get_sync(timeout);
+            if ( attempt == 1){
+                m_add_timing(CTimingModel::sync,start);
+                m_sync_seen = true;
+            }else{
+                // the reply taken may be to an earlier attempt, with those to the later ones
+                // still on the way. They are read and dropped so the next command doesnt take
+                // one as its reply. One not seen within the timeout is taken as lost
+                for ( int32_t late = 1; (late < attempt) && m_transport->wait_avail(2,timeout); ++late){
+                    uint8_t reply[2];
+                    m_recv(reply,2);
+                }
+            }
+            return;
+        }
+        if ( !m_transport->good() || (attempt == attempts)){
+            m_count("playuavosd_sync_timeouts_total");
+            throw std::runtime_error("get_sync : expected INSYNC");
+        }
+        m_count("playuavosd_sync_retries_total");
+        m_transport->flush();
+    }
 }
 
 int32_t COSDConn::m_get_board_max_flash_size()
+{
+    return static_cast<int32_t>(m_get_device_info(INFO_FLASH_SIZE));
+}
+
+uint32_t COSDConn::m_get_device_info(uint8_t info)
 {
     m_throw_if_not_connected();
-    uint8_t const cmd [] = { GET_DEVICE, INFO_FLASH_SIZE, EOC};
+    uint8_t const cmd [] = { GET_DEVICE, info, EOC};
     m_send(cmd,3);
-    int32_t result = m_recv_int();
+    uint32_t result = m_recv_uint();
     m_get_sync();
     return result;
 }
@@ -391,6 +1257,29 @@ uint32_t COSDConn::m_get_board_crc()
 }
 
 
+uint32_t COSDConn::m_get_chip()
+{
+    m_throw_if_not_connected();
+    uint8_t const cmd [] = {GET_CHIP, EOC};
+    m_send(cmd,2);
+    uint32_t result = m_recv_uint();
+    m_get_sync();
+    return result;
+}
+
+// a word of the serial ( GET_SN) or otp ( GET_OTP) area at a byte address
+uint32_t COSDConn::m_read_word(uint8_t cmd, uint32_t address)
+{
+    m_throw_if_not_connected();
+    uint8_t const arr [] = {cmd,
+        static_cast<uint8_t>(address), static_cast<uint8_t>(address >> 8),
+        static_cast<uint8_t>(address >> 16), static_cast<uint8_t>(address >> 24), EOC};
+    m_send(arr,6);
+    uint32_t result = m_recv_uint();
+    m_get_sync();
+    return result;
+}
+
 // works  in bl or app
 void COSDConn::m_reset_to_bootloader()
 {
@@ -398,21 +1287,19 @@ void COSDConn::m_reset_to_bootloader()
     uint8_t const cmd [] = {PROTO_BL_UPLOAD, EOC};
     m_send(cmd,2);
     m_get_sync();
-    quan::timer<> t;
-    while (1){
-      m_throw_if_not_connected();
-       if (m_sp->in_avail()){
-        uint8_t ch;
-        m_recv(&ch);
-       }else{
-         break;
-       }
+    // throw away anything else the app sent
+    m_transport->flush();
+    // give the board time to go down, returning as soon as the link goes.
+    // Whether it has is found by the next sync, since the port may already have gone
+    auto const reset_start = clock_type::now();
+    auto const deadline = reset_start + m_timeout(CTimingModel::reset,reset_timeout);
+    while ( m_transport->good() && (clock_type::now() < deadline)){
+        if ( m_transport->wait_avail(1,std::chrono::duration_cast<std::chrono::milliseconds>(deadline - clock_type::now()))){
+            m_transport->flush();
+        }
     }
-    m_throw_if_not_connected();
-    m_sp->flush();
-    while (t() < quan::time::ms{1000}) {;}
-    if( !m_sp->good()){
-        throw std::runtime_error("reset to bootloader : couldnt connect");
+    if ( !m_transport->good()){
+        m_add_timing(CTimingModel::reset,reset_start);
     }
 }
 
@@ -429,23 +1316,25 @@ void COSDConn::m_reboot_to_app()
 void COSDConn::m_erase()
 {
     m_throw_if_not_connected();
-    m_sp->flush();
+    m_transport->flush();
     m_sync();
+    auto const erase_start = clock_type::now();
     uint8_t arr []= {CHIP_ERASE,EOC};
     m_send(arr,2);
-    quan::timer<> t;
-    while ( t() < quan::time::s{20}){
-        m_throw_if_not_connected();
-        if (m_sp->in_avail() > 0 ){
-            break;
-        }
+    // until the erase time of the model is known, allow for the size of the flash
+    int32_t const flash_mb = std::max<int32_t>(1,(m_caps.flash_size + (1 << 20) - 1) >> 20);
+    if ( !m_transport->wait_avail(1,m_timeout(CTimingModel::erase,erase_timeout * flash_mb))){
+        m_count("playuavosd_sync_timeouts_total");
+        throw std::runtime_error("erase : no answer from the board");
     }
     m_get_sync();
+    m_record_phase("erase",seconds_since(erase_start));
+    m_add_timing(CTimingModel::erase,erase_start);
 }
 
 bool COSDConn::m_connected() const
 {
-    return m_good && m_sp->good();
+    return m_good && m_transport->good();
 }
 
 void COSDConn::m_throw_if_not_connected()
@@ -454,3 +1343,52 @@ void COSDConn::m_throw_if_not_connected()
         throw std::runtime_error("not connected");
     }
 }
+
+void COSDConn::m_record_phase(char const * phase, double seconds)
+{
+    if ( m_metrics != nullptr){
+        m_metrics->observe("playuavosd_phase_duration_seconds",
+            CMetrics::labels({{"port",m_port_name},{"phase",phase}}),seconds);
+    }
+}
+
+void COSDConn::m_count(char const * name, double inc)
+{
+    if ( m_metrics != nullptr){
+        m_metrics->count(name,CMetrics::labels({{"port",m_port_name}}),inc);
+    }
+}
+
+void COSDConn::m_message(std::string const & text)
+{
+    if ( m_progress != nullptr){
+        m_progress->message(text);
+    }else{
+        std::cout << text << '\n';
+    }
+}
+
+void COSDConn::m_phase(char const * phase)
+{
+    if ( m_progress != nullptr){
+        m_progress->phase(phase);
+    }
+}
+
+// posts upload progress, at most every progress_period so the ring isnt flooded
+void COSDConn::m_upload_progress(char const * phase, int32_t bytes_done, int32_t bytes_total,
+    clock_type::time_point const & start, clock_type::time_point & last)
+{
+    if ( m_progress == nullptr){
+        return;
+    }
+    auto const now = clock_type::now();
+    if ( ((now - last) < progress_period) && (bytes_done != bytes_total)){
+        return;
+    }
+    last = now;
+    double const elapsed = std::chrono::duration<double>(now - start).count();
+    float const rate = (elapsed > 0) ? static_cast<float>(bytes_done / elapsed) : 0.f;
+    float const eta = ((bytes_total > 0) && (rate > 0)) ? (bytes_total - bytes_done) / rate : -1.f;
+    m_progress->progress(phase,bytes_done,bytes_total,rate,eta);
+}
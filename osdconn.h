@@ -20,7 +20,26 @@ Authors:
   
 */
 
-#include <quan/serial_port.hpp>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <functional>
+
+#include "transport.h"
+#include "timing.h"
+
+struct FirmwareChunk;
+class CFirmwareSource;
+class CFirmwareStream;
+class CBundle;
+class CMetrics;
+class CProgressChannel;
+class CHubScheduler;
+class CHubSlot;
+struct board_identity;
 
 class COSDConn{
 
@@ -51,11 +70,14 @@ public:
        INFO_BL_REV = 1,//	# bootloader protocol revision
        BL_REV_MIN = 2,//	# minimum supported bootloader protocol
        BL_REV_MAX = 4,//	# maximum supported bootloader protocol
+       BL_REV_CRC = 3,//	# GET_CRC, else the flash is checked by reading it back
+       BL_REV_IDENTITY = 4,//	# GET_SN, GET_OTP, GET_CHIP and a whole buffer per PROG_MULTI
        INFO_BOARD_ID = 2,//	# board type
        INFO_BOARD_REV = 3,//	# board revision
        INFO_FLASH_SIZE = 4,//	# max firmware size in bytes
 
        PROG_MULTI_MAX = 60,//		# protocol max is 255, must be multiple of 4
+       PROG_MULTI_MAX_REV4 = 252,//	# rev4+ bootloaders take up to their 256 byte buffer
        READ_MULTI_MAX = 60,//		# protocol max is 255, something overflows with >= 64
 
        START_TRANSFER = 0x24,      //tell the osd we will start send params
@@ -65,32 +87,157 @@ public:
        SAVE_TO_EEPROM = 0x29,
    };
 
+    // what the bootloader says about itself and the board, read once on entering it
+    struct bootloader_caps{
+        uint32_t bl_rev;
+        uint32_t board_id;
+        uint32_t board_rev;
+        int32_t flash_size;
+        bool supported() const { return (bl_rev >= BL_REV_MIN) && (bl_rev <= BL_REV_MAX);}
+        bool has_crc() const { return bl_rev >= BL_REV_CRC;}
+        bool has_identity() const { return bl_rev >= BL_REV_IDENTITY;}
+        // CHIP_VERIFY and READ_MULTI
+        bool has_read_back() const { return bl_rev < BL_REV_CRC;}
+        size_t prog_multi_max() const { return has_identity() ? PROG_MULTI_MAX_REV4 : PROG_MULTI_MAX;}
+    };
+
     COSDConn();
+    // only ever use the given port e.g "/dev/ttyACM1" rather than searching
+    explicit COSDConn(std::string const & port_name);
     ~COSDConn();
 
+    // connections are opened as needed and kept open between jobs,
+    // open and close give explicit control
+    void open();
+    void close();
+
     void upload_firmware( std::string const & filename);
+    void upload_firmware(std::unique_ptr<CFirmwareSource> source);
+    // firmware then parameters from a release bundle, in one session
+    void apply_bundle(CBundle & bundle);
+    // whole board flash. Only rev2 bootloaders can read the flash back
+    void read_flash(std::function<void(uint8_t const * data, size_t len)> const & sink);
+    // reads the flash back and compares it byte for byte with the image, which is blank flash
+    // past its end. Throws with the differing address ranges
+    void verify_firmware(std::string const & filename);
+    void verify_firmware(std::unique_ptr<CFirmwareSource> source);
     void upload_params(std::string const & filename);
     void get_params(std::string const & filename);
+    // after a firmware upload, waits for the board to come back in its app
+    void wait_for_app();
+    // serial, chip, board and bootloader details and the flash crc, from the bootloader.
+    // The board is rebooted to the app afterwards
+    board_identity read_identity();
+
+    // parameter images in memory, PARAMS_BUF_SIZE bytes
+    void upload_params_buffer(uint8_t const * paramsbuf);
+    void get_params_buffer(uint8_t * paramsbuf);
+    // live update of the first len bytes of the parameters, which the board copies
+    // over its parameters from the start. Not kept over a reboot until save_params
+    void push_params(uint8_t const * paramsbuf, size_t len);
+    // write the board's current parameters to eeprom
+    void save_params();
+    // reads the board parameters and only writes and saves them if they differ.
+    // Returns the names of the parameters that changed
+    std::vector<std::string> sync_params(uint8_t const * paramsbuf);
+
+    // after a firmware upload, also read the flash back and compare it byte for byte.
+    // After parameters are stored, read them back on the same connection and compare them
+    void set_verify(bool verify) { m_verify = verify;}
+
+    // requests in flight before waiting for replies, 0 uses the transport default
+    void set_window(size_t window) { m_window = window;}
+
+    // port of the current or last connection
+    std::string const & port_name() const { return m_port_name;}
+
+    // optional, record phase timings and error counts for each job
+    void set_metrics(CMetrics * metrics) { m_metrics = metrics;}
+    // optional, status and progress go to the channel rather than std::cout
+    // so console output never holds up the transfer
+    void set_progress(CProgressChannel * channel) { m_progress = channel;}
+    // optional, shared between boards so only so many on one usb hub transfer at once
+    void set_hub_scheduler(CHubScheduler * scheduler) { m_hub_scheduler = scheduler;}
+    // optional, used in place of CTransport::open to make connections
+    void set_transport_factory(transport_factory const & factory) { m_transport_factory = factory;}
+    // optional, asked for the port on each connect in place of the fixed port, for boards
+    // whose tty may change when they re-enumerate. Returns empty while the board isnt there
+    void set_port_finder(std::function<std::string()> const & finder) { m_port_finder = finder;}
+    // optional, shared between boards. Sync, erase and reboot timeouts are taken from
+    // what has been seen of the board model on the same kind of transport, and what is seen is added.
+    // The sync timeout is only learned once a round trip has been seen on this connection
+    void set_timing(CTimingModel * timing) { m_timing = timing;}
 
 private:
+    typedef std::chrono::steady_clock clock_type;
+
     void m_send(uint8_t c);
     void m_send( uint8_t const* arr, size_t len);
     void m_recv(uint8_t * arr, size_t count = 1);
     int32_t m_recv_int();
     uint32_t m_recv_uint();
+    // the INSYNC and status that end a reply, within the learned reply time or the one given
     void m_get_sync();
+    void m_get_sync(std::chrono::milliseconds timeout);
     void m_sync();
     int32_t m_get_board_max_flash_size();
+    uint32_t m_get_device_info(uint8_t info);
     uint32_t m_get_board_crc();
+    uint32_t m_get_chip();
+    uint32_t m_read_word(uint8_t cmd, uint32_t address);
     void m_reset_to_bootloader();
     void m_reboot_to_app();
     void m_erase();
+    void m_send_prog_multi(FirmwareChunk const & chunk);
+    size_t m_resume_upload(int32_t bytes_confirmed, uint32_t crc_confirmed,
+        std::deque<FirmwareChunk> const & in_flight, int32_t board_flash_size);
+    void m_send_params(uint8_t const * paramsbuf, size_t len);
+    void m_save_params();
+    void m_read_params(uint8_t * paramsbuf);
+    void m_verify_params(uint8_t const * paramsbuf);
+    bool m_enter_bootloader();
+    void m_read_caps();
+    void m_require_supported(char const * job);
+    void m_require_read_back(char const * job);
+    uint32_t m_read_back(int32_t len, char const * phase,
+        std::function<void(uint8_t const * data, size_t len)> const & sink);
+    uint32_t m_verify_flash(int32_t len, std::function<void(uint8_t * expected, size_t len)> const & expected);
+    std::chrono::milliseconds m_timeout(CTimingModel::kind k, std::chrono::milliseconds fallback) const;
+    std::chrono::milliseconds m_reply_timeout() const;
+    void m_add_timing(CTimingModel::kind k, clock_type::time_point const & start);
+    void m_program(CFirmwareStream & firmware, uint32_t const * image_crc);
+    std::unique_ptr<CHubSlot> m_bus_slot();
+    size_t m_window_size() const;
     bool m_connect();
     void m_disconnect();
     bool m_connected() const;
     void m_throw_if_not_connected();
+    void m_record_phase(char const * phase, double seconds);
+    void m_count(char const * name, double inc = 1.0);
+    void m_message(std::string const & text);
+    void m_phase(char const * phase);
+    void m_upload_progress(char const * phase, int32_t bytes_done, int32_t bytes_total,
+        clock_type::time_point const & start, clock_type::time_point & last);
 
-    quan::serial_port* m_sp;
+    std::unique_ptr<CTransport> m_transport;
     bool m_good;
+    std::string const m_fixed_port;
+    size_t m_window;
+    bool m_verify;
+    std::string m_port_name;
+    CMetrics* m_metrics;
+    CProgressChannel* m_progress;
+    CHubScheduler* m_hub_scheduler;
+    transport_factory m_transport_factory;
+    std::function<std::string()> m_port_finder;
+    CTimingModel* m_timing;
+    // once seen in the bootloader
+    bootloader_caps m_caps;
+    // board id / flash size, for the timings. Empty until the bootloader is asked
+    std::string m_model;
+    // a GET_SYNC round trip has been timed on this connection
+    bool m_sync_seen;
+    // jobs running, so only the outermost is counted in metrics
+    int32_t m_job_depth;
 };
 
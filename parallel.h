@@ -0,0 +1,61 @@
+#pragma once
+
+/*
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+ 
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program. If not, see <http://www.gnu.org/licenses/>
+
+Authors:
+   Andy Little
+   Tom Ren
+  
+*/
+
+#include <cstddef>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+
+/*
+  fn(i) for each i from 0 to n - 1, on up to threads threads ( 0 for one per core).
+  Indices are handed out in blocks as each thread finishes its last, so uneven work
+  still keeps every thread busy. fn must not throw
+*/
+template <typename F>
+inline void parallel_for(size_t n, size_t threads, F const & fn, size_t block = 64)
+{
+    if ( threads == 0){
+        threads = std::max(1U,std::thread::hardware_concurrency());
+    }
+    threads = std::min(threads,(n + block - 1) / block);
+    std::atomic<size_t> next{0};
+    auto const worker = [n,block,&next,&fn]{
+        for (;;){
+            size_t const begin = next.fetch_add(block);
+            if ( begin >= n){
+                return;
+            }
+            for ( size_t i = begin; i < std::min(n,begin + block); ++i){
+                fn(i);
+            }
+        }
+    };
+    std::vector<std::thread> pool;
+    for ( size_t t = 1; t < threads; ++t){
+        pool.emplace_back(worker);
+    }
+    worker();
+    for ( auto & t : pool){
+        t.join();
+    }
+}
@@ -26,15 +26,29 @@ Authors:
 #include <stdexcept>
 #include <fstream>
 #include <sstream>
+#include <cstdio>
 #include <math.h>
 #include <list>
+#include <algorithm>
+
+constexpr uint16_t COSDParam::m_firmware_version;
+constexpr uint16_t COSDParam::m_protocol_type;
+
+namespace {
+    // room for every parameter m_init_params sets
+    constexpr size_t max_params = 320;
+}
+
+struct COSDParam::layout{
+    param_entry entries[max_params];
+    size_t count;
+    uint8_t defaults[PARAMS_BUF_SIZE];
+    int32_t size;
+};
 
 COSDParam::COSDParam():
-    m_firmware_version{10},
-    m_protocol_type{0}
+    m_layout_size{m_layout().size}
 {
-    memset((char *)m_default_params, 0, PARAMS_BUF_SIZE);
-    m_init_params();
 }
 
 COSDParam::~COSDParam()
@@ -52,27 +66,29 @@ bool COSDParam::load_params_from_file(const std::string &filename, uint8_t * buf
     }
 
     in.seekg(0, std::ios::beg);
+    return m_load_params(in, buf_in);
+}
+
+bool COSDParam::load_params_from_string(const std::string &text, uint8_t * buf_in)
+{
+    std::istringstream in(text);
+    return m_load_params(in, buf_in);
+}
+
+bool COSDParam::m_load_params(std::istream & in, uint8_t * buf_in)
+{
     while(in.peek() != EOF){
         char buf[256] = {0};
         in.getline(buf, 256);
-        std::string strLine(buf);
-        std::string strParamName = "";
-        std::string strParamValue = "";
-
-        int pos = strLine.find('=');
-        if(pos != -1){
-            try {
-                strParamName = strLine.substr(0,pos);
-                strParamValue = strLine.substr(pos+1,strLine.length()-1);
-                m_str_to_buf(buf_in, strParamName, strParamValue);
-            }catch(std::exception & e){
-                std::cout << "Bad parameter item: " << strLine << std::endl;
-                return false;
-            }
 
+        // split the line at the '=' and use the two halves where they are
+        char * const pos = strchr(buf, '=');
+        if(pos != nullptr){
+            *pos = '\0';
+            m_str_to_buf(buf_in, buf, pos + 1);
         }
         else{
-            std::cout << "Bad parameter item: " << strLine;
+            std::cout << "Bad parameter item: " << buf;
             return false;
         }
     }
@@ -90,18 +106,7 @@ bool COSDParam::store_params_to_file(const std::string &filename, uint8_t * buf_
         return false;
     }
 
-    ParamsAddrMap::iterator iterParamsAddr;
-    for(iterParamsAddr = m_params_addr.begin(); iterParamsAddr != m_params_addr.end(); iterParamsAddr++){
-        if((iterParamsAddr->first).find("Misc_Start_Col_Sign") != std::string::npos) continue;
-        if((iterParamsAddr->first).find("Altitude_Scale_Source") != std::string::npos) continue;    //not-used
-        if((iterParamsAddr->first).find("Speed_Scale_Source") != std::string::npos) continue;    //not-used
-        if((iterParamsAddr->first).find("Attitude_MP_Scale_Frac") != std::string::npos) continue;
-        if((iterParamsAddr->first).find("Attitude_3D_Scale_Frac") != std::string::npos) continue;
-        if((iterParamsAddr->first).find("Attitude_MP_Mode") != std::string::npos) continue;         //not-used
-        if((iterParamsAddr->first).find("Misc_Firmware_ver") != std::string::npos) continue;   //not allowed modify
-
-        fo << m_param_serialize(buf_in, iterParamsAddr->second, iterParamsAddr->first);
-    }
+    fo << params_to_string(buf_in);
 
     fo.flush();
     fo.close();
@@ -109,15 +114,195 @@ bool COSDParam::store_params_to_file(const std::string &filename, uint8_t * buf_
     return true;
 }
 
+std::string COSDParam::params_to_string(uint8_t * buf_in)
+{
+    std::string result;
+    for ( auto const & param : params()){
+        if(strstr(param.name, "Misc_Start_Col_Sign") != nullptr) continue;
+        if(strstr(param.name, "Altitude_Scale_Source") != nullptr) continue;    //not-used
+        if(strstr(param.name, "Speed_Scale_Source") != nullptr) continue;    //not-used
+        if(strstr(param.name, "Attitude_MP_Scale_Frac") != nullptr) continue;
+        if(strstr(param.name, "Attitude_3D_Scale_Frac") != nullptr) continue;
+        if(strstr(param.name, "Attitude_MP_Mode") != nullptr) continue;         //not-used
+        if(strstr(param.name, "Misc_Firmware_ver") != nullptr) continue;   //not allowed modify
+
+        result += m_param_serialize(buf_in, param.address, param.name);
+    }
+    return result;
+}
+
+uint16_t COSDParam::get_firmware_version(uint8_t const * buf_in) const
+{
+    int32_t const addr = address_of("Misc_Firmware_ver");
+    return static_cast<uint16_t>(buf_in[addr] + (buf_in[addr+1] << 8));
+}
+
+std::vector<std::string> COSDParam::changed_params(uint8_t const * from, uint8_t const * to) const
+{
+    std::vector<std::string> result;
+    for ( auto const & param : params()){
+        if ( memcmp(from + param.address, to + param.address, 2) != 0){
+            result.push_back(param.name);
+        }
+    }
+    return result;
+}
+
+std::vector<std::string> COSDParam::params_not_stored(uint8_t const * sent, uint8_t const * board) const
+{
+    std::vector<std::string> result = changed_params(sent,board);
+    result.erase(std::remove(result.begin(),result.end(),std::string{"Misc_Firmware_ver"}),result.end());
+    return result;
+}
+
+void COSDParam::set_param(uint8_t * buf_in, const std::string & paramname, const std::string & paramvalue)
+{
+    m_str_to_buf(buf_in, paramname.c_str(), paramvalue.c_str());
+}
+
+std::vector<int32_t> COSDParam::param_addresses(const std::string & paramname) const
+{
+    std::vector<int32_t> result;
+    for ( auto const & suffix : {"", "_Real", "_Frac", "_Sign"}){
+        int32_t const addr = address_of((paramname + suffix).c_str());
+        if ( addr >= 0){
+            result.push_back(addr);
+        }
+    }
+    return result;
+}
+
+namespace {
+    // plain decimal that fits in a parameter word
+    bool is_u16(const std::string & s)
+    {
+        if ( s.empty() || (s.length() > 5) || (s.find_first_not_of("0123456789") != std::string::npos)){
+            return false;
+        }
+        return atoi(s.c_str()) <= 0xFFFF;
+    }
+}
+
+bool COSDParam::check_param(const std::string & paramname, const std::string & paramvalue) const
+{
+    if ( param_addresses(paramname).empty() || (paramname == "Misc_Firmware_ver")){
+        return false;
+    }
+    param_kind const kind = kind_of(paramname);
+    if ( kind == param_kind::panel){
+        if ( paramvalue == "0"){
+            return true;
+        }
+        // panels 1 to 9, each once
+        uint16_t seen = 0;
+        std::istringstream ss(paramvalue);
+        std::string s;
+        while(getline(ss, s, ',')){
+            int const panel = atoi(s.c_str());
+            if ( !is_u16(s) || (panel < 1) || (panel > 9) || (seen & (1 << (panel - 1)))){
+                return false;
+            }
+            seen |= 1 << (panel - 1);
+        }
+        return (seen != 0) && (paramvalue.back() != ',');
+    }
+    if ( kind == param_kind::scale){
+        size_t const ndp = paramvalue.find('.');
+        if ( ndp == std::string::npos){
+            return is_u16(paramvalue);
+        }
+        // the fraction is stored as a whole number, so "1.05" would come back as "1.5"
+        std::string const frac = paramvalue.substr(ndp + 1);
+        return is_u16(paramvalue.substr(0,ndp)) && is_u16(frac) && ((frac == "0") || (frac[0] != '0'));
+    }
+    if ( (kind == param_kind::start_col) && (paramvalue[0] == '-')){
+        return is_u16(paramvalue.substr(1));
+    }
+    return is_u16(paramvalue);
+}
+
+// the same tests in the same order as m_str_to_buf
+COSDParam::param_kind COSDParam::kind_of(char const * paramname)
+{
+    if((strstr(paramname, "_Panel") != nullptr) &&
+       (strstr(paramname, "PWM") == nullptr)    &&
+       (strstr(paramname, "Max_Panels") == nullptr)){
+        return param_kind::panel;
+    }
+    if((strstr(paramname, "Attitude_") != nullptr) &&
+       (strstr(paramname, "_Scale") != nullptr)){
+        return param_kind::scale;
+    }
+    if((strstr(paramname, "Misc_Start_Row") != nullptr)){
+        return param_kind::start_row;
+    }
+    if((strstr(paramname, "Misc_Start_Col") != nullptr)){
+        return param_kind::start_col;
+    }
+    return param_kind::plain;
+}
+
+COSDParam::param_kind COSDParam::kind_of(const std::string & paramname)
+{
+    return kind_of(paramname.c_str());
+}
+
+// those params_to_string leaves out, less the ones written with another parameter
+bool COSDParam::in_text(const std::string & paramname)
+{
+    return (paramname.find("Altitude_Scale_Source") == std::string::npos) &&
+        (paramname.find("Speed_Scale_Source") == std::string::npos) &&
+        (paramname.find("Attitude_MP_Mode") == std::string::npos) &&
+        (paramname.find("Misc_Firmware_ver") == std::string::npos);
+}
+
 void COSDParam::get_default_params(uint8_t *buf_in)
 {
-    memcpy(buf_in, m_default_params, PARAMS_BUF_SIZE);
+    memcpy(buf_in, m_layout().defaults, PARAMS_BUF_SIZE);
 }
 
-void COSDParam::m_set_params_default(const std::string &paramname, int32_t addr, uint16_t initval)
+COSDParam::param_range COSDParam::params()
 {
-    m_params_addr[paramname] = addr;
-    m_u16_to_buf(m_default_params, addr, initval);
+    layout const & l = m_layout();
+    return param_range{l.entries, l.entries + l.count};
+}
+
+int32_t COSDParam::address_of(char const * paramname)
+{
+    param_range const r = params();
+    auto const iter = std::lower_bound(r.begin(), r.end(), paramname,
+        [](param_entry const & entry, char const * name){ return strcmp(entry.name, name) < 0;});
+    if ( (iter != r.end()) && (strcmp(iter->name, paramname) == 0)){
+        return iter->address;
+    }
+    return -1;
+}
+
+// built on first use, in fixed storage sorted in place, so lookups need no heap
+COSDParam::layout const & COSDParam::m_layout()
+{
+    static layout const the_layout = []{
+        layout l;
+        l.count = 0;
+        l.size = 0;
+        memset(l.defaults, 0, PARAMS_BUF_SIZE);
+        m_init_params(l);
+        std::sort(l.entries, l.entries + l.count,
+            [](param_entry const & lhs, param_entry const & rhs){ return strcmp(lhs.name, rhs.name) < 0;});
+        return l;
+    }();
+    return the_layout;
+}
+
+void COSDParam::m_set_params_default(layout & l, char const * paramname, int32_t addr, uint16_t initval)
+{
+    if ( (l.count == max_params) || (addr + 2 > PARAMS_BUF_SIZE)){
+        throw std::runtime_error("parameter table full");
+    }
+    l.entries[l.count++] = param_entry{paramname, addr};
+    m_u16_to_buf(l.defaults, addr, initval);
+    // keep to whole words, the same as the firmware chunks
+    l.size = std::max(l.size, (addr + 2 + 3) & ~3);
 }
 
 void COSDParam::m_u16_to_buf(uint8_t * buf, int32_t addr, uint16_t val)
@@ -126,98 +311,86 @@ void COSDParam::m_u16_to_buf(uint8_t * buf, int32_t addr, uint16_t val)
     buf[addr+1] = (uint8_t)((val >> 8) & 0xFF);
 }
 
-void COSDParam::m_str_to_buf(uint8_t *buf, const std::string &paramname, const std::string &paramvalue)
+void COSDParam::m_str_to_buf(uint8_t *buf, char const * paramname, char const * paramvalue)
 {
-    try {
-        int32_t paramAddr = 0;
-        ParamsAddrMap::iterator iterParamsAddr;
-
-        //panel : we store the panel using ',' as sperator in files for readable,
-        //        but we store it on osd board as single value
-        //    ex: 1,2,3 ====> 2^(1-1) + 2^(2-1) + 2^(3-1)=7
-        //      : 2,4   ====> 2^(2-1) + 2^(4-1) = 10
-        if((paramname.find("_Panel") != std::string::npos) &&
-           (paramname.find("PWM") == std::string::npos)    &&
-           (paramname.find("Max_Panels") == std::string::npos)){
-            iterParamsAddr = m_params_addr.find(paramname);
-            if(iterParamsAddr != m_params_addr.end()){
-                paramAddr = iterParamsAddr->second;
-                uint16_t nval = m_panel_str_to_u16(paramvalue);
-                m_u16_to_buf(buf, paramAddr, nval);
-            }
-            return;
+    // the _Real, _Frac and _Sign words, named from the .posd name
+    char wordname[64];
+
+    switch(kind_of(paramname)){
+    //panel : we store the panel using ',' as sperator in files for readable,
+    //        but we store it on osd board as single value
+    //    ex: 1,2,3 ====> 2^(1-1) + 2^(2-1) + 2^(3-1)=7
+    //      : 2,4   ====> 2^(2-1) + 2^(4-1) = 10
+    case param_kind::panel:{
+        int32_t const paramAddr = address_of(paramname);
+        if(paramAddr >= 0){
+            uint16_t nval = m_panel_str_to_u16(paramvalue);
+            m_u16_to_buf(buf, paramAddr, nval);
         }
+        return;
+    }
 
-        //Scale : we store the scale as float, and we use uint16_t in buffer for alignment.
-        //        hence, we stroe the real and frac into two uint16_t
-        if((paramname.find("Attitude_") != std::string::npos) &&
-           (paramname.find("_Scale") != std::string::npos)){
-            int ndp = paramvalue.find('.');
-            uint16_t nval_real = 0;
-            uint16_t nval_frac = 0;
-            if(ndp != -1){
-                nval_real = atoi(paramvalue.substr(0,ndp).c_str());
-                nval_frac = atoi(paramvalue.substr(ndp+1,paramvalue.length()-1).c_str());
-            }
-            else{
-                nval_real = atoi(paramvalue.c_str());
-            }
-            iterParamsAddr = m_params_addr.find(paramname + "_Real");
-            if(iterParamsAddr != m_params_addr.end()){
-                paramAddr = iterParamsAddr->second;
-                m_u16_to_buf(buf, paramAddr, nval_real);
-            }
+    //Scale : we store the scale as float, and we use uint16_t in buffer for alignment.
+    //        hence, we stroe the real and frac into two uint16_t
+    case param_kind::scale:{
+        // atoi stops at the '.'
+        uint16_t const nval_real = atoi(paramvalue);
+        char const * const ndp = strchr(paramvalue, '.');
+        uint16_t const nval_frac = (ndp != nullptr) ? atoi(ndp + 1) : 0;
+
+        snprintf(wordname, sizeof(wordname), "%s_Real", paramname);
+        int32_t paramAddr = address_of(wordname);
+        if(paramAddr >= 0){
+            m_u16_to_buf(buf, paramAddr, nval_real);
+        }
 
-            iterParamsAddr = m_params_addr.find(paramname + "_Frac");
-            if(iterParamsAddr != m_params_addr.end()){
-                paramAddr = iterParamsAddr->second;
-                m_u16_to_buf(buf, paramAddr, nval_frac);
-            }
-            return;
+        snprintf(wordname, sizeof(wordname), "%s_Frac", paramname);
+        paramAddr = address_of(wordname);
+        if(paramAddr >= 0){
+            m_u16_to_buf(buf, paramAddr, nval_frac);
         }
+        return;
+    }
 
-        //Misc_Start_Row : don't allow negative value
-        if((paramname.find("Misc_Start_Row") != std::string::npos)){
-            iterParamsAddr = m_params_addr.find(paramname);
-            if(iterParamsAddr != m_params_addr.end()){
-                paramAddr = iterParamsAddr->second;
-                uint16_t nval = abs(atoi(paramvalue.c_str()));
-                m_u16_to_buf(buf, paramAddr, nval);
-            }
-            return;
+    //Misc_Start_Row : don't allow negative value
+    case param_kind::start_row:{
+        int32_t const paramAddr = address_of(paramname);
+        if(paramAddr >= 0){
+            uint16_t nval = abs(atoi(paramvalue));
+            m_u16_to_buf(buf, paramAddr, nval);
         }
+        return;
+    }
 
-        //Misc_Start_Col : allow negative value, store the sign and value seperately
-        if((paramname.find("Misc_Start_Col") != std::string::npos)){
-            int nval = atoi(paramvalue.c_str());
-            uint16_t absval = abs(nval);
-            uint16_t nsign = (nval < 0) ? 0 : 1;
-
-            iterParamsAddr = m_params_addr.find(paramname);
-            if(iterParamsAddr != m_params_addr.end()){
-                paramAddr = iterParamsAddr->second;
-                m_u16_to_buf(buf, paramAddr, absval);
-            }
+    //Misc_Start_Col : allow negative value, store the sign and value seperately
+    case param_kind::start_col:{
+        int nval = atoi(paramvalue);
+        uint16_t absval = abs(nval);
+        // from the '-' rather than the value, so "-0" keeps its sign
+        uint16_t nsign = (paramvalue[0] == '-') ? 0 : 1;
 
-            iterParamsAddr = m_params_addr.find(paramname + "_Sign");
-            if(iterParamsAddr != m_params_addr.end()){
-                paramAddr = iterParamsAddr->second;
-                m_u16_to_buf(buf, paramAddr, nsign);
-            }
-            return;
+        int32_t paramAddr = address_of(paramname);
+        if(paramAddr >= 0){
+            m_u16_to_buf(buf, paramAddr, absval);
         }
 
-        //It is a normal uint16_t value
-        iterParamsAddr = m_params_addr.find(paramname);
-        if(iterParamsAddr != m_params_addr.end())
-        {
-            paramAddr = iterParamsAddr->second;
-            uint16_t nval = atoi(paramvalue.c_str());
-            m_u16_to_buf(buf, paramAddr, nval);
+        snprintf(wordname, sizeof(wordname), "%s_Sign", paramname);
+        paramAddr = address_of(wordname);
+        if(paramAddr >= 0){
+            m_u16_to_buf(buf, paramAddr, nsign);
         }
+        return;
+    }
 
-    }catch(std::exception & e){
-        std::cout << paramname << "=" << paramvalue << "with exception:" << e.what() << std::endl;
+    //It is a normal uint16_t value
+    default:{
+        int32_t const paramAddr = address_of(paramname);
+        if(paramAddr >= 0){
+            uint16_t nval = atoi(paramvalue);
+            m_u16_to_buf(buf, paramAddr, nval);
+        }
+        return;
+    }
     }
 }
 
@@ -287,11 +460,10 @@ std::string COSDParam::m_param_serialize(uint8_t *buf, int32_t addr, const std::
         if((paramname.find("Misc_Start_Col") != std::string::npos)){
             realvalue = m_get_u16_param(buf, addr);
             uint16_t signvalue = 0;
-            ParamsAddrMap::iterator iterParamsAddr;
 
-            iterParamsAddr = m_params_addr.find("Misc_Start_Col_Sign");
-            if(iterParamsAddr != m_params_addr.end()){
-                signvalue = m_get_u16_param(buf, iterParamsAddr->second);
+            int32_t const signAddr = address_of("Misc_Start_Col_Sign");
+            if(signAddr >= 0){
+                signvalue = m_get_u16_param(buf, signAddr);
             }
 
             if(signvalue == 0){
@@ -319,321 +491,313 @@ std::string COSDParam::m_param_serialize(uint8_t *buf, int32_t addr, const std::
     return paramname + "=" + strret + "\n";
 }
 
-uint16_t COSDParam::m_panel_str_to_u16(const std::string paramvalue)
+uint16_t COSDParam::m_panel_str_to_u16(char const * paramvalue)
 {
     uint16_t nret = 0;
-    int ntmp = 0;
-    try{
-        std::istringstream ss(paramvalue);
-        std::string s;
-        while(getline(ss, s, ',')){
-            ntmp = atoi(s.c_str());
-            nret += static_cast<uint16_t>(pow(2.0f, ntmp-1));
+    // atoi stops at the next ','
+    for ( char const * s = paramvalue; ; ++s){
+        int const ntmp = atoi(s);
+        nret += static_cast<uint16_t>(pow(2.0f, ntmp-1));
+        s = strchr(s, ',');
+        if ( (s == nullptr) || (s[1] == '\0')){
+            break;
         }
-
     }
-    catch(std::exception){
-        std::cout << "Bad parameter item: " << paramvalue << std::endl;
-        return 0;
-    }
-
     return nret;
 }
 
 void COSDParam::dump_params(uint8_t * buf)
 {
-    ParamsAddrMap::iterator iterParamsAddr;
-    for(iterParamsAddr = m_params_addr.begin(); iterParamsAddr != m_params_addr.end(); iterParamsAddr++){
-        std::cout << iterParamsAddr->first;
+    for ( auto const & param : params()){
+        std::cout << param.name;
         std::cout << ":";
-        std::cout << m_get_u16_param(buf, iterParamsAddr->second);
+        std::cout << m_get_u16_param(buf, param.address);
         std::cout << std::endl;
     }
 }
 
-void COSDParam::m_init_params()
+void COSDParam::m_init_params(layout & l)
 {
-    m_params_addr.clear();
     int32_t address = 0;
 
-    m_set_params_default("ArmState_Enable",address, 1); address += 2;
-    m_set_params_default("ArmState_Panel",address, 1); address += 2;
-    m_set_params_default("ArmState_H_Position",address, 350); address += 2;
-    m_set_params_default("ArmState_V_Position",address, 44); address += 2;
-    m_set_params_default("ArmState_Font_Size",address, 0); address += 2;
-    m_set_params_default("ArmState_H_Alignment",address, 2); address += 2;
-
-    m_set_params_default("BatteryVoltage_Enable",address, 1); address += 2;
-    m_set_params_default("BatteryVoltage_Panel",address, 1); address += 2;
-    m_set_params_default("BatteryVoltage_H_Position",address, 350); address += 2;
-    m_set_params_default("BatteryVoltage_V_Position",address, 4); address += 2;
-    m_set_params_default("BatteryVoltage_Font_Size",address, 0); address += 2;
-    m_set_params_default("BatteryVoltage_H_Alignment",address, 2); address += 2;
-
-    m_set_params_default("BatteryCurrent_Enable",address, 1); address += 2;
-    m_set_params_default("BatteryCurrent_Panel",address, 1); address += 2;
-    m_set_params_default("BatteryCurrent_H_Position",address, 350); address += 2;
-    m_set_params_default("BatteryCurrent_V_Position",address, 14); address += 2;
-    m_set_params_default("BatteryCurrent_Font_Size",address, 0); address += 2;
-    m_set_params_default("BatteryCurrent_H_Alignment",address, 2); address += 2;
-
-    m_set_params_default("BatteryRemaining_Enable",address, 1); address += 2;
-    m_set_params_default("BatteryRemaining_Panel",address, 1); address += 2;
-    m_set_params_default("BatteryRemaining_H_Position",address, 350); address += 2;
-    m_set_params_default("BatteryRemaining_V_Position",address, 24); address += 2;
-    m_set_params_default("BatteryRemaining_Font_Size",address, 0); address += 2;
-    m_set_params_default("BatteryRemaining_H_Alignment",address, 2); address += 2;
-
-    m_set_params_default("FlightMode_Enable",address, 1); address += 2;
-    m_set_params_default("FlightMode_Panel",address, 1); address += 2;
-    m_set_params_default("FlightMode_H_Position",address, 350); address += 2;
-    m_set_params_default("FlightMode_V_Position",address, 54); address += 2;
-    m_set_params_default("FlightMode_Font_Size",address, 1); address += 2;
-    m_set_params_default("FlightMode_H_Alignment",address, 2); address += 2;
-
-    m_set_params_default("GPSStatus_Enable",address, 1); address += 2;
-    m_set_params_default("GPSStatus_Panel",address, 1); address += 2;
-    m_set_params_default("GPSStatus_H_Position",address, 0); address += 2;
-    m_set_params_default("GPSStatus_V_Position",address, 230); address += 2;
-    m_set_params_default("GPSStatus_Font_Size",address, 0); address += 2;
-    m_set_params_default("GPSStatus_H_Alignment",address, 0); address += 2;
-
-    m_set_params_default("GPSHDOP_Enable",address, 1); address += 2;
-    m_set_params_default("GPSHDOP_Panel",address, 1); address += 2;
-    m_set_params_default("GPSHDOP_H_Position",address, 70); address += 2;
-    m_set_params_default("GPSHDOP_V_Position",address, 230); address += 2;
-    m_set_params_default("GPSHDOP_Font_Size",address, 0); address += 2;
-    m_set_params_default("GPSHDOP_H_Alignment",address, 0); address += 2;
-
-    m_set_params_default("GPSLatitude_Enable",address, 1); address += 2;
-    m_set_params_default("GPSLatitude_Panel",address, 1); address += 2;
-    m_set_params_default("GPSLatitude_H_Position",address, 200); address += 2;
-    m_set_params_default("GPSLatitude_V_Position",address, 230); address += 2;
-    m_set_params_default("GPSLatitude_Font_Size",address, 0); address += 2;
-    m_set_params_default("GPSLatitude_H_Alignment",address, 0); address += 2;
-
-    m_set_params_default("GPSLongitude_Enable",address, 1); address += 2;
-    m_set_params_default("GPSLongitude_Panel",address, 1); address += 2;
-    m_set_params_default("GPSLongitude_H_Position",address, 280); address += 2;
-    m_set_params_default("GPSLongitude_V_Position",address, 230); address += 2;
-    m_set_params_default("GPSLongitude_Font_Size",address, 0); address += 2;
-    m_set_params_default("GPSLongitude_H_Alignment",address, 0); address += 2;
-
-    m_set_params_default("GPS2Status_Enable",address, 1); address += 2;
-    m_set_params_default("GPS2Status_Panel",address, 2); address += 2;
-    m_set_params_default("GPS2Status_H_Position",address, 0); address += 2;
-    m_set_params_default("GPS2Status_V_Position",address, 230); address += 2;
-    m_set_params_default("GPS2Status_Font_Size",address, 0); address += 2;
-    m_set_params_default("GPS2Status_H_Alignment",address, 0); address += 2;
-
-    m_set_params_default("GPS2HDOP_Enable",address, 1); address += 2;
-    m_set_params_default("GPS2HDOP_Panel",address, 2); address += 2;
-    m_set_params_default("GPS2HDOP_H_Position",address, 70); address += 2;
-    m_set_params_default("GPS2HDOP_V_Position",address, 230); address += 2;
-    m_set_params_default("GPS2HDOP_Font_Size",address, 0); address += 2;
-    m_set_params_default("GPS2HDOP_H_Alignment",address, 0); address += 2;
-
-    m_set_params_default("GPS2Latitude_Enable",address, 1); address += 2;
-    m_set_params_default("GPS2Latitude_Panel",address, 2); address += 2;
-    m_set_params_default("GPS2Latitude_H_Position",address, 200); address += 2;
-    m_set_params_default("GPS2Latitude_V_Position",address, 230); address += 2;
-    m_set_params_default("GPS2Latitude_Font_Size",address, 0); address += 2;
-    m_set_params_default("GPS2Latitude_H_Alignment",address, 0); address += 2;
-
-    m_set_params_default("GPS2Longitude_Enable",address, 1); address += 2;
-    m_set_params_default("GPS2Longitude_Panel",address, 2); address += 2;
-    m_set_params_default("GPS2Longitude_H_Position",address, 280); address += 2;
-    m_set_params_default("GPS2Longitude_V_Position",address, 230); address += 2;
-    m_set_params_default("GPS2Longitude_Font_Size",address, 0); address += 2;
-    m_set_params_default("GPS2Longitude_H_Alignment",address, 0); address += 2;
-
-    m_set_params_default("Time_Enable",address, 1); address += 2;
-    m_set_params_default("Time_Panel",address, 1); address += 2;
-    m_set_params_default("Time_H_Position",address, 350); address += 2;
-    m_set_params_default("Time_V_Position",address, 220); address += 2;
-    m_set_params_default("Time_Font_Size",address, 0); address += 2;
-    m_set_params_default("Time_H_Alignment",address, 2); address += 2;
-
-    m_set_params_default("Altitude_Absolute_Enable",address, 1); address += 2;
-    m_set_params_default("Altitude_Absolute_Panel",address, 2); address += 2;
-    m_set_params_default("Altitude_Absolute_H_Position",address, 5); address += 2;
-    m_set_params_default("Altitude_Absolute_V_Position",address, 10); address += 2;
-    m_set_params_default("Altitude_Absolute_Font_Size",address, 0); address += 2;
-    m_set_params_default("Altitude_Absolute_H_Alignment",address, 0); address += 2;
-    m_set_params_default("Altitude_Scale_Enable",address, 1); address += 2;
-    m_set_params_default("Altitude_Scale_Panel",address, 1); address += 2;
-    m_set_params_default("Altitude_Scale_H_Position",address, 350); address += 2;
-    m_set_params_default("Altitude_Scale_Align",address, 1); address += 2;
-    m_set_params_default("Altitude_Scale_Source",address, 0); address += 2;
-
-    m_set_params_default("Speed_Ground_Enable",address, 1); address += 2;
-    m_set_params_default("Speed_Ground_Panel",address, 2); address += 2;
-    m_set_params_default("Speed_Ground_H_Position",address, 5); address += 2;
-    m_set_params_default("Speed_Ground_V_Position",address, 40); address += 2;
-    m_set_params_default("Speed_Ground_Font_Size",address, 0); address += 2;
-    m_set_params_default("Speed_Ground_H_Alignment",address, 0); address += 2;
-    m_set_params_default("Speed_Scale_Enable",address, 1); address += 2;
-    m_set_params_default("Speed_Scale_Panel",address, 1); address += 2;
-    m_set_params_default("Speed_Scale_H_Position",address, 10); address += 2;
-    m_set_params_default("Speed_Scale_Align",address, 0); address += 2;
-    m_set_params_default("Speed_Scale_Source",address, 0); address += 2;
-
-    m_set_params_default("Throttle_Enable",address, 1); address += 2;
-    m_set_params_default("Throttle_Panel",address, 1); address += 2;
-    m_set_params_default("Throttle_Scale_Enable",address, 1); address += 2;
-    m_set_params_default("Throttle_H_Position",address, 285); address += 2;
-    m_set_params_default("Throttle_V_Position",address, 202); address += 2;
-
-    m_set_params_default("HomeDistance_Enable",address, 1); address += 2;
-    m_set_params_default("HomeDistance_Panel",address, 1); address += 2;
-    m_set_params_default("HomeDistance_H_Position",address, 70); address += 2;
-    m_set_params_default("HomeDistance_V_Position",address, 14); address += 2;
-    m_set_params_default("HomeDistance_Font_Size",address, 0); address += 2;
-    m_set_params_default("HomeDistance_H_Alignment",address, 0); address += 2;
-
-    m_set_params_default("WPDistance_Enable",address, 1); address += 2;
-    m_set_params_default("WPDistance_Panel",address, 1); address += 2;
-    m_set_params_default("WPDistance_H_Position",address, 70); address += 2;
-    m_set_params_default("WPDistance_V_Position",address, 24); address += 2;
-    m_set_params_default("WPDistance_Font_Size",address, 0); address += 2;
-    m_set_params_default("WPDistance_H_Alignment",address, 0); address += 2;
-
-    m_set_params_default("CHWDIR_Tmode_Enable",address, 1); address += 2;
-    m_set_params_default("CHWDIR_Tmode_Panel",address, 2); address += 2;
-    m_set_params_default("CHWDIR_Tmode_V_Position",address, 15); address += 2;
-    m_set_params_default("CHWDIR_Nmode_Enable",address, 1); address += 2;
-    m_set_params_default("CHWDIR_Nmode_Panel",address, 1); address += 2;
-    m_set_params_default("CHWDIR_Nmode_H_Position",address, 30); address += 2;
-    m_set_params_default("CHWDIR_Nmode_V_Position",address, 35); address += 2;
-    m_set_params_default("CHWDIR_Nmode_Radius",address, 20); address += 2;
-    m_set_params_default("CHWDIR_Nmode_Home_Radius",address, 25); address += 2;
-    m_set_params_default("CHWDIR_Nmode_WP_Radius",address, 25); address += 2;
-
-    m_set_params_default("Attitude_MP_Enable",address, 1); address += 2;
-    m_set_params_default("Attitude_MP_Panel",address, 1); address += 2;
-    m_set_params_default("Attitude_MP_Mode",address, 0); address += 2;
-    m_set_params_default("Attitude_3D_Enable",address, 1); address += 2;
-    m_set_params_default("Attitude_3D_Panel",address, 2); address += 2;
-
-    m_set_params_default("Misc_Units_Mode",address, 0); address += 2;
-    m_set_params_default("Misc_Max_Panels",address, 3); address += 2;
-
-    m_set_params_default("PWM_Video_Enable",address, 1); address += 2;
-    m_set_params_default("PWM_Video_Chanel",address, 6); address += 2;
-    m_set_params_default("PWM_Video_Value",address, 1200); address += 2;
-    m_set_params_default("PWM_Panel_Enable",address, 1); address += 2;
-    m_set_params_default("PWM_Panel_Chanel",address, 7); address += 2;
-    m_set_params_default("PWM_Panel_Value",address, 1200); address += 2;
-
-    m_set_params_default("Alarm_H_Position",address, 180); address += 2;
-    m_set_params_default("Alarm_V_Position",address, 25); address += 2;
-    m_set_params_default("Alarm_Font_Size",address, 1); address += 2;
-    m_set_params_default("Alarm_H_Alignment",address, 1); address += 2;
-    m_set_params_default("Alarm_GPS_Status_Enable",address, 1); address += 2;
-    m_set_params_default("Alarm_Low_Batt_Enable",address, 1); address += 2;
-    m_set_params_default("Alarm_Low_Batt",address, 20); address += 2;
-    m_set_params_default("Alarm_Under_Speed_Enable",address, 0); address += 2;
-    m_set_params_default("Alarm_Under_Speed",address, 2); address += 2;
-    m_set_params_default("Alarm_Over_Speed_Enable",address, 0); address += 2;
-    m_set_params_default("Alarm_Over_Speed",address, 100); address += 2;
-    m_set_params_default("Alarm_Under_Alt_Enable",address, 0); address += 2;
-    m_set_params_default("Alarm_Under_Alt",address, 10); address += 2;
-    m_set_params_default("Alarm_Over_Alt_Enable",address, 0); address += 2;
-    m_set_params_default("Alarm_Over_Alt",address, 1000); address += 2;
-
-    m_set_params_default("ClimbRate_Enable",address, 1); address += 2;
-    m_set_params_default("ClimbRate_Panel",address, 1); address += 2;
-    m_set_params_default("ClimbRate_H_Position",address, 5); address += 2;
-    m_set_params_default("ClimbRate_V_Position",address, 220); address += 2;
-    m_set_params_default("ClimbRate_Font_Size",address, 0); address += 2;
-
-    m_set_params_default("RSSI_Enable",address, 0); address += 2;
-    m_set_params_default("RSSI_Panel",address, 1); address += 2;
-    m_set_params_default("RSSI_H_Position",address, 70); address += 2;
-    m_set_params_default("RSSI_V_Position",address, 220); address += 2;
-    m_set_params_default("RSSI_Font_Size",address, 0); address += 2;
-    m_set_params_default("RSSI_H_Alignment",address, 0); address += 2;
-    m_set_params_default("RSSI_Min",address, 0); address += 2;
-    m_set_params_default("RSSI_Max",address, 255); address += 2;
-    m_set_params_default("RSSI_Raw_Enable",address, 0); address += 2;
-
-    m_set_params_default("FC_Type",address, m_protocol_type); address += 2;
-
-    m_set_params_default("Wind_Enable",address, 1); address += 2;
-    m_set_params_default("Wind_Panel",address, 2); address += 2;
-    m_set_params_default("Wind_H_Position",address, 10); address += 2;
-    m_set_params_default("Wind_V_Position",address, 100); address += 2;
-
-    m_set_params_default("Time_Type",address, 0); address += 2;
-
-    m_set_params_default("Throttle_Scale_Type",address, 0); address += 2;
-
-    m_set_params_default("Attitude_MP_H_Position",address, 180); address += 2;
-    m_set_params_default("Attitude_MP_V_Position",address, 133); address += 2;
-    m_set_params_default("Attitude_MP_Scale_Real",address, 1); address += 2;
-    m_set_params_default("Attitude_MP_Scale_Frac",address, 0); address += 2;
-    m_set_params_default("Attitude_3D_H_Position",address, 180); address += 2;
-    m_set_params_default("Attitude_3D_V_Position",address, 133); address += 2;
-    m_set_params_default("Attitude_3D_Scale_Real",address, 1); address += 2;
-    m_set_params_default("Attitude_3D_Scale_Frac",address, 0); address += 2;
-    m_set_params_default("Attitude_3D_Map_radius",address, 40); address += 2;
-
-    m_set_params_default("Misc_Start_Row",address, 0); address += 2;
-    m_set_params_default("Misc_Start_Col",address, 0); address += 2;
-
-    m_set_params_default("Misc_Firmware_ver",address, m_firmware_version); address += 2;
-
-    m_set_params_default("Misc_Video_Mode",address, 1); address += 2;
-
-    m_set_params_default("Speed_Scale_V_Position",address, 133); address += 2;
-    m_set_params_default("Altitude_Scale_V_Position",address, 133); address += 2;
-
-    m_set_params_default("BatteryConsumed_Enable",address, 1); address += 2;
-    m_set_params_default("BatteryConsumed_Panel",address, 1); address += 2;
-    m_set_params_default("BatteryConsumed_H_Position",address, 350); address += 2;
-    m_set_params_default("BatteryConsumed_V_Position",address, 34); address += 2;
-    m_set_params_default("BatteryConsumed_Font_Size",address, 0); address += 2;
-    m_set_params_default("BatteryConsumed_H_Alignment",address, 2); address += 2;
-
-    m_set_params_default("TotalTrip_Enable",address, 1); address += 2;
-    m_set_params_default("TotalTrip_Panel",address, 1); address += 2;
-    m_set_params_default("TotalTrip_H_Position",address, 350); address += 2;
-    m_set_params_default("TotalTrip_V_Position",address, 210); address += 2;
-    m_set_params_default("TotalTrip_Font_Size",address, 0); address += 2;
-    m_set_params_default("TotalTrip_H_Alignment",address, 2); address += 2;
-
-    m_set_params_default("RSSI_Type",address, 0); address += 2;
-
-    m_set_params_default("Map_Enable",address, 1); address += 2;
-    m_set_params_default("Map_Panel",address, 4); address += 2;
-    m_set_params_default("Map_Radius",address, 120); address += 2;
-    m_set_params_default("Map_Font_Size",address, 1); address += 2;
-    m_set_params_default("Map_H_Alignment",address, 0); address += 2;
-    m_set_params_default("Map_V_Alignment",address, 0); address += 2;
-
-    m_set_params_default("Altitude_Relative_Enable",address, 1); address += 2;
-    m_set_params_default("Altitude_Relative_Panel",address, 2); address += 2;
-    m_set_params_default("Altitude_Relative_H_Position",address, 5); address += 2;
-    m_set_params_default("Altitude_Relative_V_Position",address, 25); address += 2;
-    m_set_params_default("Altitude_Relative_Font_Size",address, 0); address += 2;
-    m_set_params_default("Altitude_Relative_H_Alignment",address, 0); address += 2;
+    m_set_params_default(l, "ArmState_Enable",address, 1); address += 2;
+    m_set_params_default(l, "ArmState_Panel",address, 1); address += 2;
+    m_set_params_default(l, "ArmState_H_Position",address, 350); address += 2;
+    m_set_params_default(l, "ArmState_V_Position",address, 44); address += 2;
+    m_set_params_default(l, "ArmState_Font_Size",address, 0); address += 2;
+    m_set_params_default(l, "ArmState_H_Alignment",address, 2); address += 2;
+
+    m_set_params_default(l, "BatteryVoltage_Enable",address, 1); address += 2;
+    m_set_params_default(l, "BatteryVoltage_Panel",address, 1); address += 2;
+    m_set_params_default(l, "BatteryVoltage_H_Position",address, 350); address += 2;
+    m_set_params_default(l, "BatteryVoltage_V_Position",address, 4); address += 2;
+    m_set_params_default(l, "BatteryVoltage_Font_Size",address, 0); address += 2;
+    m_set_params_default(l, "BatteryVoltage_H_Alignment",address, 2); address += 2;
+
+    m_set_params_default(l, "BatteryCurrent_Enable",address, 1); address += 2;
+    m_set_params_default(l, "BatteryCurrent_Panel",address, 1); address += 2;
+    m_set_params_default(l, "BatteryCurrent_H_Position",address, 350); address += 2;
+    m_set_params_default(l, "BatteryCurrent_V_Position",address, 14); address += 2;
+    m_set_params_default(l, "BatteryCurrent_Font_Size",address, 0); address += 2;
+    m_set_params_default(l, "BatteryCurrent_H_Alignment",address, 2); address += 2;
+
+    m_set_params_default(l, "BatteryRemaining_Enable",address, 1); address += 2;
+    m_set_params_default(l, "BatteryRemaining_Panel",address, 1); address += 2;
+    m_set_params_default(l, "BatteryRemaining_H_Position",address, 350); address += 2;
+    m_set_params_default(l, "BatteryRemaining_V_Position",address, 24); address += 2;
+    m_set_params_default(l, "BatteryRemaining_Font_Size",address, 0); address += 2;
+    m_set_params_default(l, "BatteryRemaining_H_Alignment",address, 2); address += 2;
+
+    m_set_params_default(l, "FlightMode_Enable",address, 1); address += 2;
+    m_set_params_default(l, "FlightMode_Panel",address, 1); address += 2;
+    m_set_params_default(l, "FlightMode_H_Position",address, 350); address += 2;
+    m_set_params_default(l, "FlightMode_V_Position",address, 54); address += 2;
+    m_set_params_default(l, "FlightMode_Font_Size",address, 1); address += 2;
+    m_set_params_default(l, "FlightMode_H_Alignment",address, 2); address += 2;
+
+    m_set_params_default(l, "GPSStatus_Enable",address, 1); address += 2;
+    m_set_params_default(l, "GPSStatus_Panel",address, 1); address += 2;
+    m_set_params_default(l, "GPSStatus_H_Position",address, 0); address += 2;
+    m_set_params_default(l, "GPSStatus_V_Position",address, 230); address += 2;
+    m_set_params_default(l, "GPSStatus_Font_Size",address, 0); address += 2;
+    m_set_params_default(l, "GPSStatus_H_Alignment",address, 0); address += 2;
+
+    m_set_params_default(l, "GPSHDOP_Enable",address, 1); address += 2;
+    m_set_params_default(l, "GPSHDOP_Panel",address, 1); address += 2;
+    m_set_params_default(l, "GPSHDOP_H_Position",address, 70); address += 2;
+    m_set_params_default(l, "GPSHDOP_V_Position",address, 230); address += 2;
+    m_set_params_default(l, "GPSHDOP_Font_Size",address, 0); address += 2;
+    m_set_params_default(l, "GPSHDOP_H_Alignment",address, 0); address += 2;
+
+    m_set_params_default(l, "GPSLatitude_Enable",address, 1); address += 2;
+    m_set_params_default(l, "GPSLatitude_Panel",address, 1); address += 2;
+    m_set_params_default(l, "GPSLatitude_H_Position",address, 200); address += 2;
+    m_set_params_default(l, "GPSLatitude_V_Position",address, 230); address += 2;
+    m_set_params_default(l, "GPSLatitude_Font_Size",address, 0); address += 2;
+    m_set_params_default(l, "GPSLatitude_H_Alignment",address, 0); address += 2;
+
+    m_set_params_default(l, "GPSLongitude_Enable",address, 1); address += 2;
+    m_set_params_default(l, "GPSLongitude_Panel",address, 1); address += 2;
+    m_set_params_default(l, "GPSLongitude_H_Position",address, 280); address += 2;
+    m_set_params_default(l, "GPSLongitude_V_Position",address, 230); address += 2;
+    m_set_params_default(l, "GPSLongitude_Font_Size",address, 0); address += 2;
+    m_set_params_default(l, "GPSLongitude_H_Alignment",address, 0); address += 2;
+
+    m_set_params_default(l, "GPS2Status_Enable",address, 1); address += 2;
+    m_set_params_default(l, "GPS2Status_Panel",address, 2); address += 2;
+    m_set_params_default(l, "GPS2Status_H_Position",address, 0); address += 2;
+    m_set_params_default(l, "GPS2Status_V_Position",address, 230); address += 2;
+    m_set_params_default(l, "GPS2Status_Font_Size",address, 0); address += 2;
+    m_set_params_default(l, "GPS2Status_H_Alignment",address, 0); address += 2;
+
+    m_set_params_default(l, "GPS2HDOP_Enable",address, 1); address += 2;
+    m_set_params_default(l, "GPS2HDOP_Panel",address, 2); address += 2;
+    m_set_params_default(l, "GPS2HDOP_H_Position",address, 70); address += 2;
+    m_set_params_default(l, "GPS2HDOP_V_Position",address, 230); address += 2;
+    m_set_params_default(l, "GPS2HDOP_Font_Size",address, 0); address += 2;
+    m_set_params_default(l, "GPS2HDOP_H_Alignment",address, 0); address += 2;
+
+    m_set_params_default(l, "GPS2Latitude_Enable",address, 1); address += 2;
+    m_set_params_default(l, "GPS2Latitude_Panel",address, 2); address += 2;
+    m_set_params_default(l, "GPS2Latitude_H_Position",address, 200); address += 2;
+    m_set_params_default(l, "GPS2Latitude_V_Position",address, 230); address += 2;
+    m_set_params_default(l, "GPS2Latitude_Font_Size",address, 0); address += 2;
+    m_set_params_default(l, "GPS2Latitude_H_Alignment",address, 0); address += 2;
+
+    m_set_params_default(l, "GPS2Longitude_Enable",address, 1); address += 2;
+    m_set_params_default(l, "GPS2Longitude_Panel",address, 2); address += 2;
+    m_set_params_default(l, "GPS2Longitude_H_Position",address, 280); address += 2;
+    m_set_params_default(l, "GPS2Longitude_V_Position",address, 230); address += 2;
+    m_set_params_default(l, "GPS2Longitude_Font_Size",address, 0); address += 2;
+    m_set_params_default(l, "GPS2Longitude_H_Alignment",address, 0); address += 2;
+
+    m_set_params_default(l, "Time_Enable",address, 1); address += 2;
+    m_set_params_default(l, "Time_Panel",address, 1); address += 2;
+    m_set_params_default(l, "Time_H_Position",address, 350); address += 2;
+    m_set_params_default(l, "Time_V_Position",address, 220); address += 2;
+    m_set_params_default(l, "Time_Font_Size",address, 0); address += 2;
+    m_set_params_default(l, "Time_H_Alignment",address, 2); address += 2;
+
+    m_set_params_default(l, "Altitude_Absolute_Enable",address, 1); address += 2;
+    m_set_params_default(l, "Altitude_Absolute_Panel",address, 2); address += 2;
+    m_set_params_default(l, "Altitude_Absolute_H_Position",address, 5); address += 2;
+    m_set_params_default(l, "Altitude_Absolute_V_Position",address, 10); address += 2;
+    m_set_params_default(l, "Altitude_Absolute_Font_Size",address, 0); address += 2;
+    m_set_params_default(l, "Altitude_Absolute_H_Alignment",address, 0); address += 2;
+    m_set_params_default(l, "Altitude_Scale_Enable",address, 1); address += 2;
+    m_set_params_default(l, "Altitude_Scale_Panel",address, 1); address += 2;
+    m_set_params_default(l, "Altitude_Scale_H_Position",address, 350); address += 2;
+    m_set_params_default(l, "Altitude_Scale_Align",address, 1); address += 2;
+    m_set_params_default(l, "Altitude_Scale_Source",address, 0); address += 2;
+
+    m_set_params_default(l, "Speed_Ground_Enable",address, 1); address += 2;
+    m_set_params_default(l, "Speed_Ground_Panel",address, 2); address += 2;
+    m_set_params_default(l, "Speed_Ground_H_Position",address, 5); address += 2;
+    m_set_params_default(l, "Speed_Ground_V_Position",address, 40); address += 2;
+    m_set_params_default(l, "Speed_Ground_Font_Size",address, 0); address += 2;
+    m_set_params_default(l, "Speed_Ground_H_Alignment",address, 0); address += 2;
+    m_set_params_default(l, "Speed_Scale_Enable",address, 1); address += 2;
+    m_set_params_default(l, "Speed_Scale_Panel",address, 1); address += 2;
+    m_set_params_default(l, "Speed_Scale_H_Position",address, 10); address += 2;
+    m_set_params_default(l, "Speed_Scale_Align",address, 0); address += 2;
+    m_set_params_default(l, "Speed_Scale_Source",address, 0); address += 2;
+
+    m_set_params_default(l, "Throttle_Enable",address, 1); address += 2;
+    m_set_params_default(l, "Throttle_Panel",address, 1); address += 2;
+    m_set_params_default(l, "Throttle_Scale_Enable",address, 1); address += 2;
+    m_set_params_default(l, "Throttle_H_Position",address, 285); address += 2;
+    m_set_params_default(l, "Throttle_V_Position",address, 202); address += 2;
+
+    m_set_params_default(l, "HomeDistance_Enable",address, 1); address += 2;
+    m_set_params_default(l, "HomeDistance_Panel",address, 1); address += 2;
+    m_set_params_default(l, "HomeDistance_H_Position",address, 70); address += 2;
+    m_set_params_default(l, "HomeDistance_V_Position",address, 14); address += 2;
+    m_set_params_default(l, "HomeDistance_Font_Size",address, 0); address += 2;
+    m_set_params_default(l, "HomeDistance_H_Alignment",address, 0); address += 2;
+
+    m_set_params_default(l, "WPDistance_Enable",address, 1); address += 2;
+    m_set_params_default(l, "WPDistance_Panel",address, 1); address += 2;
+    m_set_params_default(l, "WPDistance_H_Position",address, 70); address += 2;
+    m_set_params_default(l, "WPDistance_V_Position",address, 24); address += 2;
+    m_set_params_default(l, "WPDistance_Font_Size",address, 0); address += 2;
+    m_set_params_default(l, "WPDistance_H_Alignment",address, 0); address += 2;
+
+    m_set_params_default(l, "CHWDIR_Tmode_Enable",address, 1); address += 2;
+    m_set_params_default(l, "CHWDIR_Tmode_Panel",address, 2); address += 2;
+    m_set_params_default(l, "CHWDIR_Tmode_V_Position",address, 15); address += 2;
+    m_set_params_default(l, "CHWDIR_Nmode_Enable",address, 1); address += 2;
+    m_set_params_default(l, "CHWDIR_Nmode_Panel",address, 1); address += 2;
+    m_set_params_default(l, "CHWDIR_Nmode_H_Position",address, 30); address += 2;
+    m_set_params_default(l, "CHWDIR_Nmode_V_Position",address, 35); address += 2;
+    m_set_params_default(l, "CHWDIR_Nmode_Radius",address, 20); address += 2;
+    m_set_params_default(l, "CHWDIR_Nmode_Home_Radius",address, 25); address += 2;
+    m_set_params_default(l, "CHWDIR_Nmode_WP_Radius",address, 25); address += 2;
+
+    m_set_params_default(l, "Attitude_MP_Enable",address, 1); address += 2;
+    m_set_params_default(l, "Attitude_MP_Panel",address, 1); address += 2;
+    m_set_params_default(l, "Attitude_MP_Mode",address, 0); address += 2;
+    m_set_params_default(l, "Attitude_3D_Enable",address, 1); address += 2;
+    m_set_params_default(l, "Attitude_3D_Panel",address, 2); address += 2;
+
+    m_set_params_default(l, "Misc_Units_Mode",address, 0); address += 2;
+    m_set_params_default(l, "Misc_Max_Panels",address, 3); address += 2;
+
+    m_set_params_default(l, "PWM_Video_Enable",address, 1); address += 2;
+    m_set_params_default(l, "PWM_Video_Chanel",address, 6); address += 2;
+    m_set_params_default(l, "PWM_Video_Value",address, 1200); address += 2;
+    m_set_params_default(l, "PWM_Panel_Enable",address, 1); address += 2;
+    m_set_params_default(l, "PWM_Panel_Chanel",address, 7); address += 2;
+    m_set_params_default(l, "PWM_Panel_Value",address, 1200); address += 2;
+
+    m_set_params_default(l, "Alarm_H_Position",address, 180); address += 2;
+    m_set_params_default(l, "Alarm_V_Position",address, 25); address += 2;
+    m_set_params_default(l, "Alarm_Font_Size",address, 1); address += 2;
+    m_set_params_default(l, "Alarm_H_Alignment",address, 1); address += 2;
+    m_set_params_default(l, "Alarm_GPS_Status_Enable",address, 1); address += 2;
+    m_set_params_default(l, "Alarm_Low_Batt_Enable",address, 1); address += 2;
+    m_set_params_default(l, "Alarm_Low_Batt",address, 20); address += 2;
+    m_set_params_default(l, "Alarm_Under_Speed_Enable",address, 0); address += 2;
+    m_set_params_default(l, "Alarm_Under_Speed",address, 2); address += 2;
+    m_set_params_default(l, "Alarm_Over_Speed_Enable",address, 0); address += 2;
+    m_set_params_default(l, "Alarm_Over_Speed",address, 100); address += 2;
+    m_set_params_default(l, "Alarm_Under_Alt_Enable",address, 0); address += 2;
+    m_set_params_default(l, "Alarm_Under_Alt",address, 10); address += 2;
+    m_set_params_default(l, "Alarm_Over_Alt_Enable",address, 0); address += 2;
+    m_set_params_default(l, "Alarm_Over_Alt",address, 1000); address += 2;
+
+    m_set_params_default(l, "ClimbRate_Enable",address, 1); address += 2;
+    m_set_params_default(l, "ClimbRate_Panel",address, 1); address += 2;
+    m_set_params_default(l, "ClimbRate_H_Position",address, 5); address += 2;
+    m_set_params_default(l, "ClimbRate_V_Position",address, 220); address += 2;
+    m_set_params_default(l, "ClimbRate_Font_Size",address, 0); address += 2;
+
+    m_set_params_default(l, "RSSI_Enable",address, 0); address += 2;
+    m_set_params_default(l, "RSSI_Panel",address, 1); address += 2;
+    m_set_params_default(l, "RSSI_H_Position",address, 70); address += 2;
+    m_set_params_default(l, "RSSI_V_Position",address, 220); address += 2;
+    m_set_params_default(l, "RSSI_Font_Size",address, 0); address += 2;
+    m_set_params_default(l, "RSSI_H_Alignment",address, 0); address += 2;
+    m_set_params_default(l, "RSSI_Min",address, 0); address += 2;
+    m_set_params_default(l, "RSSI_Max",address, 255); address += 2;
+    m_set_params_default(l, "RSSI_Raw_Enable",address, 0); address += 2;
+
+    m_set_params_default(l, "FC_Type",address, m_protocol_type); address += 2;
+
+    m_set_params_default(l, "Wind_Enable",address, 1); address += 2;
+    m_set_params_default(l, "Wind_Panel",address, 2); address += 2;
+    m_set_params_default(l, "Wind_H_Position",address, 10); address += 2;
+    m_set_params_default(l, "Wind_V_Position",address, 100); address += 2;
+
+    m_set_params_default(l, "Time_Type",address, 0); address += 2;
+
+    m_set_params_default(l, "Throttle_Scale_Type",address, 0); address += 2;
+
+    m_set_params_default(l, "Attitude_MP_H_Position",address, 180); address += 2;
+    m_set_params_default(l, "Attitude_MP_V_Position",address, 133); address += 2;
+    m_set_params_default(l, "Attitude_MP_Scale_Real",address, 1); address += 2;
+    m_set_params_default(l, "Attitude_MP_Scale_Frac",address, 0); address += 2;
+    m_set_params_default(l, "Attitude_3D_H_Position",address, 180); address += 2;
+    m_set_params_default(l, "Attitude_3D_V_Position",address, 133); address += 2;
+    m_set_params_default(l, "Attitude_3D_Scale_Real",address, 1); address += 2;
+    m_set_params_default(l, "Attitude_3D_Scale_Frac",address, 0); address += 2;
+    m_set_params_default(l, "Attitude_3D_Map_radius",address, 40); address += 2;
+
+    m_set_params_default(l, "Misc_Start_Row",address, 0); address += 2;
+    m_set_params_default(l, "Misc_Start_Col",address, 0); address += 2;
+
+    m_set_params_default(l, "Misc_Firmware_ver",address, m_firmware_version); address += 2;
+
+    m_set_params_default(l, "Misc_Video_Mode",address, 1); address += 2;
+
+    m_set_params_default(l, "Speed_Scale_V_Position",address, 133); address += 2;
+    m_set_params_default(l, "Altitude_Scale_V_Position",address, 133); address += 2;
+
+    m_set_params_default(l, "BatteryConsumed_Enable",address, 1); address += 2;
+    m_set_params_default(l, "BatteryConsumed_Panel",address, 1); address += 2;
+    m_set_params_default(l, "BatteryConsumed_H_Position",address, 350); address += 2;
+    m_set_params_default(l, "BatteryConsumed_V_Position",address, 34); address += 2;
+    m_set_params_default(l, "BatteryConsumed_Font_Size",address, 0); address += 2;
+    m_set_params_default(l, "BatteryConsumed_H_Alignment",address, 2); address += 2;
+
+    m_set_params_default(l, "TotalTrip_Enable",address, 1); address += 2;
+    m_set_params_default(l, "TotalTrip_Panel",address, 1); address += 2;
+    m_set_params_default(l, "TotalTrip_H_Position",address, 350); address += 2;
+    m_set_params_default(l, "TotalTrip_V_Position",address, 210); address += 2;
+    m_set_params_default(l, "TotalTrip_Font_Size",address, 0); address += 2;
+    m_set_params_default(l, "TotalTrip_H_Alignment",address, 2); address += 2;
+
+    m_set_params_default(l, "RSSI_Type",address, 0); address += 2;
+
+    m_set_params_default(l, "Map_Enable",address, 1); address += 2;
+    m_set_params_default(l, "Map_Panel",address, 4); address += 2;
+    m_set_params_default(l, "Map_Radius",address, 120); address += 2;
+    m_set_params_default(l, "Map_Font_Size",address, 1); address += 2;
+    m_set_params_default(l, "Map_H_Alignment",address, 0); address += 2;
+    m_set_params_default(l, "Map_V_Alignment",address, 0); address += 2;
+
+    m_set_params_default(l, "Altitude_Relative_Enable",address, 1); address += 2;
+    m_set_params_default(l, "Altitude_Relative_Panel",address, 2); address += 2;
+    m_set_params_default(l, "Altitude_Relative_H_Position",address, 5); address += 2;
+    m_set_params_default(l, "Altitude_Relative_V_Position",address, 25); address += 2;
+    m_set_params_default(l, "Altitude_Relative_Font_Size",address, 0); address += 2;
+    m_set_params_default(l, "Altitude_Relative_H_Alignment",address, 0); address += 2;
 
     //0:absolute altitude 1:relative altitude
-    m_set_params_default("Altitude_Scale_Type",address, 1); address += 2;
+    m_set_params_default(l, "Altitude_Scale_Type",address, 1); address += 2;
 
-    m_set_params_default("Speed_Air_Enable",address, 1); address += 2;
-    m_set_params_default("Speed_Air_Panel",address, 2); address += 2;
-    m_set_params_default("Speed_Air_H_Position",address, 5); address += 2;
-    m_set_params_default("Speed_Air_V_Position",address, 55); address += 2;
-    m_set_params_default("Speed_Air_Font_Size",address, 0); address += 2;
-    m_set_params_default("Speed_Air_H_Alignment",address, 0); address += 2;
+    m_set_params_default(l, "Speed_Air_Enable",address, 1); address += 2;
+    m_set_params_default(l, "Speed_Air_Panel",address, 2); address += 2;
+    m_set_params_default(l, "Speed_Air_H_Position",address, 5); address += 2;
+    m_set_params_default(l, "Speed_Air_V_Position",address, 55); address += 2;
+    m_set_params_default(l, "Speed_Air_Font_Size",address, 0); address += 2;
+    m_set_params_default(l, "Speed_Air_H_Alignment",address, 0); address += 2;
 
     //0:ground speed 1:air speed
-    m_set_params_default("Speed_Scale_Type",address, 0); address += 2;
+    m_set_params_default(l, "Speed_Scale_Type",address, 0); address += 2;
 
     // sign of start col. 1:positive 0:negative
-    m_set_params_default("Misc_Start_Col_Sign",address, 1); address += 2;
+    m_set_params_default(l, "Misc_Start_Col_Sign",address, 1); address += 2;
 
     //1:4800、2:9600、3:19200、4:38400、5:43000、6:56000、7:57600、8:115200
-    m_set_params_default("Misc_USART_BandRate",address, 7); address += 2;
+    m_set_params_default(l, "Misc_USART_BandRate",address, 7); address += 2;
 }
@@ -21,35 +21,90 @@ Authors:
 */
 
 #include<string>
-#include <map>
+#include <vector>
+#include <istream>
+#include <cstdint>
 
 #define PARAMS_BUF_SIZE 1024
 
-typedef std::map<std::string, int32_t> ParamsAddrMap;
-
 class COSDParam{
 public:
+    // how a parameter is written as text. The sign and fraction words go with
+    // Misc_Start_Col and the scale they belong to
+    enum class param_kind { plain, panel, scale, start_row, start_col};
+
+    // a parameter name and its address in the buffer
+    struct param_entry{
+        char const * name;
+        int32_t address;
+    };
+
+    // the parameter table, in name order
+    class param_range{
+    public:
+        param_range(param_entry const * begin, param_entry const * end) : m_begin{begin}, m_end{end}{}
+        param_entry const * begin() const { return m_begin;}
+        param_entry const * end() const { return m_end;}
+        size_t size() const { return static_cast<size_t>(m_end - m_begin);}
+    private:
+        param_entry const * m_begin;
+        param_entry const * m_end;
+    };
+
     COSDParam();
     ~COSDParam();
 
     bool load_params_from_file(const std::string & filename, uint8_t * buf_in);
     bool store_params_to_file(const std::string & filename, uint8_t * buf_in);
+    // same as the file versions, with the .posd text in memory
+    bool load_params_from_string(const std::string & text, uint8_t * buf_in);
+    std::string params_to_string(uint8_t * buf_in);
 
     void get_default_params(uint8_t * buf_in);
+    // bytes at the start of the buffer that hold parameters. The rest of the
+    // PARAMS_BUF_SIZE buffer is unused
+    int32_t layout_size() const { return m_layout_size;}
+    // the firmware version the image was made for ( Misc_Firmware_ver)
+    uint16_t get_firmware_version(uint8_t const * buf_in) const;
+    // parameter names and their addresses in the buffer.
+    // The table is built once and shared by every COSDParam
+    static param_range params();
+    // address of the parameter in the buffer, or -1 if there is none by that name
+    static int32_t address_of(char const * paramname);
+    // names of the parameters that differ between two buffers
+    std::vector<std::string> changed_params(uint8_t const * from, uint8_t const * to) const;
+    // as changed_params, less those the board sets itself ( Misc_Firmware_ver)
+    // so differences there dont mean the sent value wasnt stored
+    std::vector<std::string> params_not_stored(uint8_t const * sent, uint8_t const * board) const;
+    // one parameter from its .posd text form, e.g Attitude_MP_Scale=1.5 or ArmState_Panel=1,2
+    void set_param(uint8_t * buf_in, const std::string & paramname, const std::string & paramvalue);
+    // buffer addresses of the words set_param writes for the name, empty if it isnt one
+    std::vector<int32_t> param_addresses(const std::string & paramname) const;
+    // whether the value would be stored and read back as written.
+    // False for unknown names and those that cant be set
+    bool check_param(const std::string & paramname, const std::string & paramvalue) const;
+    // by name, either as in the buffer or as in the text
+    static param_kind kind_of(const std::string & paramname);
+    static param_kind kind_of(char const * paramname);
+    // whether the buffer word comes back from the .posd text, on its own or with another parameter
+    static bool in_text(const std::string & paramname);
     void dump_params(uint8_t * buf);
 
 private:
-    void m_init_params();
-    void m_set_params_default(const std::string & paramname, int32_t addr, uint16_t initval);
-    void m_u16_to_buf(uint8_t * buf, int32_t addr, uint16_t val);
-    void m_str_to_buf(uint8_t * buf, const std::string & paramname, const std::string & paramvalue);
+    // names, addresses and defaults, the same for every COSDParam
+    struct layout;
+    static layout const & m_layout();
+    static void m_init_params(layout & l);
+    static void m_set_params_default(layout & l, char const * paramname, int32_t addr, uint16_t initval);
+    static void m_u16_to_buf(uint8_t * buf, int32_t addr, uint16_t val);
+    bool m_load_params(std::istream & in, uint8_t * buf_in);
+    // the .posd name and value, parsed where they are
+    void m_str_to_buf(uint8_t * buf, char const * paramname, char const * paramvalue);
     uint16_t m_get_u16_param(uint8_t * buf, int32_t addr);
     std::string m_param_serialize(uint8_t * buf, int32_t addr, const std::string & paramname);
-    uint16_t m_panel_str_to_u16(const std::string paramvalue);
-
+    uint16_t m_panel_str_to_u16(char const * paramvalue);
 
-    ParamsAddrMap m_params_addr;
-    uint8_t m_default_params[PARAMS_BUF_SIZE];
-    const uint16_t m_firmware_version;
-    const uint16_t m_protocol_type;
+    static constexpr uint16_t m_firmware_version = 10;
+    static constexpr uint16_t m_protocol_type = 0;
+    int32_t m_layout_size;
 };
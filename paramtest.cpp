@@ -0,0 +1,155 @@
+/*
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+ 
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program. If not, see <http://www.gnu.org/licenses/>
+
+Authors:
+   Andy Little
+   Tom Ren
+*/
+
+
+#include "paramtest.h"
+#include "parallel.h"
+
+#include <cstring>
+#include <chrono>
+#include <atomic>
+#include <algorithm>
+#include <stdexcept>
+
+namespace {
+    // splitmix64, cheap to seed per image
+    uint64_t next_random(uint64_t & state)
+    {
+        uint64_t z = (state += 0x9e3779b97f4a7c15ULL);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        return z ^ (z >> 31);
+    }
+
+    uint16_t get_u16(uint8_t const * buf, int32_t address)
+    {
+        return static_cast<uint16_t>(buf[address] + (buf[address + 1] << 8));
+    }
+
+    void set_u16(uint8_t * buf, int32_t address, uint16_t value)
+    {
+        buf[address] = static_cast<uint8_t>(value & 0xFF);
+        buf[address + 1] = static_cast<uint8_t>((value >> 8) & 0xFF);
+    }
+}
+
+constexpr size_t CParamSelfTest::failures_kept;
+constexpr uint64_t CParamSelfTest::images_per_block;
+
+CParamSelfTest::CParamSelfTest(uint64_t seed)
+: m_seed{seed}, m_start_col{-1}, m_start_col_sign{-1}, m_images{0}, m_params_checked{0}
+ ,m_num_failures{0}, m_known_exceptions{0}, m_seconds{0}, m_threads{0}
+{
+    for ( auto const & param : COSDParam::params()){
+        m_words.push_back({param.name,param.address,COSDParam::kind_of(param.name),COSDParam::in_text(param.name)});
+    }
+    m_start_col = COSDParam::address_of("Misc_Start_Col");
+    m_start_col_sign = COSDParam::address_of("Misc_Start_Col_Sign");
+    if ( (m_start_col < 0) || (m_start_col_sign < 0)){
+        throw std::runtime_error("param selftest : no Misc_Start_Col in the layout");
+    }
+}
+
+void CParamSelfTest::make_image(uint64_t index, uint8_t * buf) const
+{
+    uint64_t state = m_seed ^ (index * 0xd1b54a32d192ed03ULL);
+    memset(buf,0,PARAMS_BUF_SIZE);
+    for ( auto const & w : m_words){
+        uint16_t const r = static_cast<uint16_t>(next_random(state));
+        // panels are a bit each for panels 1 to 9
+        set_u16(buf,w.address,(w.kind == COSDParam::param_kind::panel) ? (r & 0x1FF) : r);
+    }
+    // 0 often enough for -0, and a sign of 0 ( negative), 1 or any other word
+    uint64_t const r = next_random(state);
+    if ( (r & 7) == 0){
+        set_u16(buf,m_start_col,0);
+    }
+    uint16_t sign = 0;
+    switch ((r >> 3) & 7){
+        case 0: case 1: case 2:
+            sign = 0;
+            break;
+        case 3: case 4: case 5:
+            sign = 1;
+            break;
+        default:
+            sign = static_cast<uint16_t>(r >> 16);
+            break;
+    }
+    set_u16(buf,m_start_col_sign,sign);
+}
+
+bool CParamSelfTest::run(uint64_t count, size_t threads)
+{
+    m_threads = (threads > 0) ? threads : std::max(1U,std::thread::hardware_concurrency());
+    m_images = count;
+    m_params_checked = 0;
+    m_num_failures = 0;
+    m_known_exceptions = 0;
+    m_failures.clear();
+    std::atomic<uint64_t> params_checked{0};
+    uint64_t const blocks = (count + images_per_block - 1) / images_per_block;
+    auto const start = std::chrono::steady_clock::now();
+    parallel_for(blocks,m_threads,[&](size_t block){
+        uint64_t const begin = block * images_per_block;
+        params_checked += m_check_block(begin,std::min(count,begin + images_per_block));
+    },1);
+    m_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    m_params_checked = params_checked;
+    std::sort(m_failures.begin(),m_failures.end(),
+        [](failure const & lhs, failure const & rhs){ return lhs.image < rhs.image;});
+    return m_num_failures == 0;
+}
+
+// returns the words compared
+uint64_t CParamSelfTest::m_check_block(uint64_t begin, uint64_t end)
+{
+    COSDParam codec;
+    uint8_t sent[PARAMS_BUF_SIZE];
+    uint8_t got[PARAMS_BUF_SIZE];
+    uint64_t checked = 0;
+    for ( uint64_t image = begin; image < end; ++image){
+        make_image(image,sent);
+        std::string const text = codec.params_to_string(sent);
+        // so a word missing from the text can never match
+        for ( size_t i = 0; i < PARAMS_BUF_SIZE; ++i){
+            got[i] = ~sent[i];
+        }
+        bool const loaded = codec.load_params_from_string(text,got);
+        for ( auto const & w : m_words){
+            if ( !w.in_text){
+                continue;
+            }
+            ++checked;
+            uint16_t const sent_word = get_u16(sent,w.address);
+            if ( loaded && (w.address == m_start_col_sign) && (sent_word > 1) && (get_u16(got,w.address) == 1)){
+                ++m_known_exceptions;
+                continue;
+            }
+            if ( !loaded || (sent_word != get_u16(got,w.address))){
+                std::lock_guard<std::mutex> lock{m_mutex};
+                ++m_num_failures;
+                if ( m_failures.size() < failures_kept){
+                    m_failures.push_back({image,w.name,get_u16(sent,w.address),get_u16(got,w.address)});
+                }
+            }
+        }
+    }
+    return checked;
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+/*
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+ 
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program. If not, see <http://www.gnu.org/licenses/>
+
+Authors:
+   Andy Little
+   Tom Ren
+  
+*/
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <atomic>
+
+#include "params.h"
+
+/*
+  round trip test of the .posd text codec. Random parameter images, with each panel word a value
+  the text can express ( panels 1 to 9), go buffer -> text -> buffer and every word that comes back
+  from the text is compared. An image is made from its index and the seed, so a failure can be
+  made again on its own.
+  Misc_Start_Col is often 0, to try -0, and its sign word is 0, 1 or anything. The text only holds
+  a '-', so a sign word other than 0 or 1 comes back as 1. That is counted as a known exception
+  rather than a failure
+*/
+class CParamSelfTest{
+public:
+    struct failure{
+        uint64_t image;
+        std::string param;
+        uint16_t sent;
+        uint16_t got;
+    };
+
+    explicit CParamSelfTest(uint64_t seed);
+
+    // count images over threads ( 0 for one per core). true if they all came back
+    bool run(uint64_t count, size_t threads = 0);
+    void make_image(uint64_t index, uint8_t * buf) const;
+
+    uint64_t seed() const { return m_seed;}
+    uint64_t images() const { return m_images;}
+    // words compared
+    uint64_t params_checked() const { return m_params_checked;}
+    uint64_t num_failures() const { return m_num_failures;}
+    // sign words other than 0 or 1 that came back as 1
+    uint64_t known_exceptions() const { return m_known_exceptions;}
+    // up to failures_kept of them, in image order
+    std::vector<failure> const & failures() const { return m_failures;}
+    double seconds() const { return m_seconds;}
+    size_t threads() const { return m_threads;}
+
+    static constexpr size_t failures_kept = 10;
+    // images a thread takes at a time, each thread having its own codec
+    static constexpr uint64_t images_per_block = 4096;
+
+private:
+    struct word{
+        std::string name;
+        int32_t address;
+        COSDParam::param_kind kind;
+        bool in_text;
+    };
+    uint64_t m_check_block(uint64_t begin, uint64_t end);
+
+    uint64_t const m_seed;
+    std::vector<word> m_words;
+    int32_t m_start_col;
+    int32_t m_start_col_sign;
+    uint64_t m_images;
+    uint64_t m_params_checked;
+    uint64_t m_num_failures;
+    std::atomic<uint64_t> m_known_exceptions;
+    std::vector<failure> m_failures;
+    double m_seconds;
+    size_t m_threads;
+    std::mutex m_mutex;
+};
@@ -0,0 +1,105 @@
+#ifndef PLAYUAVOSD_H_INCLUDED
+#define PLAYUAVOSD_H_INCLUDED
+
+/*
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+ 
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program. If not, see <http://www.gnu.org/licenses/>
+
+Authors:
+   Andy Little
+   Tom Ren
+  
+*/
+
+/*
+  C interface to libplayuavosd, for GUI front ends and other languages.
+
+  A handle is one board connection with its own worker thread. Jobs are queued
+  on the handle and run one at a time in order. Each job's completion callback
+  is called on the worker thread, so a GUI should hand the result over to its
+  own main loop. Parameter images are POSD_PARAMS_SIZE bytes.
+  The async calls never wait. Up to POSD_MAX_QUEUED jobs can be waiting on a
+  handle, after that they return POSD_BUSY and the job isnt queued.
+  A callback may queue more jobs, but must not call posd_close on its own handle.
+  Nothing is printed. Status goes to the status callback, if one is given.
+*/
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(__GNUC__)
+#define POSD_API __attribute__((visibility("default")))
+#else
+#define POSD_API
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define POSD_API_VERSION 2
+#define POSD_PARAMS_SIZE 1024
+#define POSD_MAX_QUEUED  16
+
+/* status codes */
+#define POSD_OK          0
+#define POSD_ERROR      -1   /* job failed, see message */
+#define POSD_BAD_ARG    -2
+#define POSD_CLOSED     -3   /* handle is closing, job not run */
+#define POSD_BUSY       -4   /* POSD_MAX_QUEUED jobs already waiting, job not queued */
+#define POSD_IN_CALLBACK -5  /* posd_close called from a callback of the handle, nothing done */
+
+typedef struct posd_handle posd_handle;
+
+/* status is one of the codes above, message is only valid during the call */
+typedef void (*posd_callback)(posd_handle * handle, int status, const char * message, void * user);
+/* one json line of status, as playuavosd-util -json prints, without the newline e.g
+   {"board":"/dev/ttyACM0","event":"message","text":"OK! ... board erased"}
+   also "phase", "progress" and "dropped" events. Called on a thread of the library,
+   line is only valid during the call */
+typedef void (*posd_status_callback)(const char * line, void * user);
+
+POSD_API int posd_api_version(void);
+
+/* port is e.g "/dev/ttyACM0", or NULL to search for the board.
+   Returns NULL if the board couldnt be connected */
+POSD_API posd_handle * posd_open(const char * port);
+/* as posd_open, with the connection status passed to status. Since api version 2 */
+POSD_API posd_handle * posd_open_with_status(const char * port, posd_status_callback status, void * user);
+/* waits for queued jobs to finish, then disconnects and frees the handle.
+   Returns POSD_IN_CALLBACK, leaving the handle open, if called on the handle's worker thread */
+POSD_API int posd_close(posd_handle * handle);
+
+/* filename is a .bin or lz4 compressed image */
+POSD_API int posd_upload_firmware_async(posd_handle * handle, const char * filename,
+        posd_callback callback, void * user);
+/* params is copied before returning */
+POSD_API int posd_upload_params_async(posd_handle * handle, const uint8_t * params, size_t len,
+        posd_callback callback, void * user);
+/* params must stay valid until the callback */
+POSD_API int posd_get_params_async(posd_handle * handle, uint8_t * params, size_t len,
+        posd_callback callback, void * user);
+
+/* parameter image helpers, no board needed */
+POSD_API int posd_params_default(uint8_t * params, size_t len);
+/* text in .posd format is applied on top of what is in params */
+POSD_API int posd_params_from_text(const char * text, uint8_t * params, size_t len);
+/* writes .posd text to buf. Returns length needed, not counting the terminator
+   so call with buf NULL to size the buffer. Negative on error */
+POSD_API int posd_params_to_text(const uint8_t * params, size_t len, char * buf, size_t buf_len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PLAYUAVOSD_H_INCLUDED */
@@ -0,0 +1,172 @@
+/*
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+ 
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program. If not, see <http://www.gnu.org/licenses/>
+
+Authors:
+   Andy Little
+   Tom Ren
+*/
+
+
+#include "profile.h"
+#include "parallel.h"
+
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <atomic>
+#include <algorithm>
+#include <cstring>
+#include <cerrno>
+#include <sys/stat.h>
+
+constexpr size_t CProfileGenerator::max_profiles;
+
+CProfileGenerator::CProfileGenerator(std::string const & base_filename, std::string const & matrix_filename)
+: m_num_profiles{1}
+{
+    // parameters not in the base keep their defaults, as in upload_params
+    m_codec.get_default_params(m_base);
+    if ( !base_filename.empty() && !m_codec.load_params_from_file(base_filename,m_base)){
+        throw std::runtime_error("failed to load base profile " + base_filename);
+    }
+    std::ifstream in{matrix_filename};
+    if ( !in){
+        throw std::runtime_error("failed to open profile matrix " + matrix_filename);
+    }
+    std::vector<int32_t> used;
+    std::string line;
+    for ( int32_t line_number = 1; std::getline(in,line); ++line_number){
+        if ( line.empty() || (line[0] == '#')){
+            continue;
+        }
+        try{
+            m_add_axis(line,used);
+        }catch (std::exception & e){
+            throw std::runtime_error(matrix_filename + ":" + std::to_string(line_number) + " : " + e.what());
+        }
+    }
+}
+
+void CProfileGenerator::m_add_axis(std::string const & line, std::vector<int32_t> & used)
+{
+    size_t const eq = line.find('=');
+    if ( eq == std::string::npos){
+        throw std::runtime_error("expected name=value|value...");
+    }
+    axis a;
+    a.name = line.substr(0,eq);
+    std::vector<int32_t> const addresses = m_codec.param_addresses(a.name);
+    for ( int32_t address : addresses){
+        if ( std::find(used.begin(),used.end(),address) != used.end()){
+            throw std::runtime_error(a.name + " overlaps a parameter already in the matrix");
+        }
+        used.push_back(address);
+    }
+    std::istringstream values{line.substr(eq + 1)};
+    std::string value;
+    while ( std::getline(values,value,'|')){
+        if ( !m_codec.check_param(a.name,value)){
+            throw std::runtime_error("bad value " + a.name + "=" + value);
+        }
+        // encoded onto a copy of the base, then the words it wrote kept
+        uint8_t buf[PARAMS_BUF_SIZE];
+        memcpy(buf,m_base,PARAMS_BUF_SIZE);
+        m_codec.set_param(buf,a.name,value);
+        std::vector<std::pair<int32_t,uint16_t> > words;
+        for ( int32_t address : addresses){
+            words.push_back({address,static_cast<uint16_t>(buf[address] + (buf[address + 1] << 8))});
+        }
+        a.values.push_back(value);
+        a.words.push_back(words);
+    }
+    if ( a.values.empty()){
+        throw std::runtime_error("no values for " + a.name);
+    }
+    if ( m_num_profiles * a.values.size() > max_profiles){
+        throw std::runtime_error("more than " + std::to_string(max_profiles) + " profiles");
+    }
+    m_num_profiles *= a.values.size();
+    m_axes.push_back(a);
+}
+
+std::vector<size_t> CProfileGenerator::m_choices(size_t i) const
+{
+    std::vector<size_t> result(m_axes.size());
+    for ( size_t k = m_axes.size(); k-- > 0;){
+        result[k] = i % m_axes[k].values.size();
+        i /= m_axes[k].values.size();
+    }
+    return result;
+}
+
+void CProfileGenerator::build(size_t threads)
+{
+    m_images.resize(m_num_profiles * PARAMS_BUF_SIZE);
+    parallel_for(m_num_profiles,threads,[this](size_t i){
+        uint8_t * const buf = m_images.data() + i * PARAMS_BUF_SIZE;
+        memcpy(buf,m_base,PARAMS_BUF_SIZE);
+        std::vector<size_t> const choices = m_choices(i);
+        for ( size_t k = 0; k < m_axes.size(); ++k){
+            for ( auto const & word : m_axes[k].words[choices[k]]){
+                buf[word.first] = static_cast<uint8_t>(word.second & 0xFF);
+                buf[word.first + 1] = static_cast<uint8_t>((word.second >> 8) & 0xFF);
+            }
+        }
+    });
+}
+
+std::string CProfileGenerator::overrides(size_t i) const
+{
+    std::string result;
+    std::vector<size_t> const choices = m_choices(i);
+    for ( size_t k = 0; k < m_axes.size(); ++k){
+        result += (result.empty() ? "" : " ") + m_axes[k].name + "=" + m_axes[k].values[choices[k]];
+    }
+    return result;
+}
+
+std::string CProfileGenerator::m_filename(size_t i) const
+{
+    std::string number = std::to_string(i);
+    size_t const width = std::to_string(m_num_profiles - 1).length();
+    return "profile_" + std::string(width - number.length(),'0') + number + ".bin";
+}
+
+void CProfileGenerator::save(std::string const & dirname, size_t threads) const
+{
+    if ( m_images.size() != m_num_profiles * PARAMS_BUF_SIZE){
+        throw std::runtime_error("profiles not built");
+    }
+    if ( (mkdir(dirname.c_str(),0755) != 0) && (errno != EEXIST)){
+        throw std::runtime_error("failed to make directory " + dirname + " : " + strerror(errno));
+    }
+    std::atomic<bool> failed{false};
+    parallel_for(m_num_profiles,threads,[&](size_t i){
+        std::ofstream out{dirname + "/" + m_filename(i),std::ios_base::binary};
+        out.write(reinterpret_cast<char const *>(image(i)),PARAMS_BUF_SIZE);
+        if ( !out){
+            failed = true;
+        }
+    });
+    if ( failed){
+        throw std::runtime_error("failed to write profiles to " + dirname);
+    }
+    std::ofstream index{dirname + "/profiles.txt"};
+    for ( size_t i = 0; i < m_num_profiles; ++i){
+        index << m_filename(i) << ' ' << overrides(i) << '\n';
+    }
+    if ( !index){
+        throw std::runtime_error("failed to write " + dirname + "/profiles.txt");
+    }
+}
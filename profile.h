@@ -0,0 +1,73 @@
+#pragma once
+
+/*
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+ 
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program. If not, see <http://www.gnu.org/licenses/>
+
+Authors:
+   Andy Little
+   Tom Ren
+  
+*/
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <utility>
+
+#include "params.h"
+
+/*
+  variants of a base parameter profile, one for every combination of the values in a matrix
+  of overrides. The matrix is a text file with a line per parameter,
+     name=value|value|...
+  e.g Misc_Video_Mode=0|1 or ArmState_Panel=1|1,2. Blank lines and lines starting with # are skipped.
+  The base and each override value are checked and encoded once, then the images are put
+  together from the base and the encoded words, spread over a thread per core
+*/
+class CProfileGenerator{
+public:
+    // base_filename may be empty for the default parameters
+    CProfileGenerator(std::string const & base_filename, std::string const & matrix_filename);
+
+    size_t num_profiles() const { return m_num_profiles;}
+    // 0 threads is one per core
+    void build(size_t threads = 0);
+    // PARAMS_BUF_SIZE bytes, after build
+    uint8_t const * image(size_t i) const { return m_images.data() + i * PARAMS_BUF_SIZE;}
+    // the overrides in profile i, e.g "Misc_Video_Mode=1 ArmState_Panel=1,2"
+    std::string overrides(size_t i) const;
+    // a PARAMS_BUF_SIZE file per profile, and profiles.txt saying what is in each
+    void save(std::string const & dirname, size_t threads = 0) const;
+
+    static constexpr size_t max_profiles = 100000;
+
+private:
+    // one line of the matrix
+    struct axis{
+        std::string name;
+        std::vector<std::string> values;
+        // per value, the words it writes as address, value
+        std::vector<std::vector<std::pair<int32_t,uint16_t> > > words;
+    };
+    void m_add_axis(std::string const & line, std::vector<int32_t> & used);
+    // the value of each axis in profile i, the last axis changing fastest
+    std::vector<size_t> m_choices(size_t i) const;
+    std::string m_filename(size_t i) const;
+
+    COSDParam m_codec;
+    uint8_t m_base[PARAMS_BUF_SIZE];
+    std::vector<axis> m_axes;
+    size_t m_num_profiles;
+    std::vector<uint8_t> m_images;
+};
@@ -0,0 +1,284 @@
+/*
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+ 
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program. If not, see <http://www.gnu.org/licenses/>
+
+Authors:
+   Andy Little
+   Tom Ren
+*/
+
+#include "progress.h"
+
+#include <cstring>
+#include <cstdio>
+#include <chrono>
+
+namespace {
+
+    // how often the renderer looks at the channels
+    constexpr std::chrono::milliseconds render_period{50};
+
+    // text that doesnt fit is cut short and ends in "..."
+    void copy_text(char * dest, size_t size, char const * src)
+    {
+        strncpy(dest,src,size - 1);
+        dest[size - 1] = '\0';
+        if ( strlen(src) >= size){
+            memcpy(dest + size - 4,"...",3);
+        }
+    }
+
+    std::string json_string(std::string const & str)
+    {
+        std::string result = "\"";
+        for ( char c : str){
+            switch (c){
+                case '"':  result += "\\\""; break;
+                case '\\': result += "\\\\"; break;
+                case '\n': result += "\\n"; break;
+                case '\r': result += "\\r"; break;
+                case '\t': result += "\\t"; break;
+                default:
+                    if ( static_cast<unsigned char>(c) < 0x20){
+                        char buf[8];
+                        snprintf(buf,sizeof(buf),"\\u%04x",c);
+                        result += buf;
+                    }else{
+                        result += c;
+                    }
+            }
+        }
+        return result + "\"";
+    }
+
+} // namespace
+
+void CProgressChannel::m_post(progress_event const & event)
+{
+    if ( !m_ring.push(event)){
+        ++m_dropped;
+    }
+}
+
+void CProgressChannel::message(std::string const & text)
+{
+    progress_event event;
+    event.type = progress_event::kind::message;
+    event.phase[0] = '\0';
+    event.bytes_done = 0;
+    event.bytes_total = -1;
+    event.rate = 0;
+    event.eta = -1;
+    copy_text(event.text,sizeof(event.text),text.c_str());
+    m_post(event);
+}
+
+void CProgressChannel::phase(char const * phase)
+{
+    progress_event event;
+    event.type = progress_event::kind::phase;
+    copy_text(event.phase,sizeof(event.phase),phase);
+    event.bytes_done = 0;
+    event.bytes_total = -1;
+    event.rate = 0;
+    event.eta = -1;
+    event.text[0] = '\0';
+    m_post(event);
+}
+
+void CProgressChannel::progress(char const * phase, int32_t bytes_done, int32_t bytes_total, float rate, float eta)
+{
+    progress_event event;
+    event.type = progress_event::kind::progress;
+    copy_text(event.phase,sizeof(event.phase),phase);
+    event.bytes_done = bytes_done;
+    event.bytes_total = bytes_total;
+    event.rate = rate;
+    event.eta = eta;
+    event.text[0] = '\0';
+    m_post(event);
+}
+
+CProgressRenderer::CProgressRenderer(format fmt, std::ostream & out)
+: m_format{fmt}, m_out(out), m_running{false}, m_status_len{0}
+{}
+
+CProgressRenderer::~CProgressRenderer()
+{
+    stop();
+}
+
+CProgressChannel * CProgressRenderer::add_channel(std::string const & name)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_channels.emplace_back(new CProgressChannel(name));
+    m_states.emplace_back();
+    return m_channels.back().get();
+}
+
+void CProgressRenderer::start()
+{
+    if ( !m_running){
+        m_running = true;
+        m_thread = std::thread{&CProgressRenderer::m_run,this};
+    }
+}
+
+void CProgressRenderer::stop()
+{
+    if ( m_running){
+        m_running = false;
+        m_thread.join();
+        m_drain();
+        m_clear_status_line();
+        m_out.flush();
+    }
+}
+
+void CProgressRenderer::m_run()
+{
+    while ( m_running){
+        if ( m_drain() && (m_format == format::terminal)){
+            m_render_status_line();
+        }
+        m_out.flush();
+        std::this_thread::sleep_for(render_period);
+    }
+}
+
+// returns true if there was any progress to show
+bool CProgressRenderer::m_drain()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    bool have_progress = false;
+    for ( size_t i = 0; i < m_channels.size(); ++i){
+        CProgressChannel & channel = *m_channels[i];
+        board_state & state = m_states[i];
+        progress_event event;
+        while ( channel.m_ring.pop(event)){
+            m_render_event(channel,state,event);
+        }
+        uint32_t const dropped = channel.m_dropped.load();
+        if ( dropped != state.dropped){
+            if ( m_format == format::json){
+                m_out << "{\"board\":" << json_string(channel.name())
+                    << ",\"event\":\"dropped\",\"count\":" << dropped << "}\n";
+            }else{
+                m_clear_status_line();
+                if ( m_channels.size() > 1){
+                    m_out << '[' << channel.name() << "] ";
+                }
+                m_out << "( " << dropped - state.dropped << " status messages dropped)\n";
+            }
+            state.dropped = dropped;
+        }
+        have_progress |= (state.bytes_done > 0);
+    }
+    return have_progress;
+}
+
+void CProgressRenderer::m_render_event(CProgressChannel const & channel, board_state & state, progress_event const & event)
+{
+    switch ( event.type){
+        case progress_event::kind::phase:
+            state.phase = event.phase;
+            state.bytes_done = 0;
+            state.bytes_total = -1;
+            state.rate = 0;
+            state.eta = -1;
+            break;
+        case progress_event::kind::progress:
+            state.phase = event.phase;
+            state.bytes_done = event.bytes_done;
+            state.bytes_total = event.bytes_total;
+            state.rate = event.rate;
+            state.eta = event.eta;
+            break;
+        default:
+            break;
+    }
+
+    if ( m_format == format::json){
+        m_out << "{\"board\":" << json_string(channel.name());
+        switch ( event.type){
+            case progress_event::kind::message:
+                m_out << ",\"event\":\"message\",\"text\":" << json_string(event.text);
+                break;
+            case progress_event::kind::phase:
+                m_out << ",\"event\":\"phase\",\"phase\":" << json_string(event.phase);
+                break;
+            case progress_event::kind::progress:
+                m_out << ",\"event\":\"progress\",\"phase\":" << json_string(event.phase)
+                    << ",\"done\":" << event.bytes_done
+                    << ",\"total\":" << event.bytes_total
+                    << ",\"rate\":" << event.rate
+                    << ",\"eta\":" << event.eta;
+                break;
+        }
+        m_out << "}\n";
+        return;
+    }
+
+    // terminal : messages get a line each, progress is shown on the status line
+    if ( event.type == progress_event::kind::message){
+        m_clear_status_line();
+        if ( m_channels.size() > 1){
+            m_out << '[' << channel.name() << "] ";
+        }
+        m_out << event.text << '\n';
+    }
+}
+
+void CProgressRenderer::m_render_status_line()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::string line;
+    for ( size_t i = 0; i < m_channels.size(); ++i){
+        board_state const & state = m_states[i];
+        if ( state.bytes_done == 0){
+            continue;
+        }
+        char buf[128];
+        if ( (state.bytes_total > 0) && (state.eta >= 0)){
+            snprintf(buf,sizeof(buf),"%s %s %3d%% %.1f kB/s eta %.0fs",
+                m_channels[i]->name().c_str(),state.phase.c_str(),
+                static_cast<int>((100.0 * state.bytes_done) / state.bytes_total),
+                state.rate / 1000.0, state.eta);
+        }else if ( state.bytes_total > 0){
+            // not known yet
+            snprintf(buf,sizeof(buf),"%s %s %3d%% %.1f kB/s",
+                m_channels[i]->name().c_str(),state.phase.c_str(),
+                static_cast<int>((100.0 * state.bytes_done) / state.bytes_total),
+                state.rate / 1000.0);
+        }else{
+            snprintf(buf,sizeof(buf),"%s %s %d bytes %.1f kB/s",
+                m_channels[i]->name().c_str(),state.phase.c_str(),
+                state.bytes_done, state.rate / 1000.0);
+        }
+        if ( !line.empty()){
+            line += " | ";
+        }
+        line += buf;
+    }
+    m_clear_status_line();
+    m_out << line;
+    m_status_len = line.length();
+}
+
+void CProgressRenderer::m_clear_status_line()
+{
+    if ( m_status_len > 0){
+        m_out << '\r' << std::string(m_status_len,' ') << '\r';
+        m_status_len = 0;
+    }
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+/*
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+ 
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program. If not, see <http://www.gnu.org/licenses/>
+
+Authors:
+   Andy Little
+   Tom Ren
+  
+*/
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <iostream>
+
+#include "spsc_ring.h"
+
+// status from a connection, small and fixed size so it can go through the ring
+struct progress_event{
+    enum class kind : uint8_t { message, phase, progress };
+    kind type;
+    char phase[15];
+    int32_t bytes_done;
+    int32_t bytes_total;        // -1 if not known
+    float rate;                 // bytes per sec
+    float eta;                  // seconds, -1 if not known
+    char text[96];
+};
+
+/*
+  One connection's way to report progress. Only the connection's own thread may post.
+  Posting never blocks. If the renderer falls behind, events are dropped and counted,
+  and the count is reported. Message text longer than an event holds is cut short
+*/
+class CProgressChannel{
+public:
+    explicit CProgressChannel(std::string const & name)
+    : m_name(name), m_dropped{0}{}
+
+    void message(std::string const & text);
+    void phase(char const * phase);
+    void progress(char const * phase, int32_t bytes_done, int32_t bytes_total, float rate, float eta);
+
+    std::string const & name() const { return m_name;}
+private:
+    friend class CProgressRenderer;
+    void m_post(progress_event const & event);
+
+    std::string const m_name;
+    CSpscRing<progress_event,256> m_ring;
+    std::atomic<uint32_t> m_dropped;
+};
+
+/*
+  drains the channels of any number of connections on its own thread
+  and writes them to the terminal or as json lines
+*/
+class CProgressRenderer{
+public:
+    enum class format { terminal, json};
+
+    explicit CProgressRenderer(format fmt, std::ostream & out = std::cout);
+    ~CProgressRenderer();
+
+    // can be added while running. The renderer owns the channel
+    CProgressChannel * add_channel(std::string const & name);
+
+    void start();
+    // renders anything still queued and stops the thread
+    void stop();
+
+private:
+    struct board_state{
+        std::string phase;
+        int32_t bytes_done;
+        int32_t bytes_total;
+        float rate;
+        float eta;
+        uint32_t dropped;
+        board_state():bytes_done{0},bytes_total{-1},rate{0},eta{-1},dropped{0}{}
+    };
+
+    void m_run();
+    bool m_drain();
+    void m_render_event(CProgressChannel const & channel, board_state & state, progress_event const & event);
+    void m_render_status_line();
+    void m_clear_status_line();
+
+    format const m_format;
+    std::ostream & m_out;
+    std::vector<std::unique_ptr<CProgressChannel> > m_channels;
+    std::vector<board_state> m_states;
+    std::mutex m_mutex;
+    std::thread m_thread;
+    std::atomic<bool> m_running;
+    size_t m_status_len;
+};
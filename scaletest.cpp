@@ -0,0 +1,619 @@
+/*
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+ 
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program. If not, see <http://www.gnu.org/licenses/>
+
+Authors:
+   Andy Little
+   Tom Ren
+*/
+
+
+#include "scaletest.h"
+
+#include <cstring>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <stdexcept>
+#include <unistd.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+#include "osdconn.h"
+#include "fleet.h"
+#include "progress.h"
+#include "firmware.h"
+#include "transport.h"
+#include "params.h"
+#include "crc.h"
+
+namespace {
+
+    // what the simulated boards say they are
+    constexpr uint32_t sim_bl_rev = 4;
+    constexpr uint32_t sim_board_id = 88;
+    constexpr int32_t sim_flash_size = 1024 * 1024;
+    // the app's request to reboot to the bootloader
+    constexpr uint8_t proto_bl_upload = 0x55;
+    constexpr std::chrono::milliseconds sample_period{5};
+
+    struct process_sample{
+        int64_t rss_kb;
+        int64_t threads;
+        int64_t fds;
+    };
+
+    process_sample sample_process()
+    {
+        process_sample result{0,0,0};
+        std::ifstream status{"/proc/self/status"};
+        std::string line;
+        while ( std::getline(status,line)){
+            if ( line.compare(0,6,"VmRSS:") == 0){
+                result.rss_kb = atoll(line.c_str() + 6);
+            }else if ( line.compare(0,8,"Threads:") == 0){
+                result.threads = atoll(line.c_str() + 8);
+            }
+        }
+        if ( DIR * dir = opendir("/proc/self/fd")){
+            while ( dirent * entry = readdir(dir)){
+                if ( entry->d_name[0] != '.'){
+                    ++result.fds;
+                }
+            }
+            closedir(dir);
+        }
+        return result;
+    }
+
+    // read and write calls, from /proc/self/io. Sends arent in it so are counted by the transport
+    uint64_t rw_calls()
+    {
+        std::ifstream io{"/proc/self/io"};
+        std::string name;
+        uint64_t value = 0;
+        uint64_t result = 0;
+        while ( io >> name >> value){
+            if ( (name == "syscr:") || (name == "syscw:")){
+                result += value;
+            }
+        }
+        return result;
+    }
+
+    double cpu_seconds(rusage const & usage)
+    {
+        return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec +
+            (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) * 1e-6;
+    }
+
+    double process_cpu_seconds()
+    {
+        rusage usage;
+        getrusage(RUSAGE_SELF,&usage);
+        return cpu_seconds(usage);
+    }
+
+    double thread_cpu_seconds()
+    {
+        timespec ts;
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID,&ts);
+        return ts.tv_sec + ts.tv_nsec * 1e-9;
+    }
+
+    // the board end of a connection and which board it is for, over the control socket
+    bool send_board_fd(int control, uint32_t board, int fd)
+    {
+        union{
+            cmsghdr align;
+            char buf[CMSG_SPACE(sizeof(int))];
+        } control_buf;
+        iovec iov{&board,sizeof board};
+        msghdr msg{};
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control_buf.buf;
+        msg.msg_controllen = sizeof control_buf.buf;
+        cmsghdr * const cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+        memcpy(CMSG_DATA(cmsg),&fd,sizeof fd);
+        return ::sendmsg(control,&msg,MSG_NOSIGNAL) == static_cast<ssize_t>(sizeof board);
+    }
+
+    // false once the control socket is closed
+    bool recv_board_fd(int control, uint32_t & board, int & fd)
+    {
+        union{
+            cmsghdr align;
+            char buf[CMSG_SPACE(sizeof(int))];
+        } control_buf;
+        iovec iov{&board,sizeof board};
+        msghdr msg{};
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control_buf.buf;
+        msg.msg_controllen = sizeof control_buf.buf;
+        if ( ::recvmsg(control,&msg,MSG_CMSG_CLOEXEC) != static_cast<ssize_t>(sizeof board)){
+            return false;
+        }
+        cmsghdr * const cmsg = CMSG_FIRSTHDR(&msg);
+        if ( (cmsg == nullptr) || (cmsg->cmsg_type != SCM_RIGHTS)){
+            return false;
+        }
+        memcpy(&fd,CMSG_DATA(cmsg),sizeof fd);
+        return true;
+    }
+
+    class CMemorySource : public CFirmwareSource{
+    public:
+        explicit CMemorySource(std::vector<uint8_t> const & image) : m_image(image), m_pos{0}{}
+        size_t read(uint8_t * dest, size_t max)
+        {
+            size_t const n = std::min(max,m_image.size() - m_pos);
+            memcpy(dest,m_image.data() + m_pos,n);
+            m_pos += n;
+            return n;
+        }
+        int32_t size_hint() const { return static_cast<int32_t>(m_image.size());}
+    private:
+        std::vector<uint8_t> const & m_image;
+        size_t m_pos;
+    };
+
+    // progress is rendered as usual, then thrown away
+    class CNullBuf : public std::streambuf{
+    protected:
+        int overflow(int c) { return c;}
+        std::streamsize xsputn(char const *, std::streamsize n) { return n;}
+    };
+}
+
+class CScaleTest::CSocketTransport : public CFdTransport{
+public:
+    CSocketTransport(std::string const & name, int fd, std::atomic<uint64_t> & sends)
+    : CFdTransport{name,fd}, m_sends(sends){}
+protected:
+    // send isnt in /proc/self/io so is counted here
+    ssize_t m_write_some(uint8_t const * buf, size_t len)
+    {
+        ++m_sends;
+        return ::send(fd(),buf,len,MSG_NOSIGNAL);
+    }
+private:
+    std::atomic<uint64_t> & m_sends;
+};
+
+/*
+  bootloader and app in one. Each connection is served by its own thread until either end
+  closes it, and a reboot closes it from the board end as the usb link would drop.
+  No flash is kept, only the crc of what was programmed
+*/
+class CScaleTest::CSimBoard{
+public:
+    CSimBoard()
+    : m_bootloader{false}, m_crc_state{0}, m_programmed{0}
+    {
+        memset(m_params,0,PARAMS_BUF_SIZE);
+    }
+
+    ~CSimBoard()
+    {
+        for ( auto & t : m_peers){
+            t.join();
+        }
+    }
+
+    // the board end of a new connection
+    void serve(int fd)
+    {
+        std::lock_guard<std::mutex> lock{m_mutex};
+        m_peers.emplace_back(&CSimBoard::m_serve,this,fd);
+    }
+
+private:
+    bool m_read(int fd, uint8_t * buf, size_t len)
+    {
+        while ( len > 0){
+            ssize_t const n = ::recv(fd,buf,len,0);
+            if ( n <= 0){
+                return false;
+            }
+            buf += n;
+            len -= n;
+        }
+        return true;
+    }
+
+    void m_write(int fd, uint8_t const * buf, size_t len)
+    {
+        while ( len > 0){
+            ssize_t const n = ::send(fd,buf,len,MSG_NOSIGNAL);
+            if ( n <= 0){
+                return;
+            }
+            buf += n;
+            len -= n;
+        }
+    }
+
+    void m_reply(int fd, uint8_t status = COSDConn::OK)
+    {
+        uint8_t const reply [] = {COSDConn::INSYNC, status};
+        m_write(fd,reply,2);
+    }
+
+    void m_reply_word(int fd, uint32_t value)
+    {
+        uint8_t const reply [] = {static_cast<uint8_t>(value), static_cast<uint8_t>(value >> 8),
+            static_cast<uint8_t>(value >> 16), static_cast<uint8_t>(value >> 24), COSDConn::INSYNC, COSDConn::OK};
+        m_write(fd,reply,6);
+    }
+
+    // false to end the connection
+    bool m_bootloader_command(int fd, uint8_t cmd)
+    {
+        uint8_t arg[256];
+        switch (cmd){
+        case COSDConn::GET_DEVICE:{
+            if ( !m_read(fd,arg,2)){
+                return false;
+            }
+            uint32_t const info [] = {0, sim_bl_rev, sim_board_id, 1, sim_flash_size};
+            m_reply_word(fd,(arg[0] <= COSDConn::INFO_FLASH_SIZE) ? info[arg[0]] : 0);
+            return true;
+        }
+        case COSDConn::CHIP_ERASE:
+            if ( !m_read(fd,arg,1)){
+                return false;
+            }
+            m_crc_state = 0;
+            m_programmed = 0;
+            m_reply(fd);
+            return true;
+        case COSDConn::PROG_MULTI:
+            if ( !m_read(fd,arg,1) || !m_read(fd,arg + 1,arg[0] + 1)){
+                return false;
+            }
+            m_crc_state = px4Uploader::crc_update(arg + 1,arg[0],m_crc_state);
+            m_programmed += arg[0];
+            m_reply(fd);
+            return true;
+        case COSDConn::GET_CRC:
+            if ( !m_read(fd,arg,1)){
+                return false;
+            }
+            m_reply_word(fd,px4Uploader::crc_pad(m_crc_state,m_programmed,sim_flash_size));
+            return true;
+        case COSDConn::GET_SN:
+        case COSDConn::GET_OTP:
+            if ( !m_read(fd,arg,5)){
+                return false;
+            }
+            m_reply_word(fd,arg[0]);
+            return true;
+        case COSDConn::GET_CHIP:
+            if ( !m_read(fd,arg,1)){
+                return false;
+            }
+            m_reply_word(fd,0x10016413);
+            return true;
+        case COSDConn::REBOOT:
+            m_read(fd,arg,1);
+            m_reply(fd);
+            m_bootloader = false;
+            return false;
+        default:
+            m_reply(fd,COSDConn::INVALID);
+            return true;
+        }
+    }
+
+    bool m_app_command(int fd, uint8_t cmd)
+    {
+        uint8_t arg[256];
+        switch (cmd){
+        case proto_bl_upload:
+            m_read(fd,arg,1);
+            m_reply(fd);
+            m_bootloader = true;
+            return false;
+        case COSDConn::START_TRANSFER:
+            m_pending.clear();
+            break;
+        case COSDConn::SET_PARAMS:
+            if ( !m_read(fd,arg,1) || !m_read(fd,arg + 1,arg[0])){
+                return false;
+            }
+            m_pending.insert(m_pending.end(),arg + 1,arg + 1 + arg[0]);
+            break;
+        case COSDConn::END_TRANSFER:
+            memcpy(m_params,m_pending.data(),std::min(m_pending.size(),sizeof m_params));
+            break;
+        case COSDConn::SAVE_TO_EEPROM:
+            break;
+        case COSDConn::GET_PARAMS:
+            if ( !m_read(fd,arg,1)){
+                return false;
+            }
+            m_write(fd,m_params,PARAMS_BUF_SIZE);
+            m_reply(fd);
+            return true;
+        default:
+            m_reply(fd,COSDConn::INVALID);
+            return true;
+        }
+        if ( !m_read(fd,arg,1)){
+            return false;
+        }
+        m_reply(fd);
+        return true;
+    }
+
+    void m_serve(int fd)
+    {
+        uint8_t cmd;
+        bool open = true;
+        while ( open && m_read(fd,&cmd,1)){
+            if ( cmd == COSDConn::GET_SYNC){
+                open = m_read(fd,&cmd,1);
+                m_reply(fd);
+            }else{
+                open = m_bootloader ? m_bootloader_command(fd,cmd) : m_app_command(fd,cmd);
+            }
+        }
+        ::close(fd);
+    }
+
+    std::atomic<bool> m_bootloader;
+    uint32_t m_crc_state;
+    int32_t m_programmed;
+    uint8_t m_params[PARAMS_BUF_SIZE];
+    std::vector<uint8_t> m_pending;
+    std::vector<std::thread> m_peers;
+    std::mutex m_mutex;
+};
+
+/*
+  the boards of one step, in a child process forked before the step starts any threads.
+  The tool makes each connection and passes the board end to the child, which serves it until
+  either end closes it. The child ends when the control socket is closed and its cpu is read
+  as it is reaped
+*/
+class CScaleTest::CSimHost{
+public:
+    explicit CSimHost(size_t num_boards)
+    {
+        int fds[2];
+        if ( socketpair(AF_UNIX,SOCK_SEQPACKET | SOCK_CLOEXEC,0,fds) != 0){
+            throw std::runtime_error(std::string{"scale test : socketpair failed : "} + strerror(errno));
+        }
+        m_child = fork();
+        if ( m_child < 0){
+            ::close(fds[0]);
+            ::close(fds[1]);
+            throw std::runtime_error(std::string{"scale test : fork failed : "} + strerror(errno));
+        }
+        if ( m_child == 0){
+            ::close(fds[0]);
+            m_run_boards(fds[1],num_boards);
+        }
+        ::close(fds[1]);
+        m_control = fds[0];
+    }
+
+    ~CSimHost()
+    {
+        if ( m_control >= 0){
+            try{
+                finish();
+            }catch(...){}
+        }
+    }
+
+    // the tool end of a new connection to board, non blocking as CFdTransport wants
+    int connect(uint32_t board)
+    {
+        int fds[2];
+        if ( socketpair(AF_UNIX,SOCK_STREAM | SOCK_CLOEXEC,0,fds) != 0){
+            throw std::runtime_error(std::string{"scale test : socketpair failed : "} + strerror(errno));
+        }
+        bool sent;
+        {
+            std::lock_guard<std::mutex> lock{m_mutex};
+            sent = send_board_fd(m_control,board,fds[1]);
+        }
+        ::close(fds[1]);
+        if ( !sent){
+            ::close(fds[0]);
+            throw std::runtime_error("scale test : simulator process gone");
+        }
+        fcntl(fds[0],F_SETFL,fcntl(fds[0],F_GETFL) | O_NONBLOCK);
+        return fds[0];
+    }
+
+    // waits for the boards to end, returning the cpu seconds they used
+    double finish()
+    {
+        ::close(m_control);
+        m_control = -1;
+        int status = 0;
+        rusage usage;
+        if ( (wait4(m_child,&status,0,&usage) != m_child) || !WIFEXITED(status) || (WEXITSTATUS(status) != 0)){
+            throw std::runtime_error("scale test : simulator process failed");
+        }
+        return cpu_seconds(usage);
+    }
+
+private:
+    // in the child, never returns
+    static void m_run_boards(int control, size_t num_boards)
+    {
+        int result = 0;
+        try{
+            std::vector<std::unique_ptr<CSimBoard> > boards;
+            for ( size_t i = 0; i < num_boards; ++i){
+                boards.emplace_back(new CSimBoard);
+            }
+            uint32_t board;
+            int fd;
+            while ( recv_board_fd(control,board,fd)){
+                if ( board < boards.size()){
+                    boards[board]->serve(fd);
+                }else{
+                    ::close(fd);
+                }
+            }
+            // the boards join their connections as they go
+        }catch(...){
+            result = 1;
+        }
+        _exit(result);
+    }
+
+    int m_control;
+    pid_t m_child;
+    std::mutex m_mutex;
+};
+
+constexpr size_t CScaleTest::default_image_size;
+
+CScaleTest::CScaleTest(size_t image_size)
+: m_image(image_size)
+{
+    uint32_t state = 1;
+    for ( auto & b : m_image){
+        state = state * 1103515245 + 12345;
+        b = static_cast<uint8_t>(state >> 16);
+    }
+}
+
+CScaleTest::step_result CScaleTest::run_step(size_t num_boards)
+{
+    step_result result{};
+    result.boards = num_boards;
+
+    // before any threads are started
+    CSimHost sims{num_boards};
+
+    // sampled from before the boards exist until they are all gone
+    process_sample const base = sample_process();
+    process_sample peak = base;
+    std::atomic<bool> sampling{true};
+    double sampler_cpu = 0;
+    std::thread sampler{[&]{
+        while ( sampling){
+            process_sample const s = sample_process();
+            peak.rss_kb = std::max(peak.rss_kb,s.rss_kb);
+            peak.threads = std::max(peak.threads,s.threads);
+            peak.fds = std::max(peak.fds,s.fds);
+            std::this_thread::sleep_for(sample_period);
+        }
+        sampler_cpu = thread_cpu_seconds();
+    }};
+
+    double const cpu_start = process_cpu_seconds();
+    uint64_t const rw_calls_start = rw_calls();
+    auto const start = std::chrono::steady_clock::now();
+
+    std::atomic<uint64_t> sends{0};
+    {
+        std::vector<std::string> ports;
+        for ( size_t i = 0; i < num_boards; ++i){
+            ports.push_back("sim:" + std::to_string(i));
+        }
+        COSDParam osdparams;
+        uint8_t paramsbuf[PARAMS_BUF_SIZE];
+        osdparams.get_default_params(paramsbuf);
+
+        CNullBuf null_buf;
+        std::ostream discard{&null_buf};
+        CProgressRenderer progress{CProgressRenderer::format::terminal,discard};
+        progress.start();
+        CFleet fleet{ports,progress,nullptr};
+        fleet.set_hub_limit(0);
+        fleet.set_transport_factory([&sims,&sends](std::string const & name){
+            int const fd = sims.connect(static_cast<uint32_t>(strtoul(name.c_str() + 4,nullptr,10)));
+            return std::unique_ptr<CTransport>{new CSocketTransport{name,fd,sends}};
+        });
+        auto const results = fleet.run([this,&paramsbuf](COSDConn & conn){
+            conn.upload_firmware(std::unique_ptr<CFirmwareSource>{new CMemorySource{m_image}});
+            conn.wait_for_app();
+            conn.upload_params_buffer(paramsbuf);
+        });
+        progress.stop();
+        for ( auto const & r : results){
+            if ( !r.ok){
+                if ( result.failed++ == 0){
+                    result.first_error = r.port + " : " + r.message;
+                }
+            }
+        }
+    }
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    sampling = false;
+    sampler.join();
+    result.tool_cpu_seconds = process_cpu_seconds() - cpu_start - sampler_cpu;
+    result.rw_calls = rw_calls() - rw_calls_start + sends;
+    result.sim_cpu_seconds = sims.finish();
+    result.peak_rss_kb = peak.rss_kb - base.rss_kb;
+    result.peak_fds = peak.fds - base.fds;
+    result.peak_threads = peak.threads;
+    result.bytes = (num_boards - result.failed) * m_image.size();
+    return result;
+}
+
+std::vector<CScaleTest::step_result> CScaleTest::run(size_t max_boards, std::ostream & out)
+{
+    std::vector<step_result> results;
+    report_header(out);
+    for ( size_t n = 1; ; n = std::min(n * 2,max_boards)){
+        results.push_back(run_step(n));
+        report(results.back(),out);
+        if ( n == max_boards){
+            break;
+        }
+    }
+    return results;
+}
+
+void CScaleTest::report_header(std::ostream & out)
+{
+    out << "                                   ------------------ per board ------------------\n";
+    out << "boards failed  wall_s    kB/s    cpu_ms  sim_cpu_ms   rss_kB    fds threads  rw_calls\n";
+}
+
+void CScaleTest::report(step_result const & step, std::ostream & out)
+{
+    double const n = static_cast<double>(step.boards);
+    char line[160];
+    snprintf(line,sizeof line,"%6zu %6zu %7.2f %7.0f %9.1f %11.1f %8.1f %6.2f %7lld %9.0f\n",
+        step.boards, step.failed, step.seconds, step.bytes / 1024.0 / step.seconds,
+        step.tool_cpu_seconds * 1000 / n, step.sim_cpu_seconds * 1000 / n, step.peak_rss_kb / n,
+        step.peak_fds / n, static_cast<long long>(step.peak_threads), step.rw_calls / n);
+    out << line;
+    if ( !step.first_error.empty()){
+        out << "   first failure " << step.first_error << '\n';
+    }
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+/*
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+ 
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program. If not, see <http://www.gnu.org/licenses/>
+
+Authors:
+   Andy Little
+   Tom Ren
+  
+*/
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <iostream>
+
+/*
+  how the host cost of a fleet job grows with the number of boards. Each step runs a firmware
+  upload and a parameter write through CFleet and COSDConn on n simulated boards at once.
+  The boards are bootloader and app simulators in a child process, each connection a socketpair,
+  so the cpu, memory, descriptors and threads read for this process are the tool's own.
+  Memory, descriptors and threads are sampled while the step runs. Read and write calls are the
+  tool's reads, writes and sends, to the boards and otherwise. Polls and other calls arent counted
+*/
+class CScaleTest{
+public:
+    struct step_result{
+        size_t boards;
+        size_t failed;
+        double seconds;
+        double tool_cpu_seconds;
+        double sim_cpu_seconds;
+        int64_t peak_rss_kb;        // over the start of the step
+        int64_t peak_fds;           // over the start of the step
+        int64_t peak_threads;
+        uint64_t rw_calls;          // reads, writes and sends
+        uint64_t bytes;             // firmware programmed
+        std::string first_error;
+    };
+
+    explicit CScaleTest(size_t image_size = default_image_size);
+
+    step_result run_step(size_t boards);
+    // steps of 1, 2, 4 ... up to max_boards, each reported as it finishes
+    std::vector<step_result> run(size_t max_boards, std::ostream & out = std::cout);
+    static void report_header(std::ostream & out);
+    static void report(step_result const & step, std::ostream & out);
+
+    static constexpr size_t default_image_size = 128 * 1024;
+
+private:
+    class CSimBoard;
+    class CSimHost;
+    class CSocketTransport;
+
+    std::vector<uint8_t> m_image;
+};
@@ -0,0 +1,312 @@
+/*
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+ 
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program. If not, see <http://www.gnu.org/licenses/>
+
+Authors:
+   Andy Little
+   Tom Ren
+*/
+
+
+#include "snapshot.h"
+
+#include <fstream>
+#include <stdexcept>
+#include <algorithm>
+#include <numeric>
+#include <map>
+#include <chrono>
+#include <cstring>
+#include <cstdio>
+#include <iterator>
+
+#include "osdconn.h"
+#include "params.h"
+#include "inventory.h"
+
+namespace {
+
+    constexpr char snapshot_magic[8] = {'P','O','S','D','S','N','A','P'};
+    constexpr size_t header_size = 20;
+
+    void put_u16(std::vector<uint8_t> & out, uint16_t v)
+    {
+        out.push_back(static_cast<uint8_t>(v));
+        out.push_back(static_cast<uint8_t>(v >> 8));
+    }
+
+    void put_u32(std::vector<uint8_t> & out, uint32_t v)
+    {
+        put_u16(out, static_cast<uint16_t>(v));
+        put_u16(out, static_cast<uint16_t>(v >> 16));
+    }
+
+    uint16_t get_u16(uint8_t const * p)
+    {
+        return static_cast<uint16_t>(p[0] | (p[1] << 8));
+    }
+
+    uint32_t get_u32(uint8_t const * p)
+    {
+        return get_u16(p) | (static_cast<uint32_t>(get_u16(p + 2)) << 16);
+    }
+
+    uint16_t get_word(uint8_t const * paramsbuf, uint16_t address)
+    {
+        return static_cast<uint16_t>(paramsbuf[address] | (paramsbuf[address + 1] << 8));
+    }
+
+    COSDParam const & layout()
+    {
+        static COSDParam const params;
+        return params;
+    }
+}
+
+constexpr uint16_t CParamSnapshot::format_version;
+
+CParamSnapshot::CParamSnapshot()
+: m_taken{static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::seconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count())}
+{
+    uint8_t defaults[PARAMS_BUF_SIZE];
+    COSDParam{}.get_default_params(defaults);
+    for ( uint16_t address = 0; address < static_cast<uint16_t>(layout().layout_size()); address += 2){
+        m_addresses.push_back(address);
+        m_defaults.push_back(get_word(defaults,address));
+    }
+}
+
+CParamSnapshot::CParamSnapshot(std::string const & filename)
+{
+    std::ifstream in(filename, std::ios_base::in | std::ios_base::binary);
+    if ( !in){
+        throw std::runtime_error("failed to open snapshot file " + filename);
+    }
+    std::vector<uint8_t> const data{std::istreambuf_iterator<char>(in),std::istreambuf_iterator<char>()};
+    if ( (data.size() < header_size) || (memcmp(data.data(),snapshot_magic,8) != 0)){
+        throw std::runtime_error(filename + " is not a snapshot file");
+    }
+    if ( get_u16(&data[8]) != format_version){
+        throw std::runtime_error(filename + " is an unsupported snapshot version");
+    }
+    size_t const columns = get_u16(&data[10]);
+    size_t const boards = get_u32(&data[12]);
+    m_taken = get_u32(&data[16]);
+    std::runtime_error const corrupt{"snapshot file " + filename + " is corrupt"};
+
+    size_t pos = header_size;
+    if ( data.size() - pos < columns * 4){
+        throw corrupt;
+    }
+    for ( size_t col = 0; col < columns; ++col, pos += 4){
+        m_addresses.push_back(get_u16(&data[pos]));
+        m_defaults.push_back(get_u16(&data[pos + 2]));
+    }
+    for ( size_t row = 0; row < boards; ++row){
+        if ( (pos >= data.size()) || (data.size() - pos - 1 < data[pos])){
+            throw corrupt;
+        }
+        size_t const len = data[pos++];
+        m_boards.emplace_back(reinterpret_cast<char const*>(&data[pos]),len);
+        pos += len;
+    }
+    if ( data.size() - pos != columns * boards * 2){
+        throw corrupt;
+    }
+    m_values.resize(columns * boards);
+    for ( auto & v : m_values){
+        v = get_u16(&data[pos]);
+        pos += 2;
+    }
+}
+
+std::vector<fleet_result> CParamSnapshot::read(CFleet & boards, CInventory const & inventory)
+{
+    // looked up first, while every board is on its port
+    std::map<std::string,std::string> names;
+    for ( auto const & port : boards.ports()){
+        std::string const serial = inventory.serial_of(port);
+        names[port] = serial.empty() ? port : serial;
+    }
+    auto const results = boards.run([this,&names](COSDConn & conn){
+        uint8_t paramsbuf[PARAMS_BUF_SIZE];
+        conn.get_params_buffer(paramsbuf);
+        m_add(names.at(conn.port_name()),paramsbuf);
+    });
+    m_pack();
+    return results;
+}
+
+void CParamSnapshot::m_add(std::string const & board, uint8_t const * paramsbuf)
+{
+    std::vector<uint16_t> row;
+    for ( auto address : m_addresses){
+        row.push_back(get_word(paramsbuf,address));
+    }
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_added.emplace_back(board.substr(0,255),std::move(row));
+}
+
+// merges the added rows into the columns, keeping the boards in name order
+void CParamSnapshot::m_pack()
+{
+    size_t const old_rows = m_boards.size();
+    size_t const rows = old_rows + m_added.size();
+    std::vector<std::string> names = m_boards;
+    for ( auto const & added : m_added){
+        names.push_back(added.first);
+    }
+    std::vector<size_t> order(rows);
+    std::iota(order.begin(),order.end(),0);
+    std::stable_sort(order.begin(),order.end(),[&names](size_t a, size_t b){ return names[a] < names[b];});
+
+    std::vector<uint16_t> values(m_addresses.size() * rows);
+    for ( size_t col = 0; col < m_addresses.size(); ++col){
+        for ( size_t row = 0; row < rows; ++row){
+            size_t const from = order[row];
+            values[col * rows + row] = (from < old_rows)
+                ? m_values[col * old_rows + from]
+                : m_added[from - old_rows].second[col];
+        }
+    }
+    m_boards.clear();
+    for ( size_t from : order){
+        m_boards.push_back(names[from]);
+    }
+    m_values.swap(values);
+    m_added.clear();
+}
+
+void CParamSnapshot::save(std::string const & filename) const
+{
+    std::vector<uint8_t> out(snapshot_magic,snapshot_magic + 8);
+    put_u16(out,format_version);
+    put_u16(out,static_cast<uint16_t>(m_addresses.size()));
+    put_u32(out,static_cast<uint32_t>(m_boards.size()));
+    put_u32(out,m_taken);
+    for ( size_t col = 0; col < m_addresses.size(); ++col){
+        put_u16(out,m_addresses[col]);
+        put_u16(out,m_defaults[col]);
+    }
+    for ( auto const & name : m_boards){
+        out.push_back(static_cast<uint8_t>(name.size()));
+        out.insert(out.end(),name.begin(),name.end());
+    }
+    for ( auto v : m_values){
+        put_u16(out,v);
+    }
+
+    // written under another name first so a failed save doesnt leave a bad snapshot
+    std::string const tmp = filename + ".tmp";
+    {
+        std::ofstream fo(tmp, std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
+        fo.write(reinterpret_cast<char const*>(out.data()),out.size());
+        if ( !fo.good()){
+            remove(tmp.c_str());
+            throw std::runtime_error("failed to write snapshot file " + filename);
+        }
+    }
+    if ( rename(tmp.c_str(),filename.c_str()) != 0){
+        remove(tmp.c_str());
+        throw std::runtime_error("failed to write snapshot file " + filename);
+    }
+}
+
+size_t CParamSnapshot::column(std::string const & name) const
+{
+    int32_t const address = COSDParam::address_of(name.c_str());
+    if ( address >= 0){
+        auto const col = std::find(m_addresses.begin(),m_addresses.end(),address);
+        if ( col != m_addresses.end()){
+            return col - m_addresses.begin();
+        }
+    }
+    throw std::runtime_error("no parameter " + name + " in the snapshot");
+}
+
+// columns from another layout may have no name, so are named by address
+std::string CParamSnapshot::column_name(size_t col) const
+{
+    for ( auto const & entry : COSDParam::params()){
+        if ( entry.address == m_addresses[col]){
+            return entry.name;
+        }
+    }
+    return "@" + std::to_string(m_addresses[col]);
+}
+
+std::vector<size_t> CParamSnapshot::select(size_t col, compare op, uint16_t v) const
+{
+    std::vector<size_t> rows;
+    uint16_t const * values = &m_values[col * m_boards.size()];
+    for ( size_t row = 0; row < m_boards.size(); ++row){
+        bool match = false;
+        switch (op){
+            case compare::eq: match = values[row] == v; break;
+            case compare::ne: match = values[row] != v; break;
+            case compare::lt: match = values[row] < v; break;
+            case compare::gt: match = values[row] > v; break;
+        }
+        if ( match){
+            rows.push_back(row);
+        }
+    }
+    return rows;
+}
+
+/*
+  boards are matched by name and columns by address. Both are in order, so each
+  is a merge. Returns the number of differences
+*/
+size_t CParamSnapshot::diff(CParamSnapshot const & old_snapshot, CParamSnapshot const & new_snapshot, std::ostream & out)
+{
+    // columns in both, as old column, new column
+    std::vector<std::pair<size_t,size_t> > columns;
+    for ( size_t col = 0; col < new_snapshot.m_addresses.size(); ++col){
+        auto const old_col = std::find(old_snapshot.m_addresses.begin(),old_snapshot.m_addresses.end(),
+            new_snapshot.m_addresses[col]);
+        if ( old_col != old_snapshot.m_addresses.end()){
+            columns.emplace_back(old_col - old_snapshot.m_addresses.begin(),col);
+        }
+    }
+
+    size_t differences = 0;
+    size_t old_row = 0;
+    size_t new_row = 0;
+    auto const & old_boards = old_snapshot.m_boards;
+    auto const & new_boards = new_snapshot.m_boards;
+    while ( (old_row < old_boards.size()) || (new_row < new_boards.size())){
+        if ( (new_row == new_boards.size()) ||
+                ((old_row < old_boards.size()) && (old_boards[old_row] < new_boards[new_row]))){
+            out << old_boards[old_row++] << " : removed\n";
+            ++differences;
+        }else if ( (old_row == old_boards.size()) || (new_boards[new_row] < old_boards[old_row])){
+            out << new_boards[new_row++] << " : added\n";
+            ++differences;
+        }else{
+            for ( auto const & col : columns){
+                uint16_t const was = old_snapshot.value(old_row,col.first);
+                uint16_t const now = new_snapshot.value(new_row,col.second);
+                if ( was != now){
+                    out << new_boards[new_row] << " : " << new_snapshot.column_name(col.second)
+                        << " " << was << " -> " << now << '\n';
+                    ++differences;
+                }
+            }
+            ++old_row;
+            ++new_row;
+        }
+    }
+    return differences;
+}
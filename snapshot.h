@@ -0,0 +1,88 @@
+#pragma once
+
+/*
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+ 
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program. If not, see <http://www.gnu.org/licenses/>
+
+Authors:
+   Andy Little
+   Tom Ren
+  
+*/
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <iostream>
+
+#include "fleet.h"
+
+class CInventory;
+
+/*
+  the parameters of many boards, one column per parameter address and one row per board.
+  little endian :
+     0  "POSDSNAP"
+     8  u16 format version
+     10 u16 columns
+     12 u32 boards
+     16 u32 unix time taken
+     20 per column, u16 parameter address, u16 default value
+        per board, u8 name length, name ( serial, or port if the serial isnt known)
+        per column, the u16 value on each board in board order
+  Boards are sorted by name. Values are the raw words in the parameter buffer,
+  e.g panels are a bit per panel.
+*/
+class CParamSnapshot{
+public:
+    enum class compare { eq, ne, lt, gt};
+
+    // empty, with a column for each parameter in the layout
+    CParamSnapshot();
+    explicit CParamSnapshot(std::string const & filename);
+
+    // reads the parameters on the boards at once, naming each by its serial in the inventory
+    std::vector<fleet_result> read(CFleet & boards, CInventory const & inventory);
+    void save(std::string const & filename) const;
+
+    size_t num_boards() const { return m_boards.size();}
+    std::string const & board(size_t row) const { return m_boards[row];}
+    // column of the parameter name, throws if there isnt one
+    size_t column(std::string const & name) const;
+    std::string column_name(size_t col) const;
+    uint16_t value(size_t row, size_t col) const { return m_values[col * m_boards.size() + row];}
+    uint16_t default_value(size_t col) const { return m_defaults[col];}
+
+    // rows where the column compares true with the value
+    std::vector<size_t> select(size_t col, compare op, uint16_t v) const;
+    // writes the boards added, removed and the parameters changed from old_snapshot
+    static size_t diff(CParamSnapshot const & old_snapshot, CParamSnapshot const & new_snapshot,
+        std::ostream & out = std::cout);
+
+    static constexpr uint16_t format_version = 1;
+
+private:
+    void m_add(std::string const & board, uint8_t const * paramsbuf);
+    void m_pack();
+
+    std::vector<uint16_t> m_addresses;
+    std::vector<uint16_t> m_defaults;
+    std::vector<std::string> m_boards;
+    // column major, column * boards + row
+    std::vector<uint16_t> m_values;
+    uint32_t m_taken;
+    // rows read but not yet in the columns
+    std::vector<std::pair<std::string,std::vector<uint16_t> > > m_added;
+    std::mutex m_mutex;
+};
@@ -0,0 +1,65 @@
+#pragma once
+
+/*
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+ 
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program. If not, see <http://www.gnu.org/licenses/>
+
+Authors:
+   Andy Little
+   Tom Ren
+  
+*/
+
+#include <cstddef>
+#include <atomic>
+
+/*
+  lock free ring for exactly one producer thread and one consumer thread.
+  Neither side ever blocks, push fails when full and pop fails when empty.
+  N must be a power of 2
+*/
+template <typename T, size_t N>
+class CSpscRing{
+    static_assert( (N != 0) && ((N & (N - 1)) == 0), "ring size must be a power of 2");
+public:
+    CSpscRing():m_head{0},m_tail{0}{}
+
+    bool push(T const & item)
+    {
+        size_t const head = m_head.load(std::memory_order_relaxed);
+        if ( (head - m_tail.load(std::memory_order_acquire)) == N){
+            return false;
+        }
+        m_items[head & (N - 1)] = item;
+        m_head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool pop(T & item)
+    {
+        size_t const tail = m_tail.load(std::memory_order_relaxed);
+        if ( tail == m_head.load(std::memory_order_acquire)){
+            return false;
+        }
+        item = m_items[tail & (N - 1)];
+        m_tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    T m_items[N];
+    // padded apart so the two threads dont fight over one cache line
+    std::atomic<size_t> m_head;
+    char m_pad[64 - sizeof(std::atomic<size_t>)];
+    std::atomic<size_t> m_tail;
+};
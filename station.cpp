@@ -0,0 +1,252 @@
+/*
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+ 
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program. If not, see <http://www.gnu.org/licenses/>
+
+Authors:
+   Andy Little
+   Tom Ren
+*/
+
+
+#include "station.h"
+
+#include <stdexcept>
+#include <chrono>
+#include <cstring>
+#include <cerrno>
+#include <unistd.h>
+#include <dirent.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <linux/netlink.h>
+
+#include "osdconn.h"
+#include "progress.h"
+#include "hub.h"
+#include "inventory.h"
+
+namespace {
+
+    // how often the station looks for finished jobs and the stop flag
+    constexpr int poll_period_ms = 200;
+    // for the new port to be set up ( e.g its permissions) before it is opened
+    constexpr std::chrono::milliseconds settle_time{1000};
+    // adds for a device just after its job are the board coming back from the last reboot
+    constexpr std::chrono::seconds rearm_time{5};
+
+    // the value of a KEY=value field in a uevent, empty if not there
+    std::string uevent_field(char const * buf, size_t len, char const * key)
+    {
+        size_t const key_len = strlen(key);
+        for ( size_t pos = 0; pos < len; pos += strlen(buf + pos) + 1){
+            if ( (strncmp(buf + pos,key,key_len) == 0) && (buf[pos + key_len] == '=')){
+                return buf + pos + key_len + 1;
+            }
+        }
+        return "";
+    }
+
+    // DEVPATH of a tty is the usb interface it is on, then the tty, e.g
+    // /devices/pci0000:00/0000:00:14.0/usb1/1-1/1-1.2/1-1.2:1.0/tty/ttyACM0
+    // The usb device is the board ( /devices/.../1-1.2), empty if there is no interface
+    std::string usb_device_of(std::string devpath)
+    {
+        for ( int i = 0; i < 3; ++i){
+            size_t const slash = devpath.rfind('/');
+            if ( (slash == std::string::npos) || (slash == 0)){
+                return "";
+            }
+            if ( (i == 2) && (devpath.find(':',slash) == std::string::npos)){
+                return "";
+            }
+            devpath.erase(slash);
+        }
+        return devpath;
+    }
+
+    // directory entries starting with prefix
+    std::vector<std::string> entries_starting(std::string const & dirname, std::string const & prefix)
+    {
+        std::vector<std::string> result;
+        if ( DIR * dir = opendir(dirname.c_str())){
+            while ( dirent * entry = readdir(dir)){
+                if ( strncmp(entry->d_name,prefix.c_str(),prefix.length()) == 0){
+                    result.push_back(entry->d_name);
+                }
+            }
+            closedir(dir);
+        }
+        return result;
+    }
+}
+
+CStation::CStation(std::function<void(COSDConn &)> const & job, CProgressRenderer & progress, CMetrics * metrics)
+: m_job(job), m_progress(progress), m_metrics{metrics}, m_hub_limit{CFleet::default_hub_limit}
+ ,m_inventory{nullptr}, m_timing{nullptr}, m_channel{progress.add_channel("station")}
+ ,m_socket{socket(AF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC, NETLINK_KOBJECT_UEVENT)}
+{
+    if ( m_socket < 0){
+        throw std::runtime_error(std::string{"station : failed to open uevent socket : "} + strerror(errno));
+    }
+    sockaddr_nl addr;
+    memset(&addr,0,sizeof addr);
+    addr.nl_family = AF_NETLINK;
+    // the kernel's own events
+    addr.nl_groups = 1;
+    if ( bind(m_socket,reinterpret_cast<sockaddr*>(&addr),sizeof addr) != 0){
+        int const error = errno;
+        ::close(m_socket);
+        throw std::runtime_error(std::string{"station : failed to listen for uevents : "} + strerror(error));
+    }
+}
+
+CStation::~CStation()
+{
+    m_reap(true);
+    ::close(m_socket);
+}
+
+std::vector<fleet_result> CStation::run(volatile sig_atomic_t const & stop)
+{
+    CHubScheduler scheduler{m_hub_limit};
+    std::map<std::string,std::chrono::steady_clock::time_point> finished;
+    m_channel->message("waiting for boards to be plugged in ( ctrl-C to stop)");
+    while ( !stop){
+        pollfd pfd{m_socket,POLLIN,0};
+        std::string port, device;
+        if ( (poll(&pfd,1,poll_period_ms) > 0) && m_port_added(port,device)){
+            auto const last = finished.find(device);
+            bool const rearmed = (last == finished.end()) ||
+                (std::chrono::steady_clock::now() - last->second > rearm_time);
+            if ( (m_jobs.find(device) == m_jobs.end()) && rearmed){
+                m_start(port,device,scheduler);
+            }
+        }
+        for ( auto const & job : m_jobs){
+            if ( job.second->done){
+                finished[job.first] = std::chrono::steady_clock::now();
+            }
+        }
+        m_reap(false);
+    }
+    if ( !m_jobs.empty()){
+        m_channel->message("waiting for the boards being done to finish");
+    }
+    m_reap(true);
+    return m_results;
+}
+
+bool CStation::m_port_added(std::string & port, std::string & device)
+{
+    char buf[8192];
+    sockaddr_nl from;
+    socklen_t from_len = sizeof from;
+    ssize_t const len = recvfrom(m_socket,buf,sizeof buf - 1,0,reinterpret_cast<sockaddr*>(&from),&from_len);
+    // only believe the kernel
+    if ( (len <= 0) || (from_len != sizeof from) || (from.nl_pid != 0)){
+        return false;
+    }
+    buf[len] = '\0';
+    std::string const devname = uevent_field(buf,len,"DEVNAME");
+    if ( (uevent_field(buf,len,"ACTION") != "add") || (uevent_field(buf,len,"SUBSYSTEM") != "tty")
+            || (devname.compare(0,6,"ttyACM") != 0)){
+        return false;
+    }
+    device = usb_device_of(uevent_field(buf,len,"DEVPATH"));
+    port = "/dev/" + devname;
+    return !device.empty();
+}
+
+void CStation::m_start(std::string const & port, std::string const & device, CHubScheduler & scheduler)
+{
+    std::unique_ptr<board_job> job{new board_job};
+    job->done = false;
+    job->result.port = m_serial_of(port);
+    job->result.ok = false;
+    // e.g 1-1.2, the usb port it is plugged into
+    std::string const usb_port = device.substr(device.rfind('/') + 1);
+    m_channel->message(job->result.port + " plugged in on " + port + " ( usb " + usb_port + ")");
+    if ( (m_inventory != nullptr) && (m_inventory->reflashing({port}) > 0)){
+        try{
+            m_inventory->save();
+        }catch (std::exception & e){
+            m_channel->message(e.what());
+        }
+    }
+
+    auto const channel_iter = m_channels.find(device);
+    CProgressChannel * const channel = (channel_iter != m_channels.end())
+        ? channel_iter->second : (m_channels[device] = m_progress.add_channel("usb " + usb_port));
+    board_job * const j = job.get();
+    job->thread = std::thread([this,device,channel,j,&scheduler]{
+        try{
+            std::this_thread::sleep_for(settle_time);
+            COSDConn conn;
+            conn.set_port_finder([device]{ return m_tty_of(device);});
+            conn.set_progress(channel);
+            conn.set_metrics(m_metrics);
+            conn.set_hub_scheduler(&scheduler);
+            conn.set_transport_factory(m_transport_factory);
+            conn.set_timing(m_timing);
+            m_job(conn);
+            j->result.ok = true;
+            j->result.message = "OK";
+        }catch (std::exception & e){
+            j->result.message = e.what();
+        }
+        j->done = true;
+    });
+    m_jobs[device] = std::move(job);
+}
+
+// joins finished jobs, or all of them
+void CStation::m_reap(bool wait)
+{
+    for ( auto iter = m_jobs.begin(); iter != m_jobs.end(); ){
+        board_job & job = *iter->second;
+        if ( !wait && !job.done){
+            ++iter;
+            continue;
+        }
+        job.thread.join();
+        m_channel->message(job.result.port + " : " + (job.result.ok ? "PASS" : "FAIL : " + job.result.message));
+        m_results.push_back(job.result);
+        iter = m_jobs.erase(iter);
+    }
+}
+
+// by the serial in the inventory, else the usb serial, else the port
+std::string CStation::m_serial_of(std::string const & port) const
+{
+    std::string serial;
+    if ( m_inventory != nullptr){
+        serial = m_inventory->serial_of(port);
+    }
+    if ( serial.empty()){
+        serial = CInventory::usb_serial_of(port);
+    }
+    return serial.empty() ? port : serial;
+}
+
+// /sys<device>/<interface>/tty/ttyACMn, the interfaces being named <device>:<config>.<number>
+std::string CStation::m_tty_of(std::string const & device)
+{
+    std::string const sys_device = "/sys" + device;
+    for ( auto const & interface : entries_starting(sys_device,device.substr(device.rfind('/') + 1) + ":")){
+        auto const ttys = entries_starting(sys_device + "/" + interface + "/tty","ttyACM");
+        if ( !ttys.empty()){
+            return "/dev/" + ttys.front();
+        }
+    }
+    return "";
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+/*
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+ 
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program. If not, see <http://www.gnu.org/licenses/>
+
+Authors:
+   Andy Little
+   Tom Ren
+  
+*/
+
+#include <csignal>
+#include <string>
+#include <vector>
+#include <map>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <functional>
+
+#include "fleet.h"
+#include "transport.h"
+
+class COSDConn;
+class CMetrics;
+class CProgressRenderer;
+class CProgressChannel;
+class CInventory;
+class CHubScheduler;
+class CTimingModel;
+
+/*
+  a production station. Listens for usb serial ports being added ( kernel uevents
+  over netlink) and runs the job on each new board, on its own connection and thread,
+  reporting pass or fail per board serial.
+  A board is known by its usb device ( where it is plugged in) rather than its tty, since
+  the tty may change as the board goes to its bootloader and back, and a freed tty may go to
+  another board. Each connect looks up the tty the device has then. Events for a device while
+  its job runs are ignored. Boards already attached when the station starts are left alone.
+*/
+class CStation{
+public:
+    CStation(std::function<void(COSDConn &)> const & job, CProgressRenderer & progress, CMetrics * metrics);
+    ~CStation();
+
+    // boards on one usb hub programming or reading back firmware at once, 0 for no limit
+    void set_hub_limit(size_t limit) { m_hub_limit = limit;}
+    void set_transport_factory(transport_factory const & factory) { m_transport_factory = factory;}
+    void set_timing(CTimingModel * timing) { m_timing = timing;}
+    // optional, boards are reported by their serial in the inventory if they are in it.
+    // The job is taken to flash the board, so its flash crc there is no longer known
+    void set_inventory(CInventory * inventory) { m_inventory = inventory;}
+
+    // until stop is set, e.g from a signal handler. Waits for the jobs running then,
+    // and returns a result per board, named by serial, in the order they finished
+    std::vector<fleet_result> run(volatile sig_atomic_t const & stop);
+
+private:
+    struct board_job{
+        std::thread thread;
+        std::atomic<bool> done;
+        fleet_result result;
+    };
+
+    // true if the uevent was a usb serial port being added
+    bool m_port_added(std::string & port, std::string & device);
+    void m_start(std::string const & port, std::string const & device, CHubScheduler & scheduler);
+    void m_reap(bool wait);
+    std::string m_serial_of(std::string const & port) const;
+    // the tty the usb device has now, empty if it has none
+    static std::string m_tty_of(std::string const & device);
+
+    std::function<void(COSDConn &)> const m_job;
+    CProgressRenderer & m_progress;
+    CMetrics * m_metrics;
+    size_t m_hub_limit;
+    transport_factory m_transport_factory;
+    CInventory * m_inventory;
+    CTimingModel * m_timing;
+    CProgressChannel * m_channel;
+    // running, by usb device
+    std::map<std::string,std::unique_ptr<board_job> > m_jobs;
+    std::map<std::string,CProgressChannel*> m_channels;
+    std::vector<fleet_result> m_results;
+    int m_socket;
+};
@@ -0,0 +1,168 @@
+/*
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+ 
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program. If not, see <http://www.gnu.org/licenses/>
+
+Authors:
+   Andy Little
+   Tom Ren
+*/
+
+
+#include "timing.h"
+
+#include <fstream>
+#include <sstream>
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <algorithm>
+#include <cctype>
+
+namespace {
+
+    /*
+      timeout = max(max_factor * longest seen, mean + sigmas * stddev) + margin,
+      clamped to [low, high]
+    */
+    struct timeout_rule{
+        char const * name;
+        uint32_t min_count;
+        double max_factor;
+        double sigmas;
+        double margin;
+        double low;
+        double high;
+    };
+
+    // in the order of CTimingModel::kind
+    constexpr timeout_rule rules[] = {
+        {"sync",   10, 4.0, 8.0, 0.0, 0.1,   7.0},
+        {"erase",   1, 2.0, 0.0, 2.0, 5.0, 120.0},
+        {"reset",   3, 2.0, 0.0, 0.1, 0.1,   1.0},
+        {"reboot",  3, 2.0, 0.0, 1.0, 2.0,  20.0}
+    };
+
+    // beyond this many, older observations fade out so the stats follow changes
+    constexpr uint32_t max_count = 1000;
+    constexpr double max_decay = 0.995;
+    char const * const pooled = "*";
+
+    std::string key_of(std::string const & transport, std::string const & model)
+    {
+        return transport + "/" + model;
+    }
+}
+
+CTimingModel::CTimingModel(std::string const & filename)
+: m_filename(filename), m_changed{false}
+{
+    std::ifstream in(filename);
+    std::string line;
+    while ( std::getline(in,line)){
+        std::istringstream fields(line);
+        std::string model, name;
+        stats s;
+        double stddev;
+        fields >> model >> name >> s.count >> s.mean >> stddev >> s.max;
+        // lines from before the transport was in the key start with the board id or "*"
+        if ( !fields || (s.count == 0) || !isalpha(static_cast<unsigned char>(model[0]))){
+            continue;
+        }
+        s.m2 = stddev * stddev * s.count;
+        for ( int k = 0; k < num_kinds; ++k){
+            if ( name == rules[k].name){
+                m_stats[k][model] = s;
+            }
+        }
+    }
+}
+
+void CTimingModel::add(std::string const & transport, std::string const & model, kind k, double seconds)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_changed = true;
+    for ( auto const & name : {std::string{pooled}, model}){
+        if ( name.empty()){
+            continue;
+        }
+        stats & s = m_stats[k][key_of(transport,name)];
+        s.count = std::min(s.count + 1,max_count);
+        double const delta = seconds - s.mean;
+        s.mean += delta / s.count;
+        s.m2 += delta * (seconds - s.mean);
+        if ( s.count == max_count){
+            s.m2 *= static_cast<double>(max_count - 1) / max_count;
+        }
+        s.max = std::max(seconds,s.max * max_decay);
+    }
+}
+
+std::chrono::milliseconds CTimingModel::timeout(std::string const & transport, std::string const & model,
+    kind k, std::chrono::milliseconds fallback) const
+{
+    timeout_rule const & rule = rules[k];
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto iter = m_stats[k].find(key_of(transport,model));
+    if ( (iter == m_stats[k].end()) || (iter->second.count < rule.min_count)){
+        iter = m_stats[k].find(key_of(transport,pooled));
+        if ( (iter == m_stats[k].end()) || (iter->second.count < rule.min_count)){
+            return fallback;
+        }
+    }
+    stats const & s = iter->second;
+    double const stddev = std::sqrt(s.m2 / s.count);
+    double const seconds = std::min(rule.high,std::max(rule.low,
+        std::max(rule.max_factor * s.max, s.mean + rule.sigmas * stddev) + rule.margin));
+    return std::chrono::milliseconds{static_cast<int64_t>(seconds * 1000)};
+}
+
+bool CTimingModel::changed() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_changed;
+}
+
+bool CTimingModel::save()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::string const tmpname = m_filename + ".tmp";
+    {
+        std::ofstream fo(tmpname);
+        if ( !fo){
+            return false;
+        }
+        for ( int k = 0; k < num_kinds; ++k){
+            for ( auto const & entry : m_stats[k]){
+                stats const & s = entry.second;
+                char buf[128];
+                snprintf(buf,sizeof buf," %s %u %.6f %.6f %.6f\n",rules[k].name,s.count,s.mean,
+                    std::sqrt(s.m2 / s.count),s.max);
+                fo << entry.first << buf;
+            }
+        }
+        if ( !fo.good()){
+            return false;
+        }
+    }
+    if ( std::rename(tmpname.c_str(),m_filename.c_str()) != 0){
+        return false;
+    }
+    m_changed = false;
+    return true;
+}
+
+std::string CTimingModel::default_filename()
+{
+    char const * home = getenv("HOME");
+    return std::string{(home != nullptr) ? home : "."} + "/.playuavosd_timing";
+}
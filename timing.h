@@ -0,0 +1,77 @@
+#pragma once
+
+/*
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+ 
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program. If not, see <http://www.gnu.org/licenses/>
+
+Authors:
+   Andy Little
+   Tom Ren
+  
+*/
+
+#include <cstdint>
+#include <string>
+#include <map>
+#include <mutex>
+#include <chrono>
+
+/*
+  observed timings of board operations per transport ( "serial" or "tcp") and board model
+  ( board id and flash size), kept between runs so that timeouts follow what the boards
+  actually do rather than fixed worst cases. A round trip over a tcp bridge says nothing
+  about one over usb, so nothing is shared between transports. Every observation also goes
+  to a pooled entry for the transport ( model "*"), used before the model is known or has
+  enough observations of its own.
+  The file has a line per transport/model and kind :
+     transport/model kind count mean_seconds stddev_seconds max_seconds
+*/
+class CTimingModel{
+public:
+    enum kind{
+        sync,       // GET_SYNC round trip
+        erase,      // CHIP_ERASE
+        reset,      // reboot command to the app going
+        reboot,     // reboot command to the bootloader answering
+        num_kinds
+    };
+
+    // loads the file if it exists
+    explicit CTimingModel(std::string const & filename);
+
+    // model empty if it isnt known yet
+    void add(std::string const & transport, std::string const & model, kind k, double seconds);
+    // from the observations for the model, or fallback if there arent enough yet
+    std::chrono::milliseconds timeout(std::string const & transport, std::string const & model,
+        kind k, std::chrono::milliseconds fallback) const;
+    // whether anything was added since the file was loaded or saved
+    bool changed() const;
+    bool save();
+
+    // ~/.playuavosd_timing
+    static std::string default_filename();
+
+private:
+    struct stats{
+        uint32_t count;
+        double mean;
+        double m2;      // sum of squared differences from the mean
+        double max;     // decays, so a one off doesnt last for ever
+        stats():count{0},mean{0},m2{0},max{0}{}
+    };
+
+    std::string const m_filename;
+    std::map<std::string,stats> m_stats[num_kinds];
+    bool m_changed;
+    mutable std::mutex m_mutex;
+};
@@ -0,0 +1,472 @@
+/*
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+ 
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program. If not, see <http://www.gnu.org/licenses/>
+
+Authors:
+   Andy Little
+   Tom Ren
+*/
+
+
+#include "trace.h"
+
+#include <stdexcept>
+#include <thread>
+#include <cstring>
+#include <iterator>
+#include <algorithm>
+
+namespace {
+
+    constexpr char trace_magic[8] = {'P','O','S','D','T','R','C','1'};
+
+    typedef std::chrono::steady_clock clock_type;
+
+    void put_varint(std::vector<uint8_t> & out, uint64_t v)
+    {
+        while ( v >= 0x80){
+            out.push_back(static_cast<uint8_t>(v | 0x80));
+            v >>= 7;
+        }
+        out.push_back(static_cast<uint8_t>(v));
+    }
+
+    // false if the data ran out
+    bool get_varint(std::vector<uint8_t> const & in, size_t & pos, uint64_t & v)
+    {
+        v = 0;
+        for ( int shift = 0; (pos < in.size()) && (shift < 64); shift += 7){
+            uint8_t const b = in[pos++];
+            v |= static_cast<uint64_t>(b & 0x7f) << shift;
+            if ( (b & 0x80) == 0){
+                return true;
+            }
+        }
+        return false;
+    }
+}
+
+//------------------------------ recording ------------------------------------
+
+class CTraceRecorder::CRecordingTransport : public CTransport{
+public:
+    CRecordingTransport(CTraceRecorder & recorder, std::unique_ptr<CTransport> transport)
+    : CTransport{transport->name()}, m_recorder(recorder), m_transport{std::move(transport)}
+     ,m_session{recorder.m_open_session(name(),m_transport->default_window(),m_transport->good())}
+     ,m_lost{!m_transport->good()}, m_closed{false}
+    {}
+
+    ~CRecordingTransport()
+    {
+        close();
+    }
+
+    bool good() const { return m_transport->good();}
+
+    void write(uint8_t const * buf, size_t len)
+    {
+        try{
+            m_transport->write(buf,len);
+        }catch (std::exception & e){
+            m_error(e.what());
+            throw;
+        }
+        m_recorder.m_record(trace::tx,m_session,buf,len);
+    }
+
+    void read(uint8_t * buf, size_t len, std::chrono::milliseconds timeout)
+    {
+        try{
+            m_transport->read(buf,len,timeout);
+        }catch (std::exception & e){
+            m_check_lost();
+            throw;
+        }
+        m_recorder.m_record(trace::rx,m_session,buf,len);
+    }
+
+    bool wait_avail(size_t count, std::chrono::milliseconds timeout)
+    {
+        bool const result = m_transport->wait_avail(count,timeout);
+        m_check_lost();
+        return result;
+    }
+
+    size_t in_avail()
+    {
+        size_t const result = m_transport->in_avail();
+        m_check_lost();
+        return result;
+    }
+
+    void flush() { m_transport->flush();}
+
+    void close()
+    {
+        if ( !m_closed){
+            m_closed = true;
+            m_transport->close();
+            m_recorder.m_record(trace::close,m_session,nullptr,0);
+        }
+    }
+
+    size_t default_window() const { return m_transport->default_window();}
+
+private:
+    void m_error(std::string const & text)
+    {
+        if ( !m_lost){
+            m_lost = true;
+            m_recorder.m_record(trace::error,m_session,reinterpret_cast<uint8_t const*>(text.data()),text.length());
+        }
+    }
+
+    // record the moment the link went, once
+    void m_check_lost()
+    {
+        if ( !m_transport->good()){
+            m_error("read from " + name() + " : connection lost");
+        }
+    }
+
+    CTraceRecorder & m_recorder;
+    std::unique_ptr<CTransport> m_transport;
+    uint32_t const m_session;
+    bool m_lost;
+    bool m_closed;
+};
+
+CTraceRecorder::CTraceRecorder(std::string const & filename)
+: m_out(filename, std::ios_base::out | std::ios_base::binary | std::ios_base::trunc)
+ ,m_start{clock_type::now()}, m_last_us{0}, m_sessions{0}
+{
+    if ( !m_out){
+        throw std::runtime_error("failed to create trace file " + filename);
+    }
+    m_out.write(trace_magic,8);
+}
+
+std::unique_ptr<CTransport> CTraceRecorder::wrap(std::unique_ptr<CTransport> transport)
+{
+    return std::unique_ptr<CTransport>{new CRecordingTransport{*this,std::move(transport)}};
+}
+
+uint32_t CTraceRecorder::m_open_session(std::string const & name, size_t window, bool good)
+{
+    uint32_t session;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        session = m_sessions++;
+    }
+    std::vector<uint8_t> payload;
+    put_varint(payload,window);
+    payload.push_back(good ? 1 : 0);
+    payload.insert(payload.end(),name.begin(),name.end());
+    m_record(trace::open,session,payload.data(),payload.size());
+    return session;
+}
+
+void CTraceRecorder::m_record(trace::kind kind, uint32_t session, uint8_t const * data, size_t len)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    uint64_t const now_us = std::chrono::duration_cast<std::chrono::microseconds>(clock_type::now() - m_start).count();
+    std::vector<uint8_t> record;
+    record.push_back(kind);
+    put_varint(record,session);
+    put_varint(record,now_us - m_last_us);
+    put_varint(record,len);
+    m_last_us = now_us;
+    m_out.write(reinterpret_cast<char const*>(record.data()),record.size());
+    m_out.write(reinterpret_cast<char const*>(data),len);
+    // keep what there is if the session ends badly
+    if ( (kind == trace::error) || (kind == trace::close)){
+        m_out.flush();
+    }
+}
+
+//------------------------------ replay ------------------------------------
+
+class CTraceReplay::CReplayTransport : public CTransport{
+public:
+    CReplayTransport(session & s, double speed)
+    : CTransport{s.name}, m_session(s), m_speed{speed}, m_opened{clock_type::now()}
+     ,m_failed{!s.good}, m_sent{0}, m_received{0}, m_released{0}, m_wanted{0}
+    {}
+
+    bool good() const { return !m_failed;}
+
+    void write(uint8_t const * buf, size_t len)
+    {
+        if ( m_failed){
+            throw std::runtime_error("write to " + name() + " : not connected");
+        }
+        auto const & tx = m_session.tx;
+        if ( m_sent + len > tx.size()){
+            if ( !m_session.error.empty()){
+                m_failed = true;
+                throw std::runtime_error(m_session.error);
+            }
+            throw std::runtime_error("replay diverged : more was sent to " + name() + " than was recorded");
+        }
+        for ( size_t i = 0; i < len; ++i){
+            if ( buf[i] != tx[m_sent + i]){
+                throw std::runtime_error("replay diverged at byte " + std::to_string(m_sent + i) + " sent to " + name());
+            }
+        }
+        m_sent += len;
+        m_session.tx_used = m_sent;
+        m_writes.push_back({m_sent,clock_type::now()});
+    }
+
+    void read(uint8_t * buf, size_t len, std::chrono::milliseconds timeout)
+    {
+        if ( !wait_avail(len,timeout)){
+            if ( m_failed && !m_session.error.empty()){
+                throw std::runtime_error(m_session.error);
+            }
+            throw std::runtime_error("read from " + name() + (m_failed ? " : connection lost" : " : timed out"));
+        }
+        memcpy(buf,&m_session.rx[m_received],len);
+        m_received += len;
+        m_session.rx_used = m_received;
+    }
+
+    bool wait_avail(size_t count, std::chrono::milliseconds timeout)
+    {
+        auto const now = clock_type::now();
+        auto const deadline = now + m_scaled(timeout);
+        m_wanted = m_received + count;
+        m_wait_start = now;
+        bool result = false;
+        for (;;){
+            if ( m_update() >= count){
+                result = true;
+                break;
+            }
+            if ( m_failed){
+                break;
+            }
+            if ( (m_released == m_session.blocks.size()) || !m_eligible(m_released)
+                    || (m_block_time(m_released) > deadline)){
+                std::this_thread::sleep_until(deadline);
+                result = m_update() >= count;
+                break;
+            }
+            std::this_thread::sleep_until(m_block_time(m_released));
+        }
+        m_wanted = 0;
+        return result;
+    }
+
+    size_t in_avail() { return m_update();}
+
+    // anything thrown away in the recording wasnt recorded, so there is nothing to do
+    void flush() {}
+    void close() {}
+
+    size_t default_window() const { return m_session.window;}
+
+private:
+    template <typename Duration>
+    clock_type::duration m_scaled(Duration const & d) const
+    {
+        return std::chrono::duration_cast<clock_type::duration>(
+            std::chrono::duration<double,typename Duration::period>(d.count() / m_speed));
+    }
+
+    size_t m_released_end() const
+    {
+        return (m_released > 0) ? m_session.blocks[m_released - 1].rx_end : 0;
+    }
+
+    /*
+      a block can come once what was sent before it in the recording has been sent.
+      If the client pipelines less than the recording did, a reply can also come
+      once the client is waiting for it. The link only goes at its recorded place.
+    */
+    bool m_eligible(size_t k) const
+    {
+        rx_block const & block = m_session.blocks[k];
+        return (m_sent >= block.tx_offset) || (!block.error && (m_wanted > m_released_end()));
+    }
+
+    /*
+      when block k is due: its recorded latency after the write that took the session
+      to the point it followed, or after the client started waiting for it.
+    */
+    clock_type::time_point m_block_time(size_t k) const
+    {
+        rx_block const & block = m_session.blocks[k];
+        clock_type::time_point base = m_opened;
+        if ( m_sent >= block.tx_offset){
+            if ( block.tx_offset > 0){
+                for ( auto const & w : m_writes){
+                    if ( w.first >= block.tx_offset){
+                        base = w.second;
+                        break;
+                    }
+                }
+            }
+        }else{
+            if ( !m_writes.empty()){
+                base = m_writes.back().second;
+            }
+            base = std::max(base,m_wait_start);
+        }
+        auto const t = base + m_scaled(std::chrono::microseconds{block.latency_us});
+        return std::max(t,m_last_release);
+    }
+
+    // releases the blocks that are due, returns the bytes available
+    size_t m_update()
+    {
+        auto const now = clock_type::now();
+        while ( !m_failed && (m_released < m_session.blocks.size()) && m_eligible(m_released)){
+            auto const t = m_block_time(m_released);
+            if ( t > now){
+                break;
+            }
+            m_last_release = t;
+            if ( m_session.blocks[m_released].error){
+                m_failed = true;
+            }
+            ++m_released;
+        }
+        return m_released_end() - m_received;
+    }
+
+    session & m_session;
+    double const m_speed;
+    clock_type::time_point const m_opened;
+    clock_type::time_point m_last_release;
+    clock_type::time_point m_wait_start;
+    bool m_failed;
+    size_t m_sent;
+    size_t m_received;
+    size_t m_released;
+    // end of the rx stream the client is waiting for, 0 when not waiting
+    size_t m_wanted;
+    // bytes sent so far and when, for each write
+    std::vector<std::pair<size_t,clock_type::time_point> > m_writes;
+};
+
+CTraceReplay::CTraceReplay(std::string const & filename, double speed)
+: m_speed{speed}
+{
+    if ( !(speed > 0)){
+        throw std::runtime_error("replay speed must be more than 0");
+    }
+    std::ifstream in(filename, std::ios_base::in | std::ios_base::binary);
+    if ( !in){
+        throw std::runtime_error("failed to open trace file " + filename);
+    }
+    std::vector<uint8_t> const data{std::istreambuf_iterator<char>(in),std::istreambuf_iterator<char>()};
+    if ( (data.size() < 8) || (memcmp(data.data(),trace_magic,8) != 0)){
+        throw std::runtime_error(filename + " is not a trace file");
+    }
+
+    // recorded time of the open and of the latest tx in each session
+    std::vector<uint64_t> last_tx_us;
+    uint64_t now_us = 0;
+    size_t pos = 8;
+    // a trace cut short by a crash is used up to its last whole record
+    while ( pos < data.size()){
+        uint8_t const kind = data[pos++];
+        uint64_t session_id, dt, len;
+        if ( !get_varint(data,pos,session_id) || !get_varint(data,pos,dt) || !get_varint(data,pos,len)
+                || (len > data.size() - pos)){
+            break;
+        }
+        now_us += dt;
+        uint8_t const * payload = &data[pos];
+        pos += len;
+        if ( kind == trace::open){
+            if ( session_id != m_sessions.size()){
+                throw std::runtime_error("trace file is corrupt");
+            }
+            size_t p = pos - len;
+            uint64_t window = 1;
+            if ( !get_varint(data,p,window) || (p >= pos)){
+                throw std::runtime_error("trace file is corrupt");
+            }
+            session s;
+            s.window = window;
+            s.good = data[p++] != 0;
+            s.name.assign(reinterpret_cast<char const*>(&data[p]),pos - p);
+            s.opened = false;
+            s.tx_used = 0;
+            s.rx_used = 0;
+            m_sessions.push_back(s);
+            last_tx_us.push_back(now_us);
+            continue;
+        }
+        if ( session_id >= m_sessions.size()){
+            throw std::runtime_error("trace file is corrupt");
+        }
+        session & s = m_sessions[session_id];
+        switch (kind){
+            case trace::tx:
+                s.tx.insert(s.tx.end(),payload,payload + len);
+                last_tx_us[session_id] = now_us;
+                break;
+            case trace::rx:
+            case trace::error:
+                if ( kind == trace::rx){
+                    s.rx.insert(s.rx.end(),payload,payload + len);
+                }else{
+                    s.error.assign(reinterpret_cast<char const*>(payload),len);
+                }
+                s.blocks.push_back({s.tx.size(),now_us - last_tx_us[session_id],s.rx.size(),kind == trace::error});
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+std::unique_ptr<CTransport> CTraceReplay::open(std::string const & name)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    session * found = nullptr;
+    for ( auto & s : m_sessions){
+        if ( !s.opened && (s.name == name)){
+            found = &s;
+            break;
+        }
+    }
+    for ( auto & s : m_sessions){
+        if ( (found == nullptr) && !s.opened){
+            found = &s;
+        }
+    }
+    if ( found == nullptr){
+        throw std::runtime_error("replay : no more recorded connections");
+    }
+    found->opened = true;
+    return std::unique_ptr<CTransport>{new CReplayTransport{*found,m_speed}};
+}
+
+void CTraceReplay::report(std::ostream & out) const
+{
+    size_t used = 0;
+    for ( auto const & s : m_sessions){
+        used += s.opened ? 1 : 0;
+    }
+    out << "replay : " << used << " of " << m_sessions.size() << " recorded connections used\n";
+    for ( auto const & s : m_sessions){
+        if ( s.opened){
+            out << "   " << s.name << " : sent " << s.tx_used << " of " << s.tx.size()
+                << " bytes, read " << s.rx_used << " of " << s.rx.size() << " bytes\n";
+        }
+    }
+}
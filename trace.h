@@ -0,0 +1,112 @@
+#pragma once
+
+/*
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+ 
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program. If not, see <http://www.gnu.org/licenses/>
+
+Authors:
+   Andy Little
+   Tom Ren
+  
+*/
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <fstream>
+#include <ostream>
+#include <chrono>
+
+#include "transport.h"
+
+/*
+  A trace is every byte sent to and received from the boards, with timestamps,
+  so a session on real hardware can be re-run offline.
+  Format:
+     "POSDTRC1"
+     records of
+        u8 kind, varint session, varint microseconds since the previous record,
+        varint payload length, payload
+     where the payload is
+        open  : varint default window, u8 1 if the connection was good, port name
+        tx,rx : the bytes
+        error : the error message
+        close : nothing
+  Each connection opened is a session. rx records are made as the bytes are read.
+*/
+namespace trace{
+    enum kind : uint8_t { open = 1, tx = 2, rx = 3, error = 4, close = 5};
+}
+
+class CTraceRecorder{
+public:
+    explicit CTraceRecorder(std::string const & filename);
+
+    // record the traffic on a connection that has just been opened
+    std::unique_ptr<CTransport> wrap(std::unique_ptr<CTransport> transport);
+
+private:
+    class CRecordingTransport;
+    uint32_t m_open_session(std::string const & name, size_t window, bool good);
+    void m_record(trace::kind kind, uint32_t session, uint8_t const * data, size_t len);
+
+    std::mutex m_mutex;
+    std::ofstream m_out;
+    std::chrono::steady_clock::time_point const m_start;
+    uint64_t m_last_us;
+    uint32_t m_sessions;
+};
+
+/*
+  Plays back a trace in place of the boards. The bytes sent must be those recorded,
+  but may be sent in different sized pieces or pipelined differently. Each reply
+  arrives with the delay it had after the request it followed in the recording,
+  divided by speed. Timeouts are divided by speed too.
+*/
+class CTraceReplay{
+public:
+    CTraceReplay(std::string const & filename, double speed);
+
+    // the next recorded connection, preferring one to the same port
+    std::unique_ptr<CTransport> open(std::string const & name);
+    // how much of the trace was used
+    void report(std::ostream & out) const;
+
+private:
+    class CReplayTransport;
+    struct rx_block{
+        size_t tx_offset;   // bytes sent in the session before it
+        uint64_t latency_us;    // after the tx that took the session to tx_offset
+        size_t rx_end;      // end of its bytes in rx
+        bool error;
+    };
+    struct session{
+        std::string name;
+        size_t window;
+        bool good;
+        std::vector<uint8_t> tx;
+        std::vector<uint8_t> rx;
+        std::vector<rx_block> blocks;
+        std::string error;
+        bool opened;
+        size_t tx_used;
+        size_t rx_used;
+    };
+
+    double const m_speed;
+    std::vector<session> m_sessions;
+    std::mutex m_mutex;
+};
@@ -0,0 +1,304 @@
+/*
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+ 
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program. If not, see <http://www.gnu.org/licenses/>
+
+Authors:
+   Andy Little
+   Tom Ren
+*/
+
+#include "transport.h"
+
+#include <stdexcept>
+#include <cstring>
+#include <cerrno>
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <linux/serial.h>
+
+namespace {
+
+    // read size for each system call
+    constexpr size_t rx_chunk = 4096;
+
+    typedef std::chrono::steady_clock clock_type;
+
+    int ms_left(clock_type::time_point const & deadline)
+    {
+        auto const left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - clock_type::now()).count();
+        return (left > 0) ? static_cast<int>(left) : 0;
+    }
+
+    speed_t to_speed(int baud)
+    {
+        switch (baud){
+            case 9600: return B9600;
+            case 19200: return B19200;
+            case 38400: return B38400;
+            case 57600: return B57600;
+            case 115200: return B115200;
+            case 230400: return B230400;
+            case 460800: return B460800;
+            case 921600: return B921600;
+            default:
+                throw std::runtime_error("unsupported baud rate");
+        }
+    }
+
+    std::runtime_error sys_error(std::string const & what)
+    {
+        return std::runtime_error(what + " : " + strerror(errno));
+    }
+
+} // namespace
+
+char const * CTransport::kind_of(std::string const & name)
+{
+    return (name.compare(0,4,"tcp:") == 0) ? "tcp" : "serial";
+}
+
+std::unique_ptr<CTransport> CTransport::open(std::string const & name)
+{
+    if ( name.compare(0,4,"tcp:") == 0){
+        size_t const colon = name.rfind(':');
+        if ( colon <= 4){
+            throw std::runtime_error("expected tcp:<host>:<port> in " + name);
+        }
+        return std::unique_ptr<CTransport>{
+            new CTcpTransport{name,name.substr(4,colon - 4),name.substr(colon + 1)}};
+    }
+    return std::unique_ptr<CTransport>{new CSerialTransport{name}};
+}
+
+CFdTransport::CFdTransport(std::string const & name, int fd)
+: CTransport{name}, m_fd{fd}, m_failed{false}, m_rx_pos{0}
+{}
+
+CFdTransport::~CFdTransport()
+{
+    close();
+}
+
+bool CFdTransport::good() const
+{
+    return (m_fd >= 0) && !m_failed;
+}
+
+void CFdTransport::close()
+{
+    if ( m_fd >= 0){
+        ::close(m_fd);
+        m_fd = -1;
+    }
+}
+
+void CFdTransport::write(uint8_t const * buf, size_t len)
+{
+    while ( len > 0){
+        if ( !good()){
+            throw std::runtime_error("write to " + name() + " : not connected");
+        }
+        ssize_t const n = m_write_some(buf,len);
+        if ( n > 0){
+            buf += n;
+            len -= n;
+            continue;
+        }
+        if ( (n < 0) && (errno == EINTR)){
+            continue;
+        }
+        if ( (n < 0) && ((errno == EAGAIN) || (errno == EWOULDBLOCK))){
+            pollfd pfd = {m_fd,POLLOUT,0};
+            if ( poll(&pfd,1,1000) <= 0){
+                m_failed = true;
+                throw std::runtime_error("write to " + name() + " : timed out");
+            }
+            continue;
+        }
+        m_failed = true;
+        throw sys_error("write to " + name());
+    }
+}
+
+ssize_t CFdTransport::m_write_some(uint8_t const * buf, size_t len)
+{
+    return ::write(m_fd,buf,len);
+}
+
+// wait up to timeout_ms for some more input. returns false on timeout or failure
+bool CFdTransport::m_fill(int timeout_ms)
+{
+    if ( !good()){
+        return false;
+    }
+    if ( m_rx_pos > 0){
+        m_rx.erase(m_rx.begin(),m_rx.begin() + m_rx_pos);
+        m_rx_pos = 0;
+    }
+    pollfd pfd = {m_fd,POLLIN,0};
+    int const r = poll(&pfd,1,timeout_ms);
+    if ( r < 0){
+        if ( errno == EINTR){
+            return true;
+        }
+        m_failed = true;
+        return false;
+    }
+    if ( r == 0){
+        return false;
+    }
+    size_t const old_size = m_rx.size();
+    m_rx.resize(old_size + rx_chunk);
+    ssize_t const n = ::read(m_fd,&m_rx[old_size],rx_chunk);
+    if ( n > 0){
+        m_rx.resize(old_size + n);
+        return true;
+    }
+    m_rx.resize(old_size);
+    if ( (n < 0) && ((errno == EAGAIN) || (errno == EWOULDBLOCK) || (errno == EINTR))){
+        return true;
+    }
+    // end of file or error means the device or connection has gone
+    m_failed = true;
+    return false;
+}
+
+bool CFdTransport::wait_avail(size_t count, std::chrono::milliseconds timeout)
+{
+    auto const deadline = clock_type::now() + timeout;
+    while ( m_buffered() < count){
+        int const left = ms_left(deadline);
+        if ( !m_fill(left) && ((left == 0) || !good())){
+            return false;
+        }
+    }
+    return true;
+}
+
+size_t CFdTransport::in_avail()
+{
+    // pick up anything already waiting without blocking
+    while ( m_fill(0)){;}
+    return m_buffered();
+}
+
+void CFdTransport::read(uint8_t * buf, size_t len, std::chrono::milliseconds timeout)
+{
+    if ( !wait_avail(len,timeout)){
+        throw std::runtime_error("read from " + name() + (good() ? " : timed out" : " : connection lost"));
+    }
+    memcpy(buf,&m_rx[m_rx_pos],len);
+    m_rx_pos += len;
+}
+
+void CFdTransport::flush()
+{
+    in_avail();
+    m_rx.clear();
+    m_rx_pos = 0;
+}
+
+CSerialTransport::CSerialTransport(std::string const & device, int baud)
+: CFdTransport{device,::open(device.c_str(), O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC)}
+{
+    if ( fd() < 0){
+        throw sys_error("open " + device);
+    }
+    termios tio;
+    if ( tcgetattr(fd(),&tio) != 0){
+        throw sys_error("tcgetattr " + device);
+    }
+    cfmakeraw(&tio);
+    tio.c_cflag |= CLOCAL | CREAD;
+    tio.c_cflag &= ~(CRTSCTS | CSTOPB);
+    tio.c_cc[VMIN] = 0;
+    tio.c_cc[VTIME] = 0;
+    speed_t const speed = to_speed(baud);
+    cfsetispeed(&tio,speed);
+    cfsetospeed(&tio,speed);
+    if ( tcsetattr(fd(),TCSANOW,&tio) != 0){
+        throw sys_error("tcsetattr " + device);
+    }
+    // real uarts hold input back to batch it up, ask them not to.
+    // cdc acm doesnt support this, which is fine
+    serial_struct ss;
+    if ( ioctl(fd(),TIOCGSERIAL,&ss) == 0){
+        ss.flags |= ASYNC_LOW_LATENCY;
+        ioctl(fd(),TIOCSSERIAL,&ss);
+    }
+    tcflush(fd(),TCIOFLUSH);
+}
+
+void CSerialTransport::flush()
+{
+    if ( fd() >= 0){
+        tcflush(fd(),TCIFLUSH);
+    }
+    CFdTransport::flush();
+}
+
+namespace {
+
+    int tcp_connect(std::string const & host, std::string const & port)
+    {
+        addrinfo hints;
+        memset(&hints,0,sizeof(hints));
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        addrinfo * addrs = nullptr;
+        int const r = getaddrinfo(host.c_str(),port.c_str(),&hints,&addrs);
+        if ( r != 0){
+            throw std::runtime_error("tcp " + host + ":" + port + " : " + gai_strerror(r));
+        }
+        int fd = -1;
+        for ( addrinfo * a = addrs; a != nullptr; a = a->ai_next){
+            fd = socket(a->ai_family, a->ai_socktype | SOCK_CLOEXEC, a->ai_protocol);
+            if ( fd < 0){
+                continue;
+            }
+            if ( connect(fd,a->ai_addr,a->ai_addrlen) == 0){
+                break;
+            }
+            ::close(fd);
+            fd = -1;
+        }
+        freeaddrinfo(addrs);
+        if ( fd < 0){
+            throw sys_error("tcp connect " + host + ":" + port);
+        }
+        // requests are small, send them straight away
+        int const one = 1;
+        setsockopt(fd,IPPROTO_TCP,TCP_NODELAY,&one,sizeof(one));
+        fcntl(fd,F_SETFL,fcntl(fd,F_GETFL) | O_NONBLOCK);
+        return fd;
+    }
+
+} // namespace
+
+CTcpTransport::CTcpTransport(std::string const & name, std::string const & host, std::string const & port)
+: CFdTransport{name,tcp_connect(host,port)}
+{}
+
+ssize_t CTcpTransport::m_write_some(uint8_t const * buf, size_t len)
+{
+    return ::send(fd(),buf,len,MSG_NOSIGNAL);
+}
@@ -0,0 +1,120 @@
+#pragma once
+
+/*
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+ 
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program. If not, see <http://www.gnu.org/licenses/>
+
+Authors:
+   Andy Little
+   Tom Ren
+  
+*/
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <memory>
+#include <chrono>
+#include <functional>
+#include <sys/types.h>
+
+/*
+  byte stream to a board.
+  Waits are done with poll() rather than spinning on in_avail()
+*/
+class CTransport{
+public:
+    virtual ~CTransport(){}
+
+    virtual bool good() const = 0;
+    // throws if the bytes couldnt all be written
+    virtual void write(uint8_t const * buf, size_t len) = 0;
+    // reads exactly len bytes, throws on timeout or a lost link
+    virtual void read(uint8_t * buf, size_t len, std::chrono::milliseconds timeout) = 0;
+    // true once count bytes are waiting, false on timeout or a lost link
+    virtual bool wait_avail(size_t count, std::chrono::milliseconds timeout) = 0;
+    virtual size_t in_avail() = 0;
+    // throw away anything received but not yet read
+    virtual void flush() = 0;
+    virtual void close() = 0;
+
+    // how many requests may be in flight before waiting for the replies
+    virtual size_t default_window() const { return 1;}
+
+    std::string const & name() const { return m_name;}
+
+    /*
+      "tcp:<host>:<port>" connects to a raw tcp serial bridge ( e.g ser2net)
+      anything else is a serial device path e.g "/dev/ttyACM0"
+      throws std::runtime_error on failure
+    */
+    static std::unique_ptr<CTransport> open(std::string const & name);
+    // "tcp" or "serial", the backend open would pick for the name
+    static char const * kind_of(std::string const & name);
+
+protected:
+    explicit CTransport(std::string const & name) : m_name(name){}
+private:
+    std::string const m_name;
+};
+
+// makes the transport for a port name, e.g to record or replay the traffic
+typedef std::function<std::unique_ptr<CTransport>(std::string const & name)> transport_factory;
+
+// common part for transports that are a unix file descriptor
+class CFdTransport : public CTransport{
+public:
+    ~CFdTransport();
+
+    bool good() const;
+    void write(uint8_t const * buf, size_t len);
+    void read(uint8_t * buf, size_t len, std::chrono::milliseconds timeout);
+    bool wait_avail(size_t count, std::chrono::milliseconds timeout);
+    size_t in_avail();
+    void flush();
+    void close();
+
+protected:
+    // takes ownership of fd, which must be non blocking
+    CFdTransport(std::string const & name, int fd);
+    int fd() const { return m_fd;}
+    // one write attempt, as ::write
+    virtual ssize_t m_write_some(uint8_t const * buf, size_t len);
+
+private:
+    size_t m_buffered() const { return m_rx.size() - m_rx_pos;}
+    bool m_fill(int timeout_ms);
+
+    int m_fd;
+    bool m_failed;
+    std::vector<uint8_t> m_rx;
+    size_t m_rx_pos;
+};
+
+// native linux tty, raw mode
+class CSerialTransport : public CFdTransport{
+public:
+    explicit CSerialTransport(std::string const & device, int baud = 115200);
+    void flush();
+};
+
+// raw tcp to a serial bridge. Allows pipelining to hide the round trip
+class CTcpTransport : public CFdTransport{
+public:
+    CTcpTransport(std::string const & name, std::string const & host, std::string const & port);
+    size_t default_window() const { return 8;}
+protected:
+    // a dropped bridge connection must throw, not raise SIGPIPE
+    ssize_t m_write_some(uint8_t const * buf, size_t len);
+};
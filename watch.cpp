@@ -0,0 +1,247 @@
+/*
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+ 
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program. If not, see <http://www.gnu.org/licenses/>
+
+Authors:
+   Andy Little
+   Tom Ren
+*/
+
+
+#include "watch.h"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <algorithm>
+#include <cstring>
+#include <cerrno>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/inotify.h>
+
+#include "osdconn.h"
+#include "progress.h"
+
+namespace {
+
+    // how long to wait for more events from the same save, e.g write then rename
+    constexpr std::chrono::milliseconds settle_time{20};
+    // no changes for this long before the parameters are saved to eeprom
+    constexpr std::chrono::milliseconds save_delay{3000};
+    // retry a failed push this often, e.g while the board is unplugged
+    constexpr std::chrono::milliseconds retry_period{1000};
+    constexpr int poll_period_ms = 100;
+
+    double ms_since(std::chrono::steady_clock::time_point const & start)
+    {
+        return std::chrono::duration<double,std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+}
+
+CParamWatcher::CParamWatcher(COSDConn & conn, std::string const & filename, CProgressChannel * channel)
+: m_conn(conn), m_filename(filename), m_channel{channel}
+ ,m_board_known{false}, m_push_pending{false}, m_unsaved{false}, m_inotify{-1}
+{
+    size_t const slash = filename.rfind('/');
+    m_dir = (slash == std::string::npos) ? "." : filename.substr(0,slash + 1);
+    m_name = (slash == std::string::npos) ? filename : filename.substr(slash + 1);
+    m_params.get_default_params(m_image);
+    m_params.get_default_params(m_board);
+
+    // watch the directory rather than the file, since editors often save
+    // by writing a new file and renaming it over the old one
+    m_inotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if ( (m_inotify < 0) || (inotify_add_watch(m_inotify,m_dir.c_str(),IN_CLOSE_WRITE | IN_MOVED_TO) < 0)){
+        std::string const error = strerror(errno);
+        if ( m_inotify >= 0){
+            ::close(m_inotify);
+        }
+        throw std::runtime_error("cannot watch " + m_dir + " : " + error);
+    }
+}
+
+CParamWatcher::~CParamWatcher()
+{
+    ::close(m_inotify);
+}
+
+void CParamWatcher::run(volatile sig_atomic_t const & stop)
+{
+    if ( !m_reload()){
+        throw std::runtime_error("failed to load parameters from " + m_filename);
+    }
+    m_push();
+    m_message("watching " + m_filename + " for changes ( ctrl-C to stop)...");
+    while ( !stop){
+        pollfd pfd = {m_inotify,POLLIN,0};
+        if ( (poll(&pfd,1,poll_period_ms) > 0) && m_file_event()){
+            std::this_thread::sleep_for(settle_time);
+            m_file_event();
+            if ( m_reload()){
+                m_push();
+            }
+        }
+        auto const now = clock_type::now();
+        if ( m_push_pending && ((now - m_last_attempt) >= retry_period)){
+            m_push();
+        }
+        if ( m_unsaved && !m_push_pending && ((now - m_last_push) >= save_delay)){
+            m_save();
+        }
+    }
+    if ( m_unsaved){
+        m_save();
+    }
+}
+
+// drains the inotify events, true if any were for our file
+bool CParamWatcher::m_file_event()
+{
+    bool result = false;
+    alignas(inotify_event) char buf[4096];
+    for (;;){
+        ssize_t const n = ::read(m_inotify,buf,sizeof(buf));
+        if ( n <= 0){
+            return result;
+        }
+        for ( char * p = buf; p < buf + n; ){
+            inotify_event const * event = reinterpret_cast<inotify_event const *>(p);
+            if ( (event->len > 0) && (m_name == event->name)){
+                result = true;
+            }
+            p += sizeof(inotify_event) + event->len;
+        }
+    }
+}
+
+/*
+  re-encodes the lines that changed since the last read onto the image.
+  If a line was removed its parameter goes back to the default, as in a fresh load,
+  so then the whole file is encoded again.
+  returns true if the file was good
+*/
+bool CParamWatcher::m_reload()
+{
+    std::ifstream in(m_filename);
+    if ( !in){
+        m_message("cannot read " + m_filename);
+        return false;
+    }
+    std::map<std::string,std::string> lines;
+    std::string text;
+    std::string line;
+    while ( std::getline(in,line)){
+        if ( !line.empty() && (line[line.length() - 1] == '\r')){
+            line.erase(line.length() - 1);
+        }
+        if ( line.empty()){
+            continue;
+        }
+        size_t const pos = line.find('=');
+        if ( pos == std::string::npos){
+            m_message("Bad parameter item: " + line + " ... keeping the last good parameters");
+            return false;
+        }
+        lines[line.substr(0,pos)] = line;
+        text += line + '\n';
+    }
+
+    bool removed = m_lines.empty();
+    std::string changed;
+    for ( auto const & old : m_lines){
+        if ( lines.find(old.first) == lines.end()){
+            removed = true;
+        }
+    }
+    uint8_t image[PARAMS_BUF_SIZE];
+    if ( removed){
+        m_params.get_default_params(image);
+        changed = text;
+    }else{
+        memcpy(image,m_image,PARAMS_BUF_SIZE);
+        for ( auto const & entry : lines){
+            auto const old = m_lines.find(entry.first);
+            if ( (old == m_lines.end()) || (old->second != entry.second)){
+                changed += entry.second + '\n';
+            }
+        }
+    }
+    if ( !changed.empty() && !m_params.load_params_from_string(changed,image)){
+        m_message("keeping the last good parameters");
+        return false;
+    }
+    memcpy(m_image,image,PARAMS_BUF_SIZE);
+    m_lines.swap(lines);
+    return true;
+}
+
+// sends the image up to the last byte that differs from the board, or the used part
+// of the image if the board state isnt known
+void CParamWatcher::m_push()
+{
+    size_t len = m_params.layout_size();
+    if ( m_board_known){
+        while ( (len > 0) && (m_image[len - 1] == m_board[len - 1])){
+            --len;
+        }
+        if ( len == 0){
+            m_push_pending = false;
+            return;
+        }
+        len = std::min(static_cast<size_t>(m_params.layout_size()),(len + 3) & ~static_cast<size_t>(3));
+    }
+    m_last_attempt = clock_type::now();
+    try{
+        m_conn.push_params(m_image,len);
+        memcpy(m_board,m_image,len);
+        m_board_known = true;
+        m_push_pending = false;
+        m_unsaved = true;
+        m_last_push = clock_type::now();
+        std::ostringstream out;
+        out << "pushed " << len << " bytes to the board in " << static_cast<int>(ms_since(m_last_attempt)) << " ms";
+        m_message(out.str());
+    }catch (std::exception & e){
+        // the board may have reset, so next time send it all
+        m_message(std::string{"push failed : "} + e.what());
+        m_conn.close();
+        m_board_known = false;
+        m_push_pending = true;
+    }
+}
+
+void CParamWatcher::m_save()
+{
+    try{
+        m_conn.save_params();
+        m_unsaved = false;
+        m_message("OK! ... parameters stored on the board");
+    }catch (std::exception & e){
+        m_message(std::string{"eeprom save failed : "} + e.what());
+        m_conn.close();
+        m_board_known = false;
+        m_push_pending = true;
+    }
+}
+
+void CParamWatcher::m_message(std::string const & text)
+{
+    if ( m_channel != nullptr){
+        m_channel->message(text);
+    }else{
+        std::cout << text << '\n';
+    }
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+/*
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+ 
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ GNU General Public License for more details.
+ 
+ You should have received a copy of the GNU General Public License
+ along with this program. If not, see <http://www.gnu.org/licenses/>
+
+Authors:
+   Andy Little
+   Tom Ren
+  
+*/
+
+#include <cstdint>
+#include <csignal>
+#include <string>
+#include <map>
+#include <chrono>
+
+#include "params.h"
+
+class COSDConn;
+class CProgressChannel;
+
+/*
+  keeps the board connection open and pushes a .posd file to the board each time it
+  is saved, for tuning the layout with the OSD on screen.
+  Only the lines that changed are encoded, and only the image up to the last changed
+  byte is sent. The eeprom save waits until the file has been left alone for a while,
+  so the eeprom isnt worn by every edit.
+*/
+class CParamWatcher{
+public:
+    CParamWatcher(COSDConn & conn, std::string const & filename, CProgressChannel * channel);
+    ~CParamWatcher();
+
+    // until stop is set, e.g from a signal handler. Any unsaved change is saved on the way out
+    void run(volatile sig_atomic_t const & stop);
+
+private:
+    typedef std::chrono::steady_clock clock_type;
+
+    bool m_reload();
+    void m_push();
+    void m_save();
+    bool m_file_event();
+    void m_message(std::string const & text);
+
+    COSDConn & m_conn;
+    std::string const m_filename;
+    std::string m_dir;
+    std::string m_name;
+    CProgressChannel * m_channel;
+    COSDParam m_params;
+    // name=value lines as last read from the file
+    std::map<std::string,std::string> m_lines;
+    // the image from the file, and what the board has
+    uint8_t m_image[PARAMS_BUF_SIZE];
+    uint8_t m_board[PARAMS_BUF_SIZE];
+    bool m_board_known;
+    bool m_push_pending;
+    bool m_unsaved;
+    clock_type::time_point m_last_push;
+    clock_type::time_point m_last_attempt;
+    int m_inotify;
+};